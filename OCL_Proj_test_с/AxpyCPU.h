@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 
@@ -17,28 +18,30 @@ namespace my
 		}
 	}
 
-	void saxpy_omp(int64_t n, float a, const std::vector<float>& x, int64_t incx, std::vector<float>& y, int64_t incy)
+	template <typename Allocator>
+	void saxpy_omp(int64_t n, float a, const std::vector<float, Allocator>& x, int64_t incx, std::vector<float, Allocator>& y, int64_t incy)
 	{
-		if (n <= 0 || incx <= 0 || incy <= 0) return;
+		if (n <= 0 || incx <= 0 || incy <= 0 || x.empty() || y.empty()) return;
 
-#pragma omp parallel for
+		// Stop where either vector ends; the static partition matches firstTouch
+		n = std::min<int64_t>(n, std::min<int64_t>((y.size() - 1) / incy, (x.size() - 1) / incx) + 1);
+#pragma omp parallel for schedule(static)
 		for (int64_t index = 0; index < n; ++index)
 		{
-			if (index * incy >= y.size() ||
-				index * incx >= x.size()) break;
 			y[index * incy] += a * x[index * incx];
 		}
 	}
 
-	void daxpy_omp(int64_t n, double a, const std::vector<double>& x, int64_t incx, std::vector<double>& y, int64_t incy)
+	template <typename Allocator>
+	void daxpy_omp(int64_t n, double a, const std::vector<double, Allocator>& x, int64_t incx, std::vector<double, Allocator>& y, int64_t incy)
 	{
-		if (n <= 0 || incx <= 0 || incy <= 0) return;
+		if (n <= 0 || incx <= 0 || incy <= 0 || x.empty() || y.empty()) return;
 
-#pragma omp parallel for
+		// Stop where either vector ends; the static partition matches firstTouch
+		n = std::min<int64_t>(n, std::min<int64_t>((y.size() - 1) / incy, (x.size() - 1) / incx) + 1);
+#pragma omp parallel for schedule(static)
 		for (int64_t index = 0; index < n; ++index)
 		{
-			if (index * incy >= y.size() ||
-				index * incx >= x.size()) break;
 			y[index * incy] += a * x[index * incx];
 		}
 	}
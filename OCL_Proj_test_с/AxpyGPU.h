@@ -3,37 +3,18 @@
 #include <vector>
 
 #include "DevWorker.h"
+#include "DeviceSelector.h"
+#include "KernelCache.h"
+#include "KernelLibrary.h"
 
 namespace my
 {
-namespace
-{
-	char const* saxpy = "__kernel void operation(long n, float a,			\n"
-		"	const __global float * x, long incx, long xSize,				\n"
-		"	__global float * y, long incy, long ySize)						\n"
-		"{																	\n"
-		"	int index = get_global_id(0);									\n"
-		"	if (index * incx >= xSize || index * incy >= ySize)	return;		\n"
-		"	if (index < n)													\n"
-		"		y[index * incy] = y[index * incy] + a * x[index * incx]; 	\n"
-		"}																	\n";
-
-	char const* daxpy = "__kernel void operation(long n, double a,			\n"
-		"	const __global double * x, long incx, long xSize,				\n"
-		"	__global double * y, long incy, long ySize)						\n"
-		"{																	\n"
-		"	int index = get_global_id(0);									\n"
-		"	if (index * incx >= xSize || index * incy >= ySize)	return;		\n"
-		"	if (index < n)													\n"
-		"		y[index * incy] = y[index * incy] + a * x[index * incx]; 	\n"
-		"}																	\n";
-}
-
-int saxpy_gpu(size_t size, cl_float a_gpu, std::vector<cl_float>& x_gpu, cl_long incx, std::vector<cl_float>& y_gpu, cl_long incy, const char* _deviceName)
+inline int saxpy_gpu(size_t size, cl_float a_gpu, std::vector<cl_float>& x_gpu, cl_long incx, std::vector<cl_float>& y_gpu, cl_long incy, const char* _deviceName)
 {
 	if (size <= 0 || incx <= 0 || incy <= 0) return EXIT_FAILURE;
-	my::DevWorker worker = my::DevWorker();
-	my::GpuTask task = worker.createGpuTask(_deviceName, saxpy);
+	my::KernelCache::Lease lease = my::KernelCache::instance().acquire(_deviceName, my::kernels::saxpy.source,
+		{ { "SIZE_N", size }, { "INC_X", incx }, { "INC_Y", incy }, { "SIZE_XBUF", x_gpu.size() }, { "SIZE_YBUF", y_gpu.size() } });
+	my::GpuTask& task = *lease;
 	if (!task.isTaskFailed())
 	{
 
@@ -48,9 +29,10 @@ int saxpy_gpu(size_t size, cl_float a_gpu, std::vector<cl_float>& x_gpu, cl_long
 		double totalTime = omp_get_wtime();
 		cl_mem yBuff, xBuff;
 
-		std::string AMD_device{ "gfx902" };
+		const my::DeviceInfo* deviceInfo = my::DeviceSelector::instance().find(task.getDevice());
+		const bool zeroCopy = deviceInfo && deviceInfo->unifiedMemory;
 
-		if (AMD_device.find(_deviceName) != AMD_device.npos)
+		if (zeroCopy)
 		{
 			yBuff = task.addBuffer<cl_float>(yBuffSize, CL_MEM_USE_HOST_PTR, res, y_gpu.data());
 			if (res != CL_SUCCESS)
@@ -113,14 +95,13 @@ int saxpy_gpu(size_t size, cl_float a_gpu, std::vector<cl_float>& x_gpu, cl_long
 			std::cout << "With enqueue task proc problems\n";
 			return EXIT_FAILURE;
 		}
-		if (AMD_device.find(_deviceName) == AMD_device.npos)
+		res = zeroCopy ?
+			task.syncHostPtr(yBuff, sizeof(cl_float) * yBuffSize) :
+			task.enqueueReadBuffer<float>(y_gpu.size(), y_gpu.data(), yBuff);
+		if (res != CL_SUCCESS)
 		{
-			res = task.enqueueReadBuffer<float>(y_gpu.size(), y_gpu.data(), yBuff);
-			if (res != CL_SUCCESS)
-			{
-				std::cout << "Problem in read buffer enqueue\n";
-				return EXIT_FAILURE;
-			}
+			std::cout << "Problem in read buffer enqueue\n";
+			return EXIT_FAILURE;
 		}
 		totalTime = omp_get_wtime() - totalTime;
 		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
@@ -136,11 +117,12 @@ int saxpy_gpu(size_t size, cl_float a_gpu, std::vector<cl_float>& x_gpu, cl_long
 	}
 }
 
-int daxpy_gpu(size_t size, cl_double a_gpu, std::vector<cl_double>& x_gpu, cl_long incx, std::vector<cl_double>& y_gpu, cl_long incy, const char* _deviceName)
+inline int daxpy_gpu(size_t size, cl_double a_gpu, std::vector<cl_double>& x_gpu, cl_long incx, std::vector<cl_double>& y_gpu, cl_long incy, const char* _deviceName)
 {
 	if (size <= 0 || incx <= 0 || incy <= 0) return EXIT_FAILURE;
-	my::DevWorker worker = my::DevWorker();
-	my::GpuTask task = worker.createGpuTask(_deviceName, daxpy);
+	my::KernelCache::Lease lease = my::KernelCache::instance().acquire(_deviceName, my::kernels::daxpy.source,
+		{ { "SIZE_N", size }, { "INC_X", incx }, { "INC_Y", incy }, { "SIZE_XBUF", x_gpu.size() }, { "SIZE_YBUF", y_gpu.size() } });
+	my::GpuTask& task = *lease;
 	if (!task.isTaskFailed())
 	{
 
@@ -155,9 +137,10 @@ int daxpy_gpu(size_t size, cl_double a_gpu, std::vector<cl_double>& x_gpu, cl_lo
 		double totalTime = omp_get_wtime();
 		cl_mem yBuff, xBuff;
 
-		std::string AMD_device{ "gfx902" };
+		const my::DeviceInfo* deviceInfo = my::DeviceSelector::instance().find(task.getDevice());
+		const bool zeroCopy = deviceInfo && deviceInfo->unifiedMemory;
 
-		if (AMD_device.find(_deviceName) != AMD_device.npos)
+		if (zeroCopy)
 		{
 			yBuff = task.addBuffer<cl_double>(yBuffSize, CL_MEM_USE_HOST_PTR, res, y_gpu.data());
 			if (res != CL_SUCCESS)
@@ -220,14 +203,13 @@ int daxpy_gpu(size_t size, cl_double a_gpu, std::vector<cl_double>& x_gpu, cl_lo
 			std::cout << "With enqueue task proc problems\n";
 			return EXIT_FAILURE;
 		}
-		if (AMD_device.find(_deviceName) == AMD_device.npos)
+		res = zeroCopy ?
+			task.syncHostPtr(yBuff, sizeof(cl_double) * yBuffSize) :
+			task.enqueueReadBuffer<double>(y_gpu.size(), y_gpu.data(), yBuff);
+		if (res != CL_SUCCESS)
 		{
-			res = task.enqueueReadBuffer<double>(y_gpu.size(), y_gpu.data(), yBuff);
-			if (res != CL_SUCCESS)
-			{
-				std::cout << "Problem in read buffer enqueue\n";
-				return EXIT_FAILURE;
-			}
+			std::cout << "Problem in read buffer enqueue\n";
+			return EXIT_FAILURE;
 		}
 		totalTime = omp_get_wtime() - totalTime;
 		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
@@ -0,0 +1,470 @@
+#include "BatchQueue.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace my
+{
+namespace
+{
+	// Number of elements the strided axpy touches before running off either vector,
+	// matching the bounds check of the single-request kernels
+	template <typename TYPE>
+	size_t effectiveAxpySize(size_t size, const std::vector<TYPE>& x, cl_long incx, const std::vector<TYPE>& y, cl_long incy)
+	{
+		size_t xLimit = (x.size() + incx - 1) / incx;
+		size_t yLimit = (y.size() + incy - 1) / incy;
+		return std::min(size, std::min(xLimit, yLimit));
+	}
+}
+
+RequestCoalescer::RequestCoalescer(const char* _deviceName, CoalescerConfig config)
+	: m_deviceName(_deviceName), m_config(config)
+{
+	if (m_config.maxBatch == 0)
+	{
+		m_config.maxBatch = 1;
+	}
+	m_dispatcher = std::thread(&RequestCoalescer::dispatchLoop, this);
+}
+
+RequestCoalescer::~RequestCoalescer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_one();
+	m_dispatcher.join();
+
+	for (auto& kindBuffers : m_buffers)
+	{
+		for (auto& slot : kindBuffers.second)
+		{
+			if (slot.mem)
+			{
+				clReleaseMemObject(slot.mem);
+			}
+		}
+	}
+}
+
+std::future<std::vector<cl_int>> RequestCoalescer::submitMatMult(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB,
+	cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	std::unique_ptr<Request> request(new Request());
+	request->kind = OpKind::MatMult;
+	request->matrA = &matrA;
+	request->matrB = &matrB;
+	request->sizeZ = sizeZ;
+	request->sizeY = sizeY;
+	request->sizeX = sizeX;
+	auto result = request->matrResult.get_future();
+
+	if (sizeZ <= 0 || sizeY <= 0 || sizeX <= 0 ||
+		matrA.size() < static_cast<size_t>(sizeZ) * sizeY ||
+		matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Invalid matrix sizes for batched multiplication\n";
+		request->matrResult.set_value({});
+		return result;
+	}
+	enqueue(std::move(request));
+	return result;
+}
+
+std::future<int> RequestCoalescer::submitSaxpy(size_t size, cl_float a, const std::vector<cl_float>& x, cl_long incx,
+	std::vector<cl_float>& y, cl_long incy)
+{
+	std::unique_ptr<Request> request(new Request());
+	request->kind = OpKind::Saxpy;
+	request->saxpy = { size, a, &x, incx, &y, incy };
+	auto result = request->axpyResult.get_future();
+
+	if (size <= 0 || incx <= 0 || incy <= 0)
+	{
+		request->axpyResult.set_value(EXIT_FAILURE);
+		return result;
+	}
+	enqueue(std::move(request));
+	return result;
+}
+
+std::future<int> RequestCoalescer::submitDaxpy(size_t size, cl_double a, const std::vector<cl_double>& x, cl_long incx,
+	std::vector<cl_double>& y, cl_long incy)
+{
+	std::unique_ptr<Request> request(new Request());
+	request->kind = OpKind::Daxpy;
+	request->daxpy = { size, a, &x, incx, &y, incy };
+	auto result = request->axpyResult.get_future();
+
+	if (size <= 0 || incx <= 0 || incy <= 0)
+	{
+		request->axpyResult.set_value(EXIT_FAILURE);
+		return result;
+	}
+	enqueue(std::move(request));
+	return result;
+}
+
+void RequestCoalescer::enqueue(std::unique_ptr<Request> request)
+{
+	request->arrival = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.push_back(std::move(request));
+	}
+	m_cv.notify_one();
+}
+
+void RequestCoalescer::dispatchLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_cv.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+		if (m_pending.empty())
+		{
+			break;
+		}
+
+		// The batch closes when the window elapses, when it is full, or on shutdown.
+		// The window is clipped so the oldest request never waits past maxLatency.
+		auto deadline = m_pending.front()->arrival + std::min(m_config.window, m_config.maxLatency);
+		m_cv.wait_until(lock, deadline, [this] { return m_stop || m_pending.size() >= m_config.maxBatch; });
+
+		std::deque<std::unique_ptr<Request>> ready;
+		ready.swap(m_pending);
+		lock.unlock();
+		dispatchBatch(ready);
+		lock.lock();
+	}
+}
+
+void RequestCoalescer::dispatchBatch(std::deque<std::unique_ptr<Request>>& ready)
+{
+	// Requests are compatible when they run the same kernel on the same shapes
+	std::map<std::tuple<OpKind, cl_int, cl_int, cl_int>, std::vector<Request*>> groups;
+	for (auto& request : ready)
+	{
+		groups[std::make_tuple(request->kind, request->sizeZ, request->sizeY, request->sizeX)].push_back(request.get());
+	}
+
+	// Vectors an axpy request reads and writes; matMult results are always the request's own
+	auto axpyOperands = [](const Request& request) -> std::pair<const void*, const void*>
+	{
+		switch (request.kind)
+		{
+		case OpKind::Saxpy:
+			return { request.saxpy.x, request.saxpy.y };
+		case OpKind::Daxpy:
+			return { request.daxpy.x, request.daxpy.y };
+		default:
+			return { nullptr, nullptr };
+		}
+	};
+	auto launch = [this](OpKind kind, const std::vector<Request*>& batch)
+	{
+		switch (kind)
+		{
+		case OpKind::MatMult:
+			launchMatMult(batch);
+			break;
+		case OpKind::Saxpy:
+			launchAxpy(batch, &Request::saxpy, OpKind::Saxpy);
+			break;
+		case OpKind::Daxpy:
+			launchAxpy(batch, &Request::daxpy, OpKind::Daxpy);
+			break;
+		}
+	};
+
+	for (auto& group : groups)
+	{
+		const OpKind kind = std::get<0>(group.first);
+		std::vector<Request*> batch;
+		// y vectors the open batch writes back. Segments are scattered in order, so a second
+		// update of one of them, or a read of one, would miss the first update; such a
+		// request starts the next batch instead, which runs after this one as it would unbatched
+		std::vector<const void*> outputs;
+		for (Request* request : group.second)
+		{
+			const auto operands = axpyOperands(*request);
+			const bool aliased = operands.second &&
+				(std::find(outputs.begin(), outputs.end(), operands.first) != outputs.end() ||
+				std::find(outputs.begin(), outputs.end(), operands.second) != outputs.end());
+			if (batch.size() == m_config.maxBatch || aliased)
+			{
+				launch(kind, batch);
+				batch.clear();
+				outputs.clear();
+			}
+			batch.push_back(request);
+			if (operands.second)
+			{
+				outputs.push_back(operands.second);
+			}
+		}
+		if (!batch.empty())
+		{
+			launch(kind, batch);
+		}
+	}
+}
+
+GpuTask* RequestCoalescer::getTask(OpKind kind)
+{
+	auto found = m_tasks.find(kind);
+	if (found != m_tasks.end())
+	{
+		return found->second.get();
+	}
+
+	const char* source = kind == OpKind::MatMult ? kernels::matMultBatched.source :
+		kind == OpKind::Saxpy ? kernels::saxpyBatched.source : kernels::daxpyBatched.source;
+	std::unique_ptr<GpuTask> task(new GpuTask(m_worker.createGpuTask(m_deviceName.c_str(), source)));
+	if (task->isTaskFailed())
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return nullptr;
+	}
+	return m_tasks.emplace(kind, std::move(task)).first->second.get();
+}
+
+template <typename TYPE>
+cl_mem RequestCoalescer::ensureBuffer(GpuTask& task, OpKind kind, size_t slot, size_t count, int flags)
+{
+	auto& slots = m_buffers[kind];
+	if (slots.size() <= slot)
+	{
+		slots.resize(slot + 1);
+	}
+	auto& buffer = slots[slot];
+	size_t bytes = sizeof(TYPE) * count;
+	if (buffer.mem && buffer.capacity >= bytes)
+	{
+		return buffer.mem;
+	}
+	// Grow geometrically so a steady stream of similar batches stops reallocating
+	const size_t capacity = std::max(bytes, buffer.capacity * 2);
+	if (buffer.mem)
+	{
+		clReleaseMemObject(buffer.mem);
+		buffer = BufferSlot();
+	}
+	int err = CL_SUCCESS;
+	buffer.mem = task.addBuffer<char>(capacity, flags, err);
+	if (err != CL_SUCCESS)
+	{
+		std::cout << "Problem in buffer creation process\n";
+		buffer = BufferSlot();
+		return nullptr;
+	}
+	buffer.capacity = capacity;
+	return buffer.mem;
+}
+
+void RequestCoalescer::launchMatMult(const std::vector<Request*>& batch)
+{
+	auto fail = [&batch]()
+	{
+		for (auto request : batch)
+		{
+			request->matrResult.set_value({});
+		}
+	};
+
+	GpuTask* task = getTask(OpKind::MatMult);
+	if (!task)
+	{
+		fail();
+		return;
+	}
+
+	const cl_int sizeZ = batch.front()->sizeZ;
+	const cl_int sizeY = batch.front()->sizeY;
+	const cl_int sizeX = batch.front()->sizeX;
+	const size_t aCount = static_cast<size_t>(sizeZ) * sizeY;
+	const size_t bCount = static_cast<size_t>(sizeY) * sizeX;
+	const size_t resCount = static_cast<size_t>(sizeZ) * sizeX;
+
+	cl_mem matrABuff = ensureBuffer<cl_int>(*task, OpKind::MatMult, 0, aCount * batch.size(), CL_MEM_READ_ONLY);
+	cl_mem matrBBuff = ensureBuffer<cl_int>(*task, OpKind::MatMult, 1, bCount * batch.size(), CL_MEM_READ_ONLY);
+	cl_mem resMatrBuff = ensureBuffer<cl_int>(*task, OpKind::MatMult, 2, resCount * batch.size(), CL_MEM_WRITE_ONLY);
+	if (!matrABuff || !matrBBuff || !resMatrBuff)
+	{
+		fail();
+		return;
+	}
+
+	// Operands go straight from the callers' vectors into their slice of the device buffer
+	int res = CL_SUCCESS;
+	for (size_t i = 0; i < batch.size() && res == CL_SUCCESS; ++i)
+	{
+		res = clEnqueueWriteBuffer(task->getQueue(), matrABuff, CL_FALSE, sizeof(cl_int) * aCount * i,
+			sizeof(cl_int) * aCount, batch[i]->matrA->data(), 0, NULL, NULL);
+		if (res == CL_SUCCESS)
+		{
+			res = clEnqueueWriteBuffer(task->getQueue(), matrBBuff, CL_FALSE, sizeof(cl_int) * bCount * i,
+				sizeof(cl_int) * bCount, batch[i]->matrB->data(), 0, NULL, NULL);
+		}
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << res << '\n';
+		std::cout << "Problem in write buffer enqueue\n";
+		fail();
+		return;
+	}
+
+	res = task->passParams(matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in params passing process\n";
+		std::cout << res << std::endl;
+		fail();
+		return;
+	}
+
+	size_t globalSize[]{ static_cast<size_t>(sizeZ), static_cast<size_t>(sizeX), batch.size() };
+	double kernelTime{};
+	res = task->enqueueKernel(3, NULL, globalSize, &kernelTime);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "With enqueue task proc problems\n";
+		fail();
+		return;
+	}
+
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		std::vector<cl_int> resMatr(resCount);
+		res = clEnqueueReadBuffer(task->getQueue(), resMatrBuff, CL_TRUE, sizeof(cl_int) * resCount * i,
+			sizeof(cl_int) * resCount, resMatr.data(), 0, NULL, NULL);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in read buffer enqueue\n";
+			resMatr.clear();
+		}
+		batch[i]->matrResult.set_value(std::move(resMatr));
+	}
+}
+
+template <typename TYPE>
+void RequestCoalescer::launchAxpy(const std::vector<Request*>& batch, AxpyArgs<TYPE> Request::* args, OpKind kind)
+{
+	auto fail = [&batch]()
+	{
+		for (auto request : batch)
+		{
+			request->axpyResult.set_value(EXIT_FAILURE);
+		}
+	};
+
+	GpuTask* task = getTask(kind);
+	if (!task)
+	{
+		fail();
+		return;
+	}
+
+	// Strided operands are gathered into one dense segment per request
+	std::vector<cl_long> sizes(batch.size());
+	std::vector<cl_long> offsets(batch.size());
+	std::vector<TYPE> alphas(batch.size());
+	size_t total = 0;
+	size_t longest = 0;
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		const auto& op = batch[i]->*args;
+		size_t n = effectiveAxpySize(op.size, *op.x, op.incx, *op.y, op.incy);
+		sizes[i] = n;
+		offsets[i] = total;
+		alphas[i] = op.a;
+		total += n;
+		longest = std::max(longest, n);
+	}
+	if (total == 0)
+	{
+		for (auto request : batch)
+		{
+			request->axpyResult.set_value(EXIT_SUCCESS);
+		}
+		return;
+	}
+
+	std::vector<TYPE> xPacked(total);
+	std::vector<TYPE> yPacked(total);
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		const auto& op = batch[i]->*args;
+		for (cl_long index = 0; index < sizes[i]; ++index)
+		{
+			xPacked[offsets[i] + index] = (*op.x)[index * op.incx];
+			yPacked[offsets[i] + index] = (*op.y)[index * op.incy];
+		}
+	}
+
+	cl_mem sizesBuff = ensureBuffer<cl_long>(*task, kind, 0, batch.size(), CL_MEM_READ_ONLY);
+	cl_mem offsetsBuff = ensureBuffer<cl_long>(*task, kind, 1, batch.size(), CL_MEM_READ_ONLY);
+	cl_mem alphasBuff = ensureBuffer<TYPE>(*task, kind, 2, batch.size(), CL_MEM_READ_ONLY);
+	cl_mem xBuff = ensureBuffer<TYPE>(*task, kind, 3, total, CL_MEM_READ_ONLY);
+	cl_mem yBuff = ensureBuffer<TYPE>(*task, kind, 4, total, CL_MEM_READ_WRITE);
+	if (!sizesBuff || !offsetsBuff || !alphasBuff || !xBuff || !yBuff)
+	{
+		fail();
+		return;
+	}
+
+	int res = task->enqueueWriteBuffer<cl_long>(sizes.size(), sizes.data(), sizesBuff, CL_FALSE);
+	if (res == CL_SUCCESS) res = task->enqueueWriteBuffer<cl_long>(offsets.size(), offsets.data(), offsetsBuff, CL_FALSE);
+	if (res == CL_SUCCESS) res = task->enqueueWriteBuffer<TYPE>(alphas.size(), alphas.data(), alphasBuff, CL_FALSE);
+	if (res == CL_SUCCESS) res = task->enqueueWriteBuffer<TYPE>(total, xPacked.data(), xBuff, CL_FALSE);
+	if (res == CL_SUCCESS) res = task->enqueueWriteBuffer<TYPE>(total, yPacked.data(), yBuff, CL_FALSE);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << res << '\n';
+		std::cout << "Problem in write buffer enqueue\n";
+		fail();
+		return;
+	}
+
+	res = task->passParams(sizesBuff, offsetsBuff, alphasBuff, xBuff, yBuff);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in params passing process\n";
+		std::cout << res << std::endl;
+		fail();
+		return;
+	}
+
+	size_t globalSize[]{ longest, batch.size() };
+	double kernelTime{};
+	res = task->enqueueKernel(2, NULL, globalSize, &kernelTime);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "With enqueue task proc problems\n";
+		fail();
+		return;
+	}
+
+	res = task->enqueueReadBuffer<TYPE>(total, yPacked.data(), yBuff);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in read buffer enqueue\n";
+		fail();
+		return;
+	}
+
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		auto& op = batch[i]->*args;
+		for (cl_long index = 0; index < sizes[i]; ++index)
+		{
+			(*op.y)[index * op.incy] = yPacked[offsets[i] + index];
+		}
+		batch[i]->axpyResult.set_value(EXIT_SUCCESS);
+	}
+}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <string>
+
+#include "DevWorker.h"
+
+namespace my
+{
+	struct CoalescerConfig
+	{
+		// How long a batch stays open after its first request arrives
+		std::chrono::microseconds window{ 200 };
+		// Upper bound on the time a request waits in the queue before launch
+		std::chrono::microseconds maxLatency{ 1000 };
+		// Largest number of requests merged into a single kernel launch
+		size_t maxBatch{ 64 };
+	};
+
+	// Front-end queue for many concurrent callers. Compatible requests that arrive
+	// within the configured window are merged into one launch on a cached GpuTask.
+	// Input and output vectors must stay alive until the returned future is ready.
+	class RequestCoalescer
+	{
+	public:
+		RequestCoalescer(const char* _deviceName, CoalescerConfig config = CoalescerConfig());
+		~RequestCoalescer();
+
+		RequestCoalescer(const RequestCoalescer&) = delete;
+		RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+
+		std::future<std::vector<cl_int>> submitMatMult(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB,
+			cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+		std::future<int> submitSaxpy(size_t size, cl_float a, const std::vector<cl_float>& x, cl_long incx,
+			std::vector<cl_float>& y, cl_long incy);
+		std::future<int> submitDaxpy(size_t size, cl_double a, const std::vector<cl_double>& x, cl_long incx,
+			std::vector<cl_double>& y, cl_long incy);
+
+	private:
+		enum class OpKind { MatMult, Saxpy, Daxpy };
+
+		template <typename TYPE>
+		struct AxpyArgs
+		{
+			size_t size{};
+			TYPE a{};
+			const std::vector<TYPE>* x{};
+			cl_long incx{};
+			std::vector<TYPE>* y{};
+			cl_long incy{};
+		};
+
+		struct Request
+		{
+			OpKind kind{};
+			std::chrono::steady_clock::time_point arrival;
+
+			const std::vector<cl_int>* matrA{};
+			const std::vector<cl_int>* matrB{};
+			cl_int sizeZ{}, sizeY{}, sizeX{};
+			std::promise<std::vector<cl_int>> matrResult;
+
+			AxpyArgs<cl_float> saxpy;
+			AxpyArgs<cl_double> daxpy;
+			std::promise<int> axpyResult;
+		};
+
+		struct BufferSlot
+		{
+			cl_mem mem{};
+			size_t capacity{};
+		};
+
+		void enqueue(std::unique_ptr<Request> request);
+		void dispatchLoop();
+		void dispatchBatch(std::deque<std::unique_ptr<Request>>& ready);
+
+		void launchMatMult(const std::vector<Request*>& batch);
+		template <typename TYPE>
+		void launchAxpy(const std::vector<Request*>& batch, AxpyArgs<TYPE> Request::* args, OpKind kind);
+
+		GpuTask* getTask(OpKind kind);
+		template <typename TYPE>
+		cl_mem ensureBuffer(GpuTask& task, OpKind kind, size_t slot, size_t count, int flags);
+
+		std::string m_deviceName;
+		CoalescerConfig m_config;
+
+		DevWorker m_worker;
+		std::map<OpKind, std::unique_ptr<GpuTask>> m_tasks;
+		std::map<OpKind, std::vector<BufferSlot>> m_buffers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::deque<std::unique_ptr<Request>> m_pending;
+		bool m_stop{ false };
+		std::thread m_dispatcher;
+	};
+}
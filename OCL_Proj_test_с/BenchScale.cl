@@ -0,0 +1,10 @@
+// Launched on a single work-item, so only host-side costs show up
+__kernel void operation(__global float * a, __global float * b,
+	int size, float scalar)
+{
+	size_t index = get_global_id(0);
+	if (index < size)
+	{
+		b[index] = a[index] * scalar;
+	}
+}
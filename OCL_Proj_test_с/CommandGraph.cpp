@@ -0,0 +1,432 @@
+#include "CommandGraph.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+#ifndef CL_API_CALL
+#define CL_API_CALL
+#endif
+
+namespace my
+{
+namespace
+{
+	// Entry points of cl_khr_command_buffer, resolved at runtime since the
+	// SDK headers in use may predate the extension
+	typedef struct _cl_command_buffer_khr* CommandBufferKhr;
+	typedef cl_uint SyncPointKhr;
+
+	typedef CommandBufferKhr(CL_API_CALL* CreateCommandBufferFn)(cl_uint, const cl_command_queue*, const cl_ulong*, cl_int*);
+	typedef cl_int(CL_API_CALL* FinalizeCommandBufferFn)(CommandBufferKhr);
+	typedef cl_int(CL_API_CALL* ReleaseCommandBufferFn)(CommandBufferKhr);
+	typedef cl_int(CL_API_CALL* EnqueueCommandBufferFn)(cl_uint, cl_command_queue*, CommandBufferKhr, cl_uint, const cl_event*, cl_event*);
+	typedef cl_int(CL_API_CALL* CommandNDRangeKernelFn)(CommandBufferKhr, cl_command_queue, const cl_ulong*, cl_kernel, cl_uint,
+		const size_t*, const size_t*, const size_t*, cl_uint, const SyncPointKhr*, SyncPointKhr*, void*);
+
+	struct CommandBufferApi
+	{
+		CreateCommandBufferFn create{};
+		FinalizeCommandBufferFn finalize{};
+		ReleaseCommandBufferFn release{};
+		EnqueueCommandBufferFn enqueue{};
+		CommandNDRangeKernelFn ndRangeKernel{};
+
+		bool isLoaded() const
+		{
+			return create && finalize && release && enqueue && ndRangeKernel;
+		}
+	};
+
+	const CommandBufferApi& commandBufferApi(cl_platform_id platform)
+	{
+		static std::mutex apiMutex;
+		static std::map<cl_platform_id, CommandBufferApi> apis;
+
+		std::lock_guard<std::mutex> lock(apiMutex);
+		auto found = apis.find(platform);
+		if (found != apis.end())
+		{
+			return found->second;
+		}
+
+		CommandBufferApi api;
+		api.create = reinterpret_cast<CreateCommandBufferFn>(
+			clGetExtensionFunctionAddressForPlatform(platform, "clCreateCommandBufferKHR"));
+		api.finalize = reinterpret_cast<FinalizeCommandBufferFn>(
+			clGetExtensionFunctionAddressForPlatform(platform, "clFinalizeCommandBufferKHR"));
+		api.release = reinterpret_cast<ReleaseCommandBufferFn>(
+			clGetExtensionFunctionAddressForPlatform(platform, "clReleaseCommandBufferKHR"));
+		api.enqueue = reinterpret_cast<EnqueueCommandBufferFn>(
+			clGetExtensionFunctionAddressForPlatform(platform, "clEnqueueCommandBufferKHR"));
+		api.ndRangeKernel = reinterpret_cast<CommandNDRangeKernelFn>(
+			clGetExtensionFunctionAddressForPlatform(platform, "clCommandNDRangeKernelKHR"));
+		return apis.emplace(platform, api).first->second;
+	}
+
+	cl_platform_id devicePlatform(cl_device_id device)
+	{
+		cl_platform_id platform{};
+		clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(platform), &platform, nullptr);
+		return platform;
+	}
+}
+
+CommandGraph::CommandGraph(const GpuTask& task)
+	: m_context(task.getContext()), m_queue(task.getQueue()), m_device(task.getDevice())
+{
+	cl_command_queue_properties properties{};
+	if (clGetCommandQueueInfo(m_queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, nullptr) == CL_SUCCESS)
+	{
+		m_inOrder = (properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) == 0;
+	}
+
+	size_t size{};
+	if (clGetDeviceInfo(m_device, CL_DEVICE_EXTENSIONS, 0, nullptr, &size) == CL_SUCCESS && size > 0)
+	{
+		std::string extensions(size, '\0');
+		clGetDeviceInfo(m_device, CL_DEVICE_EXTENSIONS, size, &extensions[0], nullptr);
+		m_commandBufferSupported = extensions.find("cl_khr_command_buffer") != std::string::npos &&
+			commandBufferApi(devicePlatform(m_device)).isLoaded();
+	}
+}
+
+CommandGraph::~CommandGraph()
+{
+	releaseCommandBuffer();
+}
+
+CommandGraph::NodeId CommandGraph::addNode(Node node)
+{
+	node.deps.erase(std::remove_if(node.deps.begin(), node.deps.end(),
+		[this](NodeId dep) { return dep >= m_nodes.size(); }), node.deps.end());
+	m_nodes.push_back(std::move(node));
+	releaseCommandBuffer();
+	m_argsChanged = true;
+	return m_nodes.size() - 1;
+}
+
+CommandGraph::NodeId CommandGraph::addWrite(cl_mem buffer, const void* hostPtr, size_t bytes, const std::vector<NodeId>& deps)
+{
+	Node node;
+	node.type = NodeType::Write;
+	node.deps = deps;
+	node.buffer = buffer;
+	node.srcPtr = hostPtr;
+	node.bytes = bytes;
+	return addNode(std::move(node));
+}
+
+CommandGraph::NodeId CommandGraph::addRead(cl_mem buffer, void* hostPtr, size_t bytes, const std::vector<NodeId>& deps)
+{
+	Node node;
+	node.type = NodeType::Read;
+	node.deps = deps;
+	node.buffer = buffer;
+	node.dstPtr = hostPtr;
+	node.bytes = bytes;
+	return addNode(std::move(node));
+}
+
+CommandGraph::NodeId CommandGraph::addCopy(cl_mem srcBuffer, cl_mem dstBuffer, size_t bytes, const std::vector<NodeId>& deps)
+{
+	Node node;
+	node.type = NodeType::Copy;
+	node.deps = deps;
+	node.buffer = srcBuffer;
+	node.dstBuffer = dstBuffer;
+	node.bytes = bytes;
+	return addNode(std::move(node));
+}
+
+CommandGraph::NodeId CommandGraph::addKernel(cl_kernel kernel, cl_uint numDims, const size_t* globalSize, const size_t* localSize,
+	const std::vector<NodeId>& deps)
+{
+	Node node;
+	node.type = NodeType::Kernel;
+	node.deps = deps;
+	node.kernel = kernel;
+	node.numDims = std::min<cl_uint>(numDims, 3);
+	node.hasLocalSize = localSize != nullptr;
+	for (cl_uint dim = 0; dim < node.numDims; ++dim)
+	{
+		node.globalSize[dim] = globalSize[dim];
+		node.localSize[dim] = localSize ? localSize[dim] : 0;
+	}
+
+	cl_uint numArgs{};
+	clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(numArgs), &numArgs, nullptr);
+	node.args.resize(numArgs);
+	node.dirtyArgs.resize(numArgs, false);
+	return addNode(std::move(node));
+}
+
+int CommandGraph::storeArg(NodeId node, cl_uint index, const void* value, size_t size)
+{
+	if (node >= m_nodes.size() || m_nodes[node].type != NodeType::Kernel)
+	{
+		return CL_INVALID_VALUE;
+	}
+	auto& kernelNode = m_nodes[node];
+	if (index >= kernelNode.args.size())
+	{
+		kernelNode.args.resize(index + 1);
+		kernelNode.dirtyArgs.resize(index + 1, false);
+	}
+
+	// Rebinding an identical value is free
+	auto& stored = kernelNode.args[index];
+	const unsigned char* bytes = static_cast<const unsigned char*>(value);
+	if (stored.size() == size && std::equal(stored.begin(), stored.end(), bytes))
+	{
+		return CL_SUCCESS;
+	}
+	stored.assign(bytes, bytes + size);
+	kernelNode.dirtyArgs[index] = true;
+	m_argsChanged = true;
+	return CL_SUCCESS;
+}
+
+int CommandGraph::setHostPtr(NodeId node, void* hostPtr)
+{
+	if (node >= m_nodes.size())
+	{
+		return CL_INVALID_VALUE;
+	}
+	auto& transfer = m_nodes[node];
+	if (transfer.type == NodeType::Write)
+	{
+		transfer.srcPtr = hostPtr;
+	}
+	else if (transfer.type == NodeType::Read)
+	{
+		transfer.dstPtr = hostPtr;
+	}
+	else
+	{
+		return CL_INVALID_VALUE;
+	}
+	return CL_SUCCESS;
+}
+
+int CommandGraph::setBuffer(NodeId node, cl_mem buffer)
+{
+	if (node >= m_nodes.size() || m_nodes[node].type == NodeType::Kernel)
+	{
+		return CL_INVALID_VALUE;
+	}
+	m_nodes[node].buffer = buffer;
+	return CL_SUCCESS;
+}
+
+int CommandGraph::bindArgs(NodeId node, bool all)
+{
+	auto& kernelNode = m_nodes[node];
+	for (cl_uint index = 0; index < kernelNode.args.size(); ++index)
+	{
+		const auto& arg = kernelNode.args[index];
+		if ((all || kernelNode.dirtyArgs[index]) && !arg.empty())
+		{
+			int err = clSetKernelArg(kernelNode.kernel, index, arg.size(), arg.data());
+			if (err != CL_SUCCESS)
+			{
+				return err;
+			}
+		}
+		kernelNode.dirtyArgs[index] = false;
+	}
+	m_boundBy[kernelNode.kernel] = node;
+	return CL_SUCCESS;
+}
+
+int CommandGraph::replay(double* totalTime)
+{
+	double start = omp_get_wtime();
+	int err = CL_SUCCESS;
+	if (m_argsChanged)
+	{
+		// The command buffer captured the old arguments; it is re-recorded on the next unchanged replay
+		releaseCommandBuffer();
+		err = replayOnHost();
+		m_argsChanged = false;
+	}
+	else if (canUseCommandBuffer() && (m_commandBuffer || recordCommandBuffer() == CL_SUCCESS))
+	{
+		err = replayWithCommandBuffer();
+	}
+	else
+	{
+		err = replayOnHost();
+	}
+	if (totalTime)
+	{
+		*totalTime = omp_get_wtime() - start;
+	}
+	return err;
+}
+
+int CommandGraph::replayOnHost()
+{
+	// An in-order queue already serialises the nodes, so events are only needed out of order
+	m_events.assign(m_inOrder ? 0 : m_nodes.size(), nullptr);
+	std::vector<cl_event> waitList;
+
+	int err = CL_SUCCESS;
+	for (NodeId id = 0; id < m_nodes.size() && err == CL_SUCCESS; ++id)
+	{
+		auto& node = m_nodes[id];
+		cl_event* event = nullptr;
+		if (!m_inOrder)
+		{
+			waitList.clear();
+			for (auto dep : node.deps)
+			{
+				waitList.push_back(m_events[dep]);
+			}
+			event = &m_events[id];
+		}
+		const cl_uint waitCount = static_cast<cl_uint>(waitList.size());
+		const cl_event* waitEvents = waitList.empty() ? nullptr : waitList.data();
+
+		switch (node.type)
+		{
+		case NodeType::Write:
+			err = clEnqueueWriteBuffer(m_queue, node.buffer, CL_FALSE, 0, node.bytes, node.srcPtr, waitCount, waitEvents, event);
+			break;
+		case NodeType::Read:
+			err = clEnqueueReadBuffer(m_queue, node.buffer, CL_FALSE, 0, node.bytes, node.dstPtr, waitCount, waitEvents, event);
+			break;
+		case NodeType::Copy:
+			err = clEnqueueCopyBuffer(m_queue, node.buffer, node.dstBuffer, 0, 0, node.bytes, waitCount, waitEvents, event);
+			break;
+		case NodeType::Kernel:
+		{
+			auto bound = m_boundBy.find(node.kernel);
+			err = bindArgs(id, bound == m_boundBy.end() || bound->second != id);
+			if (err == CL_SUCCESS)
+			{
+				err = clEnqueueNDRangeKernel(m_queue, node.kernel, node.numDims, NULL, node.globalSize,
+					node.hasLocalSize ? node.localSize : NULL, waitCount, waitEvents, event);
+			}
+			break;
+		}
+		}
+	}
+
+	int finishErr = clFinish(m_queue);
+	for (auto event : m_events)
+	{
+		if (event)
+		{
+			clReleaseEvent(event);
+		}
+	}
+	m_events.clear();
+	return err != CL_SUCCESS ? err : finishErr;
+}
+
+bool CommandGraph::canUseCommandBuffer() const
+{
+	if (!m_commandBufferSupported || !m_inOrder || m_nodes.empty())
+	{
+		return false;
+	}
+	// Uploads, then kernels, then downloads: host transfers stay outside the command buffer
+	size_t id = 0;
+	while (id < m_nodes.size() && m_nodes[id].type == NodeType::Write) ++id;
+	const size_t firstKernel = id;
+	while (id < m_nodes.size() && m_nodes[id].type == NodeType::Kernel) ++id;
+	const size_t lastKernel = id;
+	while (id < m_nodes.size() && m_nodes[id].type == NodeType::Read) ++id;
+	return id == m_nodes.size() && lastKernel > firstKernel;
+}
+
+int CommandGraph::recordCommandBuffer()
+{
+	const auto& api = commandBufferApi(devicePlatform(m_device));
+	int err = CL_SUCCESS;
+	CommandBufferKhr commandBuffer = api.create(1, &m_queue, nullptr, &err);
+	if (err != CL_SUCCESS)
+	{
+		m_commandBufferSupported = false;
+		return err;
+	}
+
+	std::map<NodeId, SyncPointKhr> syncPoints;
+	std::vector<SyncPointKhr> waitList;
+	for (NodeId id = 0; id < m_nodes.size() && err == CL_SUCCESS; ++id)
+	{
+		auto& node = m_nodes[id];
+		if (node.type != NodeType::Kernel)
+		{
+			continue;
+		}
+		waitList.clear();
+		for (auto dep : node.deps)
+		{
+			auto syncPoint = syncPoints.find(dep);
+			if (syncPoint != syncPoints.end())
+			{
+				waitList.push_back(syncPoint->second);
+			}
+		}
+
+		// Arguments are captured when the command is recorded
+		auto bound = m_boundBy.find(node.kernel);
+		err = bindArgs(id, bound == m_boundBy.end() || bound->second != id);
+		if (err == CL_SUCCESS)
+		{
+			SyncPointKhr syncPoint{};
+			err = api.ndRangeKernel(commandBuffer, nullptr, nullptr, node.kernel, node.numDims, nullptr, node.globalSize,
+				node.hasLocalSize ? node.localSize : nullptr, static_cast<cl_uint>(waitList.size()),
+				waitList.empty() ? nullptr : waitList.data(), &syncPoint, nullptr);
+			syncPoints[id] = syncPoint;
+		}
+	}
+	if (err == CL_SUCCESS)
+	{
+		err = api.finalize(commandBuffer);
+	}
+	if (err != CL_SUCCESS)
+	{
+		api.release(commandBuffer);
+		m_commandBufferSupported = false;
+		return err;
+	}
+	m_commandBuffer = commandBuffer;
+	return CL_SUCCESS;
+}
+
+int CommandGraph::replayWithCommandBuffer()
+{
+	const auto& api = commandBufferApi(devicePlatform(m_device));
+	int err = CL_SUCCESS;
+	NodeId id = 0;
+	for (; id < m_nodes.size() && m_nodes[id].type == NodeType::Write && err == CL_SUCCESS; ++id)
+	{
+		err = clEnqueueWriteBuffer(m_queue, m_nodes[id].buffer, CL_FALSE, 0, m_nodes[id].bytes, m_nodes[id].srcPtr, 0, NULL, NULL);
+	}
+	if (err == CL_SUCCESS)
+	{
+		err = api.enqueue(1, &m_queue, static_cast<CommandBufferKhr>(m_commandBuffer), 0, NULL, NULL);
+	}
+	for (; id < m_nodes.size() && err == CL_SUCCESS; ++id)
+	{
+		if (m_nodes[id].type == NodeType::Read)
+		{
+			err = clEnqueueReadBuffer(m_queue, m_nodes[id].buffer, CL_FALSE, 0, m_nodes[id].bytes, m_nodes[id].dstPtr, 0, NULL, NULL);
+		}
+	}
+	int finishErr = clFinish(m_queue);
+	return err != CL_SUCCESS ? err : finishErr;
+}
+
+void CommandGraph::releaseCommandBuffer()
+{
+	if (m_commandBuffer)
+	{
+		commandBufferApi(devicePlatform(m_device)).release(static_cast<CommandBufferKhr>(m_commandBuffer));
+		m_commandBuffer = nullptr;
+	}
+}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <map>
+#include <cstring>
+
+#include "GpuTask.h"
+
+namespace my
+{
+	// Sequence of transfers and kernel launches recorded once on a task's queue and
+	// replayed many times. Nodes may only depend on nodes recorded before them.
+	// Between replays, kernel arguments, host pointers and buffers can be rebound;
+	// only arguments that actually changed are passed to clSetKernelArg again.
+	// If the device supports cl_khr_command_buffer and the graph is shaped as
+	// uploads, kernels, downloads, the kernels are baked into a command buffer
+	// that is re-recorded only after their arguments change.
+	class CommandGraph
+	{
+	public:
+		using NodeId = size_t;
+
+		explicit CommandGraph(const GpuTask& task);
+		~CommandGraph();
+
+		CommandGraph(const CommandGraph&) = delete;
+		CommandGraph& operator=(const CommandGraph&) = delete;
+
+		NodeId addWrite(cl_mem buffer, const void* hostPtr, size_t bytes, const std::vector<NodeId>& deps = {});
+		NodeId addRead(cl_mem buffer, void* hostPtr, size_t bytes, const std::vector<NodeId>& deps = {});
+		NodeId addCopy(cl_mem srcBuffer, cl_mem dstBuffer, size_t bytes, const std::vector<NodeId>& deps = {});
+		NodeId addKernel(cl_kernel kernel, cl_uint numDims, const size_t* globalSize, const size_t* localSize,
+			const std::vector<NodeId>& deps = {});
+
+		template <typename Arg>
+		int setArg(NodeId node, cl_uint index, const Arg& arg)
+		{
+			return storeArg(node, index, &arg, sizeof(Arg));
+		}
+
+		template <typename... Targs>
+		int setArgs(NodeId node, const Targs&... args)
+		{
+			cl_uint index = 0;
+			int err = CL_SUCCESS;
+			int expand[] = { 0, (err = (err == CL_SUCCESS ? setArg(node, index++, args) : err))... };
+			(void)expand;
+			return err;
+		}
+
+		// Rebinding transfers never invalidates a recorded command buffer
+		int setHostPtr(NodeId node, void* hostPtr);
+		int setBuffer(NodeId node, cl_mem buffer);
+
+		// Runs every node and waits for the last one
+		int replay(double* totalTime = nullptr);
+
+		bool usesCommandBuffer() const
+		{
+			return m_commandBuffer != nullptr;
+		}
+
+	private:
+		enum class NodeType { Write, Read, Copy, Kernel };
+
+		struct Node
+		{
+			NodeType type{};
+			std::vector<NodeId> deps;
+
+			cl_mem buffer{};
+			cl_mem dstBuffer{};
+			const void* srcPtr{};
+			void* dstPtr{};
+			size_t bytes{};
+
+			cl_kernel kernel{};
+			cl_uint numDims{};
+			size_t globalSize[3]{};
+			size_t localSize[3]{};
+			bool hasLocalSize{};
+			std::vector<std::vector<unsigned char>> args;
+			std::vector<bool> dirtyArgs;
+		};
+
+		NodeId addNode(Node node);
+		int storeArg(NodeId node, cl_uint index, const void* value, size_t size);
+		int bindArgs(NodeId node, bool all);
+		int replayOnHost();
+		int replayWithCommandBuffer();
+		bool canUseCommandBuffer() const;
+		int recordCommandBuffer();
+		void releaseCommandBuffer();
+
+		cl_context m_context{};
+		cl_command_queue m_queue{};
+		cl_device_id m_device{};
+		bool m_inOrder{ true };
+
+		std::vector<Node> m_nodes;
+		// Node whose arguments are currently set on each kernel object
+		std::map<cl_kernel, NodeId> m_boundBy;
+		std::vector<cl_event> m_events;
+
+		bool m_commandBufferSupported{ false };
+		void* m_commandBuffer{};
+		bool m_argsChanged{ true };
+	};
+}
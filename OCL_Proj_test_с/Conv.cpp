@@ -0,0 +1,264 @@
+#include "Conv.h"
+#include "KernelCache.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <omp.h>
+
+namespace
+{
+	const size_t CONV_TILE{ 16 };
+	// CPU panels: PANEL_DEPTH rows of the unfolding by PANEL_WIDTH output pixels stay in L2
+	const int64_t PANEL_DEPTH{ 256 };
+	const int64_t PANEL_WIDTH{ 128 };
+
+	// Unsigned for integers, so that wrapping is defined
+	template <typename TYPE>
+	using AccType = std::conditional_t<std::is_integral_v<TYPE>, uint32_t, TYPE>;
+
+	bool checkSizes(size_t imageSize, size_t filtersSize, const Conv2dShape& shape)
+	{
+		if (!shape.isValid() ||
+			imageSize < static_cast<size_t>(shape.channels) * shape.height * shape.width ||
+			filtersSize < static_cast<size_t>(shape.filters) * shape.channels * shape.filterHeight * shape.filterWidth)
+		{
+			std::cout << "Invalid convolution shape or operand sizes\n";
+			return false;
+		}
+		return true;
+	}
+
+	// Rows [k0, k0 + depth) of the unfolded image for pixels [n0, n0 + width) into panel,
+	// width elements per row
+	template <typename TYPE>
+	void packPanel(const TYPE* image, const Conv2dShape& shape, int64_t k0, int64_t depth, int64_t n0, int64_t width,
+		AccType<TYPE>* panel)
+	{
+		const int64_t area = static_cast<int64_t>(shape.filterHeight) * shape.filterWidth;
+		const int64_t outWidth = shape.outWidth();
+		const bool flip = shape.mode == ConvMode::Convolution;
+		for (int64_t k = 0; k < depth; ++k)
+		{
+			const int64_t c = (k0 + k) / area;
+			int64_t r = (k0 + k) % area / shape.filterWidth;
+			int64_t s = (k0 + k) % area % shape.filterWidth;
+			if (flip)
+			{
+				r = shape.filterHeight - 1 - r;
+				s = shape.filterWidth - 1 - s;
+			}
+			const TYPE* plane = image + c * shape.height * shape.width;
+			AccType<TYPE>* row = panel + k * width;
+			int64_t oy = n0 / outWidth;
+			int64_t ox = n0 % outWidth;
+			for (int64_t j = 0; j < width; ++j)
+			{
+				const int64_t iy = oy * shape.strideY - shape.padY + r * shape.dilationY;
+				const int64_t ix = ox * shape.strideX - shape.padX + s * shape.dilationX;
+				row[j] = iy < 0 || iy >= shape.height || ix < 0 || ix >= shape.width ? 0 :
+					static_cast<AccType<TYPE>>(plane[iy * shape.width + ix]);
+				if (++ox == outWidth)
+				{
+					ox = 0;
+					++oy;
+				}
+			}
+		}
+	}
+
+	// Threads own disjoint pixel panels, so each result element is written by one thread
+	// and summed over the depth in order
+	template <typename TYPE>
+	std::vector<TYPE> conv2dCpuImpl(const std::vector<TYPE>& image, const std::vector<TYPE>& filters, const Conv2dShape& shape)
+	{
+		if (!checkSizes(image.size(), filters.size(), shape))
+		{
+			return {};
+		}
+		const int64_t pixels = static_cast<int64_t>(shape.outHeight()) * shape.outWidth();
+		const int64_t depth = static_cast<int64_t>(shape.channels) * shape.filterHeight * shape.filterWidth;
+		const int64_t panels = (pixels + PANEL_WIDTH - 1) / PANEL_WIDTH;
+		std::vector<TYPE> result(static_cast<size_t>(shape.filters) * pixels);
+		std::vector<AccType<TYPE>> panelScratch(static_cast<size_t>(omp_get_max_threads()) * PANEL_DEPTH * PANEL_WIDTH);
+
+#pragma omp parallel
+		{
+			AccType<TYPE>* panel = panelScratch.data() + static_cast<size_t>(omp_get_thread_num()) * PANEL_DEPTH * PANEL_WIDTH;
+			AccType<TYPE> acc[PANEL_WIDTH];
+#pragma omp for schedule(static)
+			for (int64_t p = 0; p < panels; ++p)
+			{
+				const int64_t n0 = p * PANEL_WIDTH;
+				const int64_t width = std::min(PANEL_WIDTH, pixels - n0);
+				for (int64_t k0 = 0; k0 < depth; k0 += PANEL_DEPTH)
+				{
+					const int64_t panelDepth = std::min(PANEL_DEPTH, depth - k0);
+					packPanel(image.data(), shape, k0, panelDepth, n0, width, panel);
+					for (int64_t m = 0; m < shape.filters; ++m)
+					{
+						TYPE* out = result.data() + m * pixels + n0;
+						for (int64_t j = 0; j < width; ++j)
+						{
+							acc[j] = k0 ? static_cast<AccType<TYPE>>(out[j]) : 0;
+						}
+						const TYPE* weights = filters.data() + m * depth + k0;
+						for (int64_t k = 0; k < panelDepth; ++k)
+						{
+							const AccType<TYPE> weight = static_cast<AccType<TYPE>>(weights[k]);
+							const AccType<TYPE>* row = panel + k * width;
+							for (int64_t j = 0; j < width; ++j)
+							{
+								acc[j] += weight * row[j];
+							}
+						}
+						for (int64_t j = 0; j < width; ++j)
+						{
+							out[j] = static_cast<TYPE>(acc[j]);
+						}
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	template <typename TYPE>
+	std::vector<TYPE> conv2dGpuImpl(const std::vector<TYPE>& image, const std::vector<TYPE>& filters, const Conv2dShape& shape,
+		const char* device, const char* typeName)
+	{
+		if (!checkSizes(image.size(), filters.size(), shape))
+		{
+			return {};
+		}
+		const size_t imageSize = static_cast<size_t>(shape.channels) * shape.height * shape.width;
+		const cl_uint depth = shape.channels * shape.filterHeight * shape.filterWidth;
+		const size_t filtersSize = static_cast<size_t>(shape.filters) * depth;
+		const cl_uint pixels = shape.outHeight() * shape.outWidth();
+		const cl_uint filtersCount = shape.filters;
+		std::vector<TYPE> result(static_cast<size_t>(filtersCount) * pixels);
+
+		std::string options = std::string("-D TYPE=") + typeName +
+			" -D IN_H=" + std::to_string(shape.height) + " -D IN_W=" + std::to_string(shape.width) +
+			" -D FILTER_H=" + std::to_string(shape.filterHeight) + " -D FILTER_W=" + std::to_string(shape.filterWidth) +
+			" -D OUT_W=" + std::to_string(shape.outWidth()) +
+			" -D STRIDE_Y=" + std::to_string(shape.strideY) + " -D STRIDE_X=" + std::to_string(shape.strideX) +
+			" -D PAD_Y=" + std::to_string(shape.padY) + " -D PAD_X=" + std::to_string(shape.padX) +
+			" -D DILATION_Y=" + std::to_string(shape.dilationY) + " -D DILATION_X=" + std::to_string(shape.dilationX);
+		if (shape.mode == ConvMode::Convolution)
+		{
+			options += " -D FLIP";
+		}
+
+		// The kernel has no generic build to fall back on, so the geometry goes in the build
+		// options rather than as defines, and every shape is cached as a program of its own
+		my::KernelCache::Lease lease = my::KernelCache::instance().acquire(device, my::kernels::conv2dImplicit.source, {},
+			options.c_str());
+		my::GpuTask& task = *lease;
+		if (task.isTaskFailed())
+		{
+			std::cout << "GpuTask creation failed!\n";
+			return {};
+		}
+
+		double totalTime = omp_get_wtime();
+		int res = CL_SUCCESS;
+		cl_mem filtersBuff = task.addBuffer<TYPE>(filtersSize, CL_MEM_READ_ONLY, res);
+		cl_mem imageBuff = res == CL_SUCCESS ? task.addBuffer<TYPE>(imageSize, CL_MEM_READ_ONLY, res) : nullptr;
+		cl_mem resultBuff = res == CL_SUCCESS ? task.addBuffer<TYPE>(result.size(), CL_MEM_WRITE_ONLY, res) : nullptr;
+		auto release = [&]()
+		{
+			for (cl_mem buffer : { filtersBuff, imageBuff, resultBuff })
+			{
+				if (buffer)
+				{
+					clReleaseMemObject(buffer);
+				}
+			}
+		};
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			release();
+			return {};
+		}
+
+		res = task.enqueueWriteBuffer<TYPE>(filtersSize, filters.data(), filtersBuff, CL_FALSE);
+		if (res == CL_SUCCESS)
+		{
+			res = task.enqueueWriteBuffer<TYPE>(imageSize, image.data(), imageBuff, CL_FALSE);
+		}
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in write buffer enqueue\n";
+			clFinish(task.getQueue());
+			release();
+			return {};
+		}
+
+		res = task.passParams(filtersBuff, imageBuff, resultBuff, filtersCount, pixels, depth);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in params passing process\n";
+			std::cout << res << std::endl;
+			clFinish(task.getQueue());
+			release();
+			return {};
+		}
+
+		size_t localSize[]{ CONV_TILE, CONV_TILE };
+		size_t globalSize[]{ (pixels + CONV_TILE - 1) / CONV_TILE * CONV_TILE, (filtersCount + CONV_TILE - 1) / CONV_TILE * CONV_TILE };
+		double kernelTime{};
+		res = task.enqueueKernel(2, localSize, globalSize, &kernelTime);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "With enqueue task proc problems\n";
+			clFinish(task.getQueue());
+			release();
+			return {};
+		}
+
+		res = task.enqueueReadBuffer<TYPE>(result.size(), result.data(), resultBuff);
+		release();
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in read buffer enqueue\n";
+			return {};
+		}
+		totalTime = omp_get_wtime() - totalTime;
+		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+		std::cout << "Total time on GPU: " << totalTime << '\n';
+		return result;
+	}
+}
+
+bool Conv2dShape::isValid() const
+{
+	return channels > 0 && height > 0 && width > 0 && filters > 0 && filterHeight > 0 && filterWidth > 0 &&
+		strideY > 0 && strideX > 0 && padY >= 0 && padX >= 0 && dilationY > 0 && dilationX > 0 &&
+		height + 2 * padY > dilationY * (filterHeight - 1) && width + 2 * padX > dilationX * (filterWidth - 1);
+}
+
+std::vector<cl_int> conv2dCpu(const std::vector<cl_int>& image, const std::vector<cl_int>& filters, const Conv2dShape& shape)
+{
+	return conv2dCpuImpl(image, filters, shape);
+}
+
+std::vector<cl_float> conv2dCpu(const std::vector<cl_float>& image, const std::vector<cl_float>& filters, const Conv2dShape& shape)
+{
+	return conv2dCpuImpl(image, filters, shape);
+}
+
+std::vector<cl_int> conv2dGpu(const std::vector<cl_int>& image, const std::vector<cl_int>& filters, const Conv2dShape& shape,
+	const char* device)
+{
+	return conv2dGpuImpl(image, filters, shape, device, "int");
+}
+
+std::vector<cl_float> conv2dGpu(const std::vector<cl_float>& image, const std::vector<cl_float>& filters, const Conv2dShape& shape,
+	const char* device)
+{
+	return conv2dGpuImpl(image, filters, shape, device, "float");
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <CL/cl.h>
+
+// Correlation slides the filter as is, as neural networks do; Convolution flips it first
+enum class ConvMode { Correlation, Convolution };
+
+// One image of channels x height x width and filters x channels x filterHeight x filterWidth
+// weights, all row-major; the result is filters x outHeight() x outWidth()
+struct Conv2dShape
+{
+	cl_int channels{};
+	cl_int height{};
+	cl_int width{};
+	cl_int filters{};
+	cl_int filterHeight{};
+	cl_int filterWidth{};
+	cl_int strideY{ 1 };
+	cl_int strideX{ 1 };
+	// Zeros assumed around the image on each side
+	cl_int padY{};
+	cl_int padX{};
+	cl_int dilationY{ 1 };
+	cl_int dilationX{ 1 };
+	ConvMode mode{ ConvMode::Correlation };
+
+	cl_int outHeight() const
+	{
+		return (height + 2 * padY - dilationY * (filterHeight - 1) - 1) / strideY + 1;
+	}
+	cl_int outWidth() const
+	{
+		return (width + 2 * padX - dilationX * (filterWidth - 1) - 1) / strideX + 1;
+	}
+	bool isValid() const;
+};
+
+// The convolution as a GEMM of the filters (filters x channels * filterHeight * filterWidth)
+// with the im2col unfolding of the image, which is never built: the CPU path packs patches
+// straight into cache-sized GEMM panels and the GPU kernel loads them straight into its
+// local-memory tiles, so memory stays at the size of the operands. Integer arithmetic wraps
+// modulo 2^32 as matMultCpu does; float results of the two paths may differ in rounding.
+std::vector<cl_int> conv2dCpu(const std::vector<cl_int>& image, const std::vector<cl_int>& filters, const Conv2dShape& shape);
+std::vector<cl_float> conv2dCpu(const std::vector<cl_float>& image, const std::vector<cl_float>& filters, const Conv2dShape& shape);
+
+std::vector<cl_int> conv2dGpu(const std::vector<cl_int>& image, const std::vector<cl_int>& filters, const Conv2dShape& shape,
+	const char* device);
+std::vector<cl_float> conv2dGpu(const std::vector<cl_float>& image, const std::vector<cl_float>& filters, const Conv2dShape& shape,
+	const char* device);
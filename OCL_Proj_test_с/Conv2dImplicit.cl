@@ -0,0 +1,50 @@
+// Tiled GEMM whose right operand is read through patchAt. The element type and the
+// geometry come as -D options, so the index arithmetic divides by constants
+#define TILE_SIZE 16
+#define FILTER_AREA (FILTER_H * FILTER_W)
+// Element k of the unfolded column of output pixel n, or 0 where the patch hangs over the padding
+inline TYPE patchAt(const __global TYPE * image, uint k, uint n)
+{
+	uint c = k / FILTER_AREA;
+	int r = (k % FILTER_AREA) / FILTER_W;
+	int s = (k % FILTER_AREA) % FILTER_W;
+#ifdef FLIP
+	r = FILTER_H - 1 - r;
+	s = FILTER_W - 1 - s;
+#endif
+	int iy = (int)(n / OUT_W) * STRIDE_Y - PAD_Y + r * DILATION_Y;
+	int ix = (int)(n % OUT_W) * STRIDE_X - PAD_X + s * DILATION_X;
+	if (iy < 0 || iy >= IN_H || ix < 0 || ix >= IN_W)
+		return 0;
+	return image[((size_t)c * IN_H + iy) * IN_W + ix];
+}
+
+__kernel void operation(const __global TYPE * filters,
+	const __global TYPE * image, __global TYPE * resMatr,
+	uint K, uint N, uint depth)
+{
+	uint n = get_global_id(0);
+	uint m = get_global_id(1);
+	uint ln = get_local_id(0);
+	uint lm = get_local_id(1);
+
+	__local TYPE tileA[TILE_SIZE][TILE_SIZE];
+	__local TYPE tileB[TILE_SIZE][TILE_SIZE];
+
+	TYPE sum = 0;
+	for (uint tileK = 0; tileK < depth; tileK += TILE_SIZE)
+	{
+		uint ka = tileK + ln;
+		uint kb = tileK + lm;
+		tileA[lm][ln] = (m < K && ka < depth) ? filters[(size_t)m * depth + ka] : 0;
+		tileB[lm][ln] = (kb < depth && n < N) ? patchAt(image, kb, n) : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		for (uint k = 0; k < TILE_SIZE; ++k)
+		{
+			sum += tileA[lm][k] * tileB[k][ln];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (m < K && n < N)
+		resMatr[(size_t)m * N + n] = sum;
+}
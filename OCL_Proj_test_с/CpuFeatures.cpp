@@ -0,0 +1,88 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(MY_X86)
+#include <cpuid.h>
+#endif
+#include <cstdint>
+
+namespace my
+{
+namespace
+{
+#ifdef MY_X86
+	void cpuid(int leaf, int subleaf, unsigned int regs[4])
+	{
+#if defined(_MSC_VER)
+		int info[4]{};
+		__cpuidex(info, leaf, subleaf);
+		for (int i = 0; i < 4; ++i)
+		{
+			regs[i] = static_cast<unsigned int>(info[i]);
+		}
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	uint64_t xgetbv0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax{}, edx{};
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+	}
+
+	CpuFeatures detect()
+	{
+		CpuFeatures features;
+		unsigned int regs[4]{};
+		cpuid(0, 0, regs);
+		const unsigned int maxLeaf = regs[0];
+		if (maxLeaf < 7)
+		{
+			return features;
+		}
+		cpuid(1, 0, regs);
+		// The OS has to save the wide registers on context switches, or using them corrupts other threads
+		const bool osxsave = (regs[2] >> 27) & 1;
+		const bool avx = (regs[2] >> 28) & 1;
+		if (!osxsave || !avx)
+		{
+			return features;
+		}
+		const uint64_t xcr0 = xgetbv0();
+		const bool ymmState = (xcr0 & 0x6) == 0x6;
+		const bool zmmState = ymmState && (xcr0 & 0xe0) == 0xe0;
+
+		cpuid(7, 0, regs);
+		const unsigned int maxSubleaf = regs[0];
+		features.avx2 = ymmState && ((regs[1] >> 5) & 1);
+		features.avx512f = zmmState && ((regs[1] >> 16) & 1);
+		features.avx512bw = features.avx512f && ((regs[1] >> 30) & 1);
+		features.avx512vnni = features.avx512bw && ((regs[2] >> 11) & 1);
+		if (maxSubleaf >= 1)
+		{
+			cpuid(7, 1, regs);
+			features.avxvnni = features.avx2 && ((regs[0] >> 4) & 1);
+		}
+		return features;
+	}
+#else
+	CpuFeatures detect()
+	{
+		return {};
+	}
+#endif
+}
+
+const CpuFeatures& cpuFeatures()
+{
+	static const CpuFeatures features = detect();
+	return features;
+}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// x86 SIMD paths are compiled whatever the project's /arch or -m flags and picked at run
+// time from cpuFeatures(): MSVC accepts any intrinsic without /arch, GCC and Clang accept
+// them in functions marked with MY_TARGET
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MY_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MY_TARGET(features)
+#else
+#define MY_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace my
+{
+	// Instruction sets both the processor and the OS (through the saved register state) support
+	struct CpuFeatures
+	{
+		bool avx2{};
+		bool avx512f{};
+		bool avx512bw{};
+		bool avx512vnni{};
+		bool avxvnni{};
+	};
+
+	// Queried once per process
+	const CpuFeatures& cpuFeatures();
+}
@@ -0,0 +1,156 @@
+#include "DagScheduler.h"
+
+namespace my
+{
+DagScheduler::DagScheduler(GpuTask& task, size_t queueCount)
+{
+	m_queues.push_back(task.getQueue());
+
+	cl_command_queue_properties properties{};
+	clGetCommandQueueInfo(task.getQueue(), CL_QUEUE_PROPERTIES, sizeof(properties), &properties, nullptr);
+	m_outOfOrder = (properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+	if (m_outOfOrder)
+	{
+		return;
+	}
+
+	// Extra in-order queues carry the transfers so they can overlap with kernels on the task queue
+	for (size_t i = 1; i < queueCount; ++i)
+	{
+		int err = CL_SUCCESS;
+		cl_command_queue queue = task.createQueue(err, properties);
+		if (err != CL_SUCCESS)
+		{
+			break;
+		}
+		m_queues.push_back(queue);
+		m_ownQueues.push_back(queue);
+	}
+}
+
+DagScheduler::~DagScheduler()
+{
+	wait();
+	for (auto event : m_events)
+	{
+		if (event)
+		{
+			clReleaseEvent(event);
+		}
+	}
+	for (auto queue : m_ownQueues)
+	{
+		clReleaseCommandQueue(queue);
+	}
+}
+
+cl_command_queue DagScheduler::pickQueue(bool transfer)
+{
+	if (m_outOfOrder || m_queues.size() == 1 || !transfer)
+	{
+		return m_queues[0];
+	}
+	return m_queues[1 + m_nextQueue++ % (m_queues.size() - 1)];
+}
+
+std::vector<cl_event> DagScheduler::waitList(const std::vector<NodeId>& deps) const
+{
+	std::vector<cl_event> events;
+	events.reserve(deps.size());
+	for (auto dep : deps)
+	{
+		if (dep < m_events.size() && m_events[dep])
+		{
+			events.push_back(m_events[dep]);
+		}
+	}
+	return events;
+}
+
+DagScheduler::NodeId DagScheduler::addNode(int err, cl_event event)
+{
+	if (err != CL_SUCCESS)
+	{
+		if (m_status == CL_SUCCESS)
+		{
+			m_status = err;
+		}
+		event = nullptr;
+	}
+	m_events.push_back(event);
+	return m_events.size() - 1;
+}
+
+DagScheduler::NodeId DagScheduler::addWrite(cl_mem buffer, const void* hostPtr, size_t bytes, const std::vector<NodeId>& deps)
+{
+	cl_command_queue queue = pickQueue(true);
+	auto events = waitList(deps);
+	cl_event event{};
+	int err = clEnqueueWriteBuffer(queue, buffer, CL_FALSE, 0, bytes, hostPtr,
+		static_cast<cl_uint>(events.size()), events.empty() ? NULL : events.data(), &event);
+	return addNode(err, event);
+}
+
+DagScheduler::NodeId DagScheduler::addRead(cl_mem buffer, void* hostPtr, size_t bytes, const std::vector<NodeId>& deps)
+{
+	cl_command_queue queue = pickQueue(true);
+	auto events = waitList(deps);
+	cl_event event{};
+	int err = clEnqueueReadBuffer(queue, buffer, CL_FALSE, 0, bytes, hostPtr,
+		static_cast<cl_uint>(events.size()), events.empty() ? NULL : events.data(), &event);
+	return addNode(err, event);
+}
+
+DagScheduler::NodeId DagScheduler::addCopy(cl_mem srcBuffer, cl_mem dstBuffer, size_t bytes, const std::vector<NodeId>& deps)
+{
+	cl_command_queue queue = pickQueue(true);
+	auto events = waitList(deps);
+	cl_event event{};
+	int err = clEnqueueCopyBuffer(queue, srcBuffer, dstBuffer, 0, 0, bytes,
+		static_cast<cl_uint>(events.size()), events.empty() ? NULL : events.data(), &event);
+	return addNode(err, event);
+}
+
+DagScheduler::NodeId DagScheduler::addKernel(cl_kernel kernel, cl_uint numDims, const size_t* globalSize, const size_t* localSize,
+	const std::vector<NodeId>& deps)
+{
+	cl_command_queue queue = pickQueue(false);
+	auto events = waitList(deps);
+	cl_event event{};
+	int err = clEnqueueNDRangeKernel(queue, kernel, numDims, NULL, globalSize, localSize,
+		static_cast<cl_uint>(events.size()), events.empty() ? NULL : events.data(), &event);
+	return addNode(err, event);
+}
+
+int DagScheduler::wait()
+{
+	for (auto queue : m_queues)
+	{
+		clFlush(queue);
+	}
+	for (auto queue : m_queues)
+	{
+		int err = clFinish(queue);
+		if (err != CL_SUCCESS && m_status == CL_SUCCESS)
+		{
+			m_status = err;
+		}
+	}
+	return m_status;
+}
+
+double DagScheduler::nodeTime(NodeId node) const
+{
+	if (node >= m_events.size() || !m_events[node])
+	{
+		return 0;
+	}
+	cl_ulong start{}, end{};
+	if (clGetEventProfilingInfo(m_events[node], CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) != CL_SUCCESS ||
+		clGetEventProfilingInfo(m_events[node], CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) != CL_SUCCESS)
+	{
+		return 0;
+	}
+	return (end - start) * 1e-9;
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+
+#include "GpuTask.h"
+
+namespace my
+{
+	// Submits transfers and kernels as soon as they are added, ordered only by
+	// the dependencies given for them, which become event wait lists. Works on an
+	// out-of-order task queue, or spreads independent work over several in-order
+	// queues on the task's context when the device lacks out-of-order execution.
+	// Kernel arguments are captured at submission, so a kernel object can be
+	// re-armed with new arguments right after it has been added.
+	class DagScheduler
+	{
+	public:
+		using NodeId = size_t;
+
+		explicit DagScheduler(GpuTask& task, size_t queueCount = 2);
+		~DagScheduler();
+
+		DagScheduler(const DagScheduler&) = delete;
+		DagScheduler& operator=(const DagScheduler&) = delete;
+
+		NodeId addWrite(cl_mem buffer, const void* hostPtr, size_t bytes, const std::vector<NodeId>& deps = {});
+		NodeId addRead(cl_mem buffer, void* hostPtr, size_t bytes, const std::vector<NodeId>& deps = {});
+		NodeId addCopy(cl_mem srcBuffer, cl_mem dstBuffer, size_t bytes, const std::vector<NodeId>& deps = {});
+		NodeId addKernel(cl_kernel kernel, cl_uint numDims, const size_t* globalSize, const size_t* localSize,
+			const std::vector<NodeId>& deps = {});
+
+		// Waits for every submitted node and returns the first error met, if any
+		int wait();
+
+		// Device-side duration of a finished node, 0 unless the queue profiles
+		double nodeTime(NodeId node) const;
+
+		size_t queueCount() const
+		{
+			return m_queues.size();
+		}
+
+	private:
+		cl_command_queue pickQueue(bool transfer);
+		std::vector<cl_event> waitList(const std::vector<NodeId>& deps) const;
+		NodeId addNode(int err, cl_event event);
+
+		std::vector<cl_command_queue> m_queues;
+		// Queues created here rather than borrowed from the task
+		std::vector<cl_command_queue> m_ownQueues;
+		bool m_outOfOrder{ false };
+		size_t m_nextQueue{ 0 };
+
+		std::vector<cl_event> m_events;
+		int m_status{ CL_SUCCESS };
+	};
+}
@@ -0,0 +1,25 @@
+// Sizes and strides fall back to the kernel arguments unless KernelCache bakes them in with -D
+#ifndef SIZE_N
+#define SIZE_N n
+#endif
+#ifndef INC_X
+#define INC_X incx
+#endif
+#ifndef INC_Y
+#define INC_Y incy
+#endif
+#ifndef SIZE_XBUF
+#define SIZE_XBUF xSize
+#endif
+#ifndef SIZE_YBUF
+#define SIZE_YBUF ySize
+#endif
+__kernel void operation(long n, double a,
+	const __global double * x, long incx, long xSize,
+	__global double * y, long incy, long ySize)
+{
+	int index = get_global_id(0);
+	if (index * INC_X >= SIZE_XBUF || index * INC_Y >= SIZE_YBUF) return;
+	if (index < SIZE_N)
+		y[index * INC_Y] = y[index * INC_Y] + a * x[index * INC_X];
+}
@@ -1,5 +1,7 @@
 #include "DevWorker.h"
 
+#include <algorithm>
+
 namespace my
 {
 void DevWorker::initDevices()
@@ -45,17 +47,104 @@ bool DevWorker::findDeviceByName(cl_platform_id& platformId, cl_device_id& devic
 	return false;
 }
 
-GpuTask DevWorker::createGpuTask(const char* _deviceName, const char* _sourceKernel)
+GpuTask DevWorker::createGpuTask(const char* _deviceName, const char* _sourceKernel, const char* _buildOptions,
+	cl_command_queue_properties _queueProperties)
 {
 	cl_device_id device;
 	cl_platform_id platform;
 	if (findDeviceByName(platform, device, _deviceName))
 	{
-		return GpuTask(device, _sourceKernel);
+		return GpuTask(device, _sourceKernel, _buildOptions, _queueProperties);
 	}
 	return GpuTask();
 }
 
+GpuTask DevWorker::createGpuTask(cl_device_id device, const char* _sourceKernel, const char* _buildOptions,
+	cl_command_queue_properties _queueProperties)
+{
+	if (!device)
+	{
+		return GpuTask();
+	}
+	return GpuTask(device, _sourceKernel, _buildOptions, _queueProperties);
+}
+
+std::vector<cl_device_id> DevWorker::createSubDevices(const char* _deviceName, const std::vector<cl_device_partition_property>& properties)
+{
+	cl_device_id device;
+	cl_platform_id platform;
+	if (!findDeviceByName(platform, device, _deviceName))
+	{
+		return {};
+	}
+
+	size_t size{};
+	clGetDeviceInfo(device, CL_DEVICE_PARTITION_PROPERTIES, 0, nullptr, &size);
+	std::vector<cl_device_partition_property> supported(size / sizeof(cl_device_partition_property));
+	clGetDeviceInfo(device, CL_DEVICE_PARTITION_PROPERTIES, size, supported.data(), nullptr);
+	if (std::find(supported.begin(), supported.end(), properties.front()) == supported.end())
+	{
+		std::cout << "Device does not support this partitioning\n";
+		return {};
+	}
+
+	cl_uint count{};
+	int err = clCreateSubDevices(device, properties.data(), 0, nullptr, &count);
+	if (err != CL_SUCCESS || count == 0)
+	{
+		std::cout << "Sub-device creation error: " << err << '\n';
+		return {};
+	}
+	std::vector<cl_device_id> subDevices(count);
+	err = clCreateSubDevices(device, properties.data(), count, subDevices.data(), nullptr);
+	if (err != CL_SUCCESS)
+	{
+		std::cout << "Sub-device creation error: " << err << '\n';
+		return {};
+	}
+	return subDevices;
+}
+
+std::vector<cl_device_id> DevWorker::partitionEqually(const char* _deviceName, cl_uint computeUnits)
+{
+	return createSubDevices(_deviceName, { CL_DEVICE_PARTITION_EQUALLY, static_cast<cl_device_partition_property>(computeUnits), 0 });
+}
+
+std::vector<cl_device_id> DevWorker::partitionByCounts(const char* _deviceName, const std::vector<cl_uint>& computeUnits)
+{
+	std::vector<cl_device_partition_property> properties{ CL_DEVICE_PARTITION_BY_COUNTS };
+	for (auto units : computeUnits)
+	{
+		properties.push_back(static_cast<cl_device_partition_property>(units));
+	}
+	properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+	properties.push_back(0);
+	return createSubDevices(_deviceName, properties);
+}
+
+std::vector<cl_device_id> DevWorker::partitionByAffinity(const char* _deviceName, cl_device_affinity_domain domain)
+{
+	return createSubDevices(_deviceName, { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, static_cast<cl_device_partition_property>(domain), 0 });
+}
+
+bool DevWorker::hasExtension(const char* _deviceName, const char* _extension)
+{
+	cl_device_id device;
+	cl_platform_id platform;
+	if (!findDeviceByName(platform, device, _deviceName))
+	{
+		return false;
+	}
+	size_t size{};
+	if (clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, nullptr, &size) != CL_SUCCESS || size == 0)
+	{
+		return false;
+	}
+	std::string extensions(size, '\0');
+	clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, size, &extensions[0], nullptr);
+	return extensions.find(_extension) != std::string::npos;
+}
+
 DevWorker::DevWorker()
 {
 	initDevices();
@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <string>
 #include "GpuTask.h"
 
 namespace my
@@ -23,9 +24,27 @@ namespace my
 
 		bool findDeviceByName(cl_platform_id& platformId, cl_device_id& deviceId, const char* _deviceName);
 
+		std::vector<cl_device_id> createSubDevices(const char* _deviceName, const std::vector<cl_device_partition_property>& properties);
+
 	public:
 
-		GpuTask createGpuTask(const char* _deviceName, const char* _sourceKernel);
+		GpuTask createGpuTask(const char* _deviceName, const char* _sourceKernel, const char* _buildOptions = nullptr,
+			cl_command_queue_properties _queueProperties = 0);
+		// For devices found by handle, such as sub-devices, which share the name of their parent
+		GpuTask createGpuTask(cl_device_id device, const char* _sourceKernel, const char* _buildOptions = nullptr,
+			cl_command_queue_properties _queueProperties = 0);
+
+		// Sub-devices of the first device matching _deviceName, each a disjoint set of its
+		// compute units (cores on CPU runtimes), so tasks on different sub-devices do not
+		// compete for cores or caches. Released by the caller with clReleaseDevice;
+		// empty if the device cannot be partitioned that way.
+		std::vector<cl_device_id> partitionEqually(const char* _deviceName, cl_uint computeUnits);
+		std::vector<cl_device_id> partitionByCounts(const char* _deviceName, const std::vector<cl_uint>& computeUnits);
+		// One sub-device per NUMA node, L3 cache, etc.; NEXT_PARTITIONABLE picks the outermost level available
+		std::vector<cl_device_id> partitionByAffinity(const char* _deviceName,
+			cl_device_affinity_domain domain = CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE);
+
+		bool hasExtension(const char* _deviceName, const char* _extension);
 
 		DevWorker();
 	};
@@ -0,0 +1,219 @@
+#include "DeviceSelector.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "Roofline.h"
+#include "ReportHelpers.h"
+
+namespace my
+{
+DeviceSelector& DeviceSelector::instance()
+{
+	static DeviceSelector selector;
+	return selector;
+}
+
+DeviceSelector::DeviceSelector()
+{
+	cl_uint platformCount{ 0 };
+	clGetPlatformIDs(0, nullptr, &platformCount);
+	std::vector<cl_platform_id> platforms(platformCount);
+	clGetPlatformIDs(platformCount, platforms.data(), nullptr);
+
+	for (const auto& platform : platforms)
+	{
+		cl_uint numDevices{ 0 };
+		clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, nullptr, &numDevices);
+		std::vector<cl_device_id> devices(numDevices);
+		clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, numDevices, devices.data(), nullptr);
+
+		for (const auto& device : devices)
+		{
+			DeviceInfo info;
+			info.platform = platform;
+			info.device = device;
+			info.name = deviceString(device, CL_DEVICE_NAME);
+			info.vendor = deviceString(device, CL_DEVICE_VENDOR);
+			info.extensions = deviceString(device, CL_DEVICE_EXTENSIONS);
+			info.type = deviceValue<cl_device_type>(device, CL_DEVICE_TYPE);
+			info.computeUnits = deviceValue<cl_uint>(device, CL_DEVICE_MAX_COMPUTE_UNITS);
+			info.clockMHz = deviceValue<cl_uint>(device, CL_DEVICE_MAX_CLOCK_FREQUENCY);
+			info.globalMemSize = deviceValue<cl_ulong>(device, CL_DEVICE_GLOBAL_MEM_SIZE);
+			info.localMemSize = deviceValue<cl_ulong>(device, CL_DEVICE_LOCAL_MEM_SIZE);
+			info.maxAllocSize = deviceValue<cl_ulong>(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE);
+			info.maxWorkGroupSize = deviceValue<size_t>(device, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+			info.fp64 = deviceValue<cl_device_fp_config>(device, CL_DEVICE_DOUBLE_FP_CONFIG) != 0;
+			info.integerDot = info.extensions.find("cl_khr_integer_dot_product") != std::string::npos;
+			info.unifiedMemory = deviceValue<cl_bool>(device, CL_DEVICE_HOST_UNIFIED_MEMORY) == CL_TRUE;
+
+			// Rough peaks until calibrated: lanes per compute unit, one multiply-add per lane and clock
+			const double lanes = (info.type & CL_DEVICE_TYPE_GPU) ? 64 : 8;
+			info.fp32Rate = 2.0 * lanes * info.computeUnits * info.clockMHz * 1e6;
+			info.int32Rate = info.fp32Rate / 4;
+			info.fp64Rate = info.fp64 ? info.fp32Rate / 16 : 0;
+			info.bandwidth = (info.type & CL_DEVICE_TYPE_GPU) && !info.unifiedMemory ? 100e9 : 20e9;
+			info.transferRate = 8e9;
+			info.launchLatency = 20e-6;
+			m_devices.push_back(std::move(info));
+		}
+	}
+}
+
+const DeviceInfo* DeviceSelector::find(cl_device_id device) const
+{
+	for (const auto& info : m_devices)
+	{
+		if (info.device == device)
+		{
+			return &info;
+		}
+	}
+	return nullptr;
+}
+
+const DeviceInfo* DeviceSelector::findByName(const char* _deviceName) const
+{
+	for (const auto& info : m_devices)
+	{
+		if (info.name.find(_deviceName) != std::string::npos)
+		{
+			return &info;
+		}
+	}
+	return nullptr;
+}
+
+void DeviceSelector::calibrate()
+{
+	std::call_once(m_calibrated, [this]()
+	{
+		for (auto& info : m_devices)
+		{
+			if (!info.calibrated)
+			{
+				calibrateDevice(info);
+			}
+		}
+	});
+}
+
+void DeviceSelector::calibrateDevice(DeviceInfo& info)
+{
+	applyProfile(info, measureRoofline(info.device));
+}
+
+void DeviceSelector::applyProfile(DeviceInfo& info, const RooflineProfile& profile)
+{
+	// Unmeasured peaks keep their estimates
+	const double bandwidth = std::max(profile.copyBandwidth, profile.triadBandwidth);
+	if (bandwidth > 0)
+	{
+		info.bandwidth = bandwidth;
+	}
+	if (profile.hostToDevicePageable > 0)
+	{
+		info.transferRate = profile.hostToDevicePageable;
+	}
+	if (profile.int32Rate > 0)
+	{
+		info.int32Rate = profile.int32Rate;
+	}
+	if (profile.fp32Rate > 0)
+	{
+		info.fp32Rate = profile.fp32Rate;
+	}
+	if (profile.fp64Rate > 0)
+	{
+		info.fp64Rate = profile.fp64Rate;
+	}
+	if (profile.launchLatency > 0)
+	{
+		info.launchLatency = profile.launchLatency;
+	}
+	info.calibrated = true;
+}
+
+size_t DeviceSelector::loadProfiles(const char* path)
+{
+	std::ifstream in(path);
+	if (!in)
+	{
+		std::cout << "Cannot open " << path << '\n';
+		return 0;
+	}
+	size_t loaded{};
+	for (const auto& profile : readRooflineJson(in))
+	{
+		for (auto& info : m_devices)
+		{
+			if (!info.calibrated && info.name == profile.name && info.vendor == profile.vendor)
+			{
+				applyProfile(info, profile);
+				++loaded;
+				break;
+			}
+		}
+	}
+	return loaded;
+}
+
+double DeviceSelector::estimateTime(const DeviceInfo& info, Operation operation, size_t sizeZ, size_t sizeY, size_t sizeX) const
+{
+	double ops{}, opRate{}, deviceBytes{}, hostBytes{};
+	switch (operation)
+	{
+	case Operation::Saxpy:
+	case Operation::Daxpy:
+	{
+		const double elemSize = operation == Operation::Saxpy ? sizeof(cl_float) : sizeof(cl_double);
+		ops = 2.0 * sizeZ;
+		opRate = operation == Operation::Saxpy ? info.fp32Rate : info.fp64Rate;
+		deviceBytes = 3.0 * elemSize * sizeZ;
+		hostBytes = deviceBytes;
+		break;
+	}
+	case Operation::MatMult:
+	case Operation::MatMultQuant:
+	{
+		// Operands are re-read once per 16-wide tile of the result
+		const double elemSize = operation == Operation::MatMult ? sizeof(cl_int) : sizeof(cl_char);
+		const double z = static_cast<double>(sizeZ), y = static_cast<double>(sizeY), x = static_cast<double>(sizeX);
+		ops = 2.0 * z * y * x;
+		opRate = operation == Operation::MatMultQuant && info.integerDot ? 4 * info.int32Rate : info.int32Rate;
+		deviceBytes = elemSize * (z * y * x / 8) + sizeof(cl_int) * z * x;
+		hostBytes = elemSize * (z * y + y * x) + sizeof(cl_int) * z * x;
+		break;
+	}
+	}
+	if (opRate <= 0 || info.bandwidth <= 0)
+	{
+		return -1;
+	}
+	const double transferTime = info.unifiedMemory || info.transferRate <= 0 ? 0 : hostBytes / info.transferRate;
+	return info.launchLatency + transferTime + std::max(ops / opRate, deviceBytes / info.bandwidth);
+}
+
+const DeviceInfo* DeviceSelector::select(Operation operation, size_t sizeZ, size_t sizeY, size_t sizeX,
+	const std::function<bool(const DeviceInfo&)>& filter)
+{
+	calibrate();
+	const DeviceInfo* best = nullptr;
+	double bestTime{};
+	for (const auto& info : m_devices)
+	{
+		if (filter && !filter(info))
+		{
+			continue;
+		}
+		double time = estimateTime(info, operation, sizeZ, sizeY, sizeX);
+		if (time >= 0 && (!best || time < bestTime))
+		{
+			best = &info;
+			bestTime = time;
+		}
+	}
+	return best;
+}
+}
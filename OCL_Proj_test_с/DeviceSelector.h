@@ -0,0 +1,85 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <mutex>
+
+namespace my
+{
+	struct RooflineProfile;
+
+	enum class Operation { Saxpy, Daxpy, MatMult, MatMultQuant };
+
+	struct DeviceInfo
+	{
+		cl_platform_id platform{};
+		cl_device_id device{};
+		std::string name;
+		std::string vendor;
+		std::string extensions;
+		cl_device_type type{};
+		cl_uint computeUnits{};
+		cl_uint clockMHz{};
+		cl_ulong globalMemSize{};
+		cl_ulong localMemSize{};
+		cl_ulong maxAllocSize{};
+		size_t maxWorkGroupSize{};
+		bool fp64{};
+		bool integerDot{};
+		// Buffers created with CL_MEM_USE_HOST_PTR need no copies
+		bool unifiedMemory{};
+
+		// Throughput model, estimated from the properties above and
+		// replaced by micro-benchmark results once calibrated
+		bool calibrated{};
+		double bandwidth{};			// device memory, bytes/s
+		double transferRate{};		// host to device, bytes/s
+		double int32Rate{};			// ops/s
+		double fp32Rate{};			// flops/s
+		double fp64Rate{};			// flops/s
+		double launchLatency{};		// s
+	};
+
+	// Process-wide cache of every OpenCL device and its properties. Picks the
+	// device with the lowest estimated time for an operation of a given size:
+	// launch latency + host transfers + max(compute time, memory time).
+	class DeviceSelector
+	{
+	public:
+		static DeviceSelector& instance();
+
+		DeviceSelector(const DeviceSelector&) = delete;
+		DeviceSelector& operator=(const DeviceSelector&) = delete;
+
+		const std::vector<DeviceInfo>& devices() const
+		{
+			return m_devices;
+		}
+		const DeviceInfo* find(cl_device_id device) const;
+		// First device whose name contains _deviceName, as DevWorker matches them
+		const DeviceInfo* findByName(const char* _deviceName) const;
+
+		// Runs the micro-benchmarks on every device; done once, on first selection at the latest
+		void calibrate();
+		// Takes measurements from a roofline profile (see runRoofline) for the devices it names,
+		// so that calibrate() skips them; returns how many devices were matched
+		size_t loadProfiles(const char* path);
+
+		// Sizes are (Z, Y, X) for matrix products and the element count for axpy.
+		// Returns a negative time if the device cannot run the operation
+		double estimateTime(const DeviceInfo& info, Operation operation, size_t sizeZ, size_t sizeY = 1, size_t sizeX = 1) const;
+
+		const DeviceInfo* select(Operation operation, size_t sizeZ, size_t sizeY = 1, size_t sizeX = 1,
+			const std::function<bool(const DeviceInfo&)>& filter = nullptr);
+
+	private:
+		DeviceSelector();
+
+		static void calibrateDevice(DeviceInfo& info);
+		static void applyProfile(DeviceInfo& info, const RooflineProfile& profile);
+
+		std::vector<DeviceInfo> m_devices;
+		std::once_flag m_calibrated;
+	};
+}
@@ -0,0 +1,42 @@
+# Turns a .cl file, and the SPIR-V compiled from it if any, into a header that
+# KernelLibrary.cpp includes: NAME_SOURCE, NAME_IL and NAME_IL_SIZE, where NAME
+# is the file name in upper case.
+param(
+	[Parameter(Mandatory = $true)][string]$Source,
+	[string]$IL = "",
+	[Parameter(Mandatory = $true)][string]$Output
+)
+
+$ErrorActionPreference = "Stop"
+
+$name = [System.IO.Path]::GetFileNameWithoutExtension($Source).ToUpperInvariant()
+$text = [System.IO.File]::ReadAllText($Source)
+if ($text.Contains(')CLC"')) {
+	throw "$Source contains the raw string delimiter )CLC`""
+}
+
+$builder = New-Object System.Text.StringBuilder
+[void]$builder.AppendLine("// Generated from $([System.IO.Path]::GetFileName($Source)) by EmbedKernel.ps1, do not edit")
+[void]$builder.AppendLine("#pragma once")
+[void]$builder.AppendLine("static char const ${name}_SOURCE[] = R`"CLC($text)CLC`";")
+
+if ($IL -ne "") {
+	$bytes = [System.IO.File]::ReadAllBytes($IL)
+	[void]$builder.AppendLine("static unsigned char const ${name}_IL[] = {")
+	for ($i = 0; $i -lt $bytes.Length; $i += 16) {
+		$line = ($bytes[$i..([Math]::Min($i + 15, $bytes.Length - 1))] | ForEach-Object { "0x{0:x2}" -f $_ }) -join ", "
+		[void]$builder.AppendLine("`t$line,")
+	}
+	[void]$builder.AppendLine("};")
+	[void]$builder.AppendLine("static size_t const ${name}_IL_SIZE = $($bytes.Length);")
+}
+else {
+	[void]$builder.AppendLine("static unsigned char const ${name}_IL[] = { 0 };")
+	[void]$builder.AppendLine("static size_t const ${name}_IL_SIZE = 0;")
+}
+
+$directory = [System.IO.Path]::GetDirectoryName($Output)
+if ($directory -ne "" -and -not (Test-Path $directory)) {
+	New-Item -ItemType Directory -Path $directory | Out-Null
+}
+[System.IO.File]::WriteAllText($Output, $builder.ToString())
@@ -0,0 +1,260 @@
+#include "GpuAsync.h"
+
+#include <iostream>
+
+#include "DeviceSelector.h"
+#include "KernelCache.h"
+#include "KernelLibrary.h"
+#include "GpuTask.h"
+
+namespace my
+{
+ResumePool::ResumePool(size_t threadsCount)
+{
+	for (size_t i = 0; i < threadsCount; ++i)
+	{
+		m_threads.emplace_back(&ResumePool::run, this);
+	}
+}
+
+ResumePool::~ResumePool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void ResumePool::post(std::coroutine_handle<> handle)
+{
+	// Notified under the lock: once the coroutine runs, the pool may be destroyed at any moment
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ready.push_back(handle);
+	m_cv.notify_one();
+}
+
+void ResumePool::run()
+{
+	for (;;)
+	{
+		std::coroutine_handle<> handle;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this]()
+			{
+				return m_stop || !m_ready.empty();
+			});
+			// Coroutines still queued are resumed before the pool goes away
+			if (m_ready.empty())
+			{
+				return;
+			}
+			handle = m_ready.front();
+			m_ready.pop_front();
+		}
+		handle.resume();
+	}
+}
+
+bool EventAwaiter::await_ready()
+{
+	cl_int status{};
+	if (clGetEventInfo(m_event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL) != CL_SUCCESS)
+	{
+		return false;
+	}
+	if (status > CL_COMPLETE)
+	{
+		return false;
+	}
+	m_status = status;
+	return true;
+}
+
+bool EventAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	m_handle = handle;
+	// Callbacks only fire for commands the device has been given
+	cl_command_queue queue{};
+	if (clGetEventInfo(m_event, CL_EVENT_COMMAND_QUEUE, sizeof(queue), &queue, NULL) == CL_SUCCESS && queue)
+	{
+		clFlush(queue);
+	}
+	// The callback may resume the coroutine on another thread before this returns,
+	// so nothing of the awaiter is touched once it is registered
+	const cl_int err = clSetEventCallback(m_event, CL_COMPLETE, &EventAwaiter::onComplete, this);
+	if (err != CL_SUCCESS)
+	{
+		m_status = err;
+		return false;
+	}
+	return true;
+}
+
+void CL_CALLBACK EventAwaiter::onComplete(cl_event /*event*/, cl_int status, void* userData)
+{
+	EventAwaiter* awaiter = static_cast<EventAwaiter*>(userData);
+	awaiter->m_status = status;
+	if (awaiter->m_resumer)
+	{
+		awaiter->m_resumer->post(awaiter->m_handle);
+	}
+	else
+	{
+		awaiter->m_handle.resume();
+	}
+}
+
+namespace
+{
+	template <typename TYPE>
+	CoTask<int> axpyGpuAsync(const char* source, size_t size, TYPE a_gpu, const std::vector<TYPE>& x_gpu, cl_long incx,
+		std::vector<TYPE>& y_gpu, cl_long incy, const char* _deviceName, Resumer* resumer)
+	{
+		if (size <= 0 || incx <= 0 || incy <= 0)
+		{
+			co_return EXIT_FAILURE;
+		}
+
+		int res = CL_SUCCESS;
+		const size_t xBuffSize = x_gpu.size();
+		const size_t yBuffSize = y_gpu.size();
+		size_t localSize{};
+		size_t globalSize{};
+		cl_context context{};
+		cl_command_queue queue{};
+		cl_kernel kernel{};
+		bool zeroCopy{ false };
+		{
+			// Only the program is shared: the call sets its arguments on a kernel object of
+			// its own, so the cached task goes back to the cache before the first suspension
+			KernelCache::Lease lease = KernelCache::instance().acquire(_deviceName, source,
+				{ { "SIZE_N", size }, { "INC_X", incx }, { "INC_Y", incy }, { "SIZE_XBUF", xBuffSize }, { "SIZE_YBUF", yBuffSize } });
+			GpuTask& task = *lease;
+			if (task.isTaskFailed())
+			{
+				std::cout << "GpuTask creation failed!\n";
+				co_return EXIT_FAILURE;
+			}
+			kernel = task.createKernel("operation", res);
+			if (res != CL_SUCCESS)
+			{
+				std::cout << "Kernel creation failed!\n";
+				co_return EXIT_FAILURE;
+			}
+			task.getDecomposition(&localSize, &globalSize, &size);
+			context = task.getContext();
+			// Outlives an eviction of the cached task while the commands are in flight
+			queue = task.getQueue();
+			clRetainCommandQueue(queue);
+			const DeviceInfo* deviceInfo = DeviceSelector::instance().find(task.getDevice());
+			zeroCopy = deviceInfo && deviceInfo->unifiedMemory;
+		}
+
+		cl_mem xBuff{}, yBuff{};
+		cl_event done{};
+		auto release = [&]()
+		{
+			for (cl_mem buffer : { xBuff, yBuff })
+			{
+				if (buffer)
+				{
+					clReleaseMemObject(buffer);
+				}
+			}
+			if (done)
+			{
+				clReleaseEvent(done);
+			}
+			clReleaseKernel(kernel);
+			clReleaseCommandQueue(queue);
+		};
+
+		if (zeroCopy)
+		{
+			xBuff = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(TYPE) * xBuffSize, const_cast<TYPE*>(x_gpu.data()), &res);
+			if (res == CL_SUCCESS)
+			{
+				yBuff = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(TYPE) * yBuffSize, y_gpu.data(), &res);
+			}
+		}
+		else
+		{
+			xBuff = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(TYPE) * xBuffSize, NULL, &res);
+			if (res == CL_SUCCESS)
+			{
+				yBuff = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(TYPE) * yBuffSize, NULL, &res);
+			}
+		}
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			release();
+			co_return EXIT_FAILURE;
+		}
+
+		res = GpuTask::passKernelParams(kernel, static_cast<cl_long>(size), a_gpu, xBuff, incx, xBuffSize, yBuff, incy, yBuffSize);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in params passing process\n";
+			std::cout << res << std::endl;
+			release();
+			co_return EXIT_FAILURE;
+		}
+
+		// The cached queue is in order, so only the last command needs an event
+		if (!zeroCopy)
+		{
+			res = clEnqueueWriteBuffer(queue, xBuff, CL_FALSE, 0, sizeof(TYPE) * xBuffSize, x_gpu.data(), 0, NULL, NULL);
+			if (res == CL_SUCCESS)
+			{
+				res = clEnqueueWriteBuffer(queue, yBuff, CL_FALSE, 0, sizeof(TYPE) * yBuffSize, y_gpu.data(), 0, NULL, NULL);
+			}
+		}
+		if (res == CL_SUCCESS)
+		{
+			res = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalSize, &localSize, 0, NULL, NULL);
+		}
+		if (res == CL_SUCCESS)
+		{
+			res = zeroCopy ?
+				GpuTask::enqueueHostSync(queue, yBuff, sizeof(TYPE) * yBuffSize, 0, NULL, &done) :
+				clEnqueueReadBuffer(queue, yBuff, CL_FALSE, 0, sizeof(TYPE) * yBuffSize, y_gpu.data(), 0, NULL, &done);
+		}
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "With enqueue task proc problems\n";
+			// Commands already queued may still be reading the caller's vectors
+			clFinish(queue);
+			release();
+			co_return EXIT_FAILURE;
+		}
+
+		const cl_int status = co_await awaitEvent(done, resumer);
+		release();
+		if (status != CL_COMPLETE)
+		{
+			std::cout << "Device execution failed: " << status << '\n';
+			co_return EXIT_FAILURE;
+		}
+		co_return EXIT_SUCCESS;
+	}
+}
+
+CoTask<int> saxpy_gpu_async(size_t size, cl_float a_gpu, const std::vector<cl_float>& x_gpu, cl_long incx,
+	std::vector<cl_float>& y_gpu, cl_long incy, const char* _deviceName, Resumer* resumer)
+{
+	return axpyGpuAsync(kernels::saxpy.source, size, a_gpu, x_gpu, incx, y_gpu, incy, _deviceName, resumer);
+}
+
+CoTask<int> daxpy_gpu_async(size_t size, cl_double a_gpu, const std::vector<cl_double>& x_gpu, cl_long incx,
+	std::vector<cl_double>& y_gpu, cl_long incy, const char* _deviceName, Resumer* resumer)
+{
+	return axpyGpuAsync(kernels::daxpy.source, size, a_gpu, x_gpu, incx, y_gpu, incy, _deviceName, resumer);
+}
+}
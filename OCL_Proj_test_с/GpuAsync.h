@@ -0,0 +1,230 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace my
+{
+	// Where coroutines continue once the event they wait for completes. Without one
+	// they resume on the OpenCL runtime's callback thread, which must then make no
+	// blocking calls until the coroutine suspends again
+	class Resumer
+	{
+	public:
+		virtual ~Resumer() = default;
+		virtual void post(std::coroutine_handle<> handle) = 0;
+	};
+
+	// A few threads that resume whatever the event callbacks hand them
+	class ResumePool : public Resumer
+	{
+	public:
+		explicit ResumePool(size_t threadsCount);
+		~ResumePool();
+
+		ResumePool(const ResumePool&) = delete;
+		ResumePool& operator=(const ResumePool&) = delete;
+
+		void post(std::coroutine_handle<> handle) override;
+
+	private:
+		void run();
+
+		std::deque<std::coroutine_handle<>> m_ready;
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		bool m_stop{ false };
+		std::vector<std::thread> m_threads;
+	};
+
+	// co_await on an event suspends until clSetEventCallback reports it complete, and
+	// yields its execution status: CL_COMPLETE, or the error that terminated it.
+	// The event stays owned by the caller.
+	class EventAwaiter
+	{
+	public:
+		EventAwaiter(cl_event event, Resumer* resumer = nullptr) : m_event(event), m_resumer(resumer)
+		{
+		}
+
+		bool await_ready();
+		bool await_suspend(std::coroutine_handle<> handle);
+		cl_int await_resume() const
+		{
+			return m_status;
+		}
+
+	private:
+		static void CL_CALLBACK onComplete(cl_event event, cl_int status, void* userData);
+
+		cl_event m_event{};
+		Resumer* m_resumer{};
+		std::coroutine_handle<> m_handle;
+		cl_int m_status{ CL_COMPLETE };
+	};
+
+	inline EventAwaiter awaitEvent(cl_event event, Resumer* resumer = nullptr)
+	{
+		return EventAwaiter(event, resumer);
+	}
+
+	// Result of a coroutine. It starts running as soon as it is called and carries on
+	// up to its first wait, so that any number of them can be put in flight before the
+	// first is awaited. Consume it with co_await from another coroutine or with get()
+	// from a plain thread; destroying an unfinished task blocks until it finishes.
+	template <typename TYPE>
+	class CoTask
+	{
+	public:
+		struct promise_type
+		{
+			CoTask get_return_object()
+			{
+				return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_never initial_suspend() noexcept
+			{
+				return {};
+			}
+			auto final_suspend() noexcept
+			{
+				struct FinalAwaiter
+				{
+					bool await_ready() noexcept
+					{
+						return false;
+					}
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+					{
+						promise_type& promise = handle.promise();
+						std::coroutine_handle<> continuation;
+						{
+							std::lock_guard<std::mutex> lock(promise.mutex);
+							promise.finished = true;
+							continuation = promise.continuation;
+							promise.cv.notify_all();
+						}
+						// The frame may be gone by now, so only the local copy is used
+						return continuation ? continuation : std::noop_coroutine();
+					}
+					void await_resume() noexcept
+					{
+					}
+				};
+				return FinalAwaiter{};
+			}
+			void return_value(TYPE result)
+			{
+				value = std::move(result);
+			}
+			void unhandled_exception()
+			{
+				error = std::current_exception();
+			}
+
+			TYPE value{};
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+			bool finished{ false };
+			std::mutex mutex;
+			std::condition_variable cv;
+		};
+
+		CoTask() = default;
+		CoTask(const CoTask&) = delete;
+		CoTask& operator=(const CoTask&) = delete;
+		CoTask(CoTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr))
+		{
+		}
+		CoTask& operator=(CoTask&& other) noexcept
+		{
+			if (this != &other)
+			{
+				destroy();
+				m_handle = std::exchange(other.m_handle, nullptr);
+			}
+			return *this;
+		}
+		~CoTask()
+		{
+			destroy();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+		bool await_suspend(std::coroutine_handle<> continuation)
+		{
+			promise_type& promise = m_handle.promise();
+			std::lock_guard<std::mutex> lock(promise.mutex);
+			if (promise.finished)
+			{
+				return false;
+			}
+			promise.continuation = continuation;
+			return true;
+		}
+		TYPE await_resume()
+		{
+			return take();
+		}
+
+		// Blocks the calling thread; not for use inside a coroutine
+		TYPE get()
+		{
+			wait();
+			return take();
+		}
+
+	private:
+		explicit CoTask(std::coroutine_handle<promise_type> handle) : m_handle(handle)
+		{
+		}
+
+		void wait()
+		{
+			promise_type& promise = m_handle.promise();
+			std::unique_lock<std::mutex> lock(promise.mutex);
+			promise.cv.wait(lock, [&promise]()
+			{
+				return promise.finished;
+			});
+		}
+		TYPE take()
+		{
+			promise_type& promise = m_handle.promise();
+			if (promise.error)
+			{
+				std::rethrow_exception(promise.error);
+			}
+			return std::move(promise.value);
+		}
+		void destroy()
+		{
+			if (m_handle)
+			{
+				wait();
+				m_handle.destroy();
+				m_handle = nullptr;
+			}
+		}
+
+		std::coroutine_handle<promise_type> m_handle;
+	};
+
+	// Coroutine forms of saxpy_gpu and daxpy_gpu. The commands are enqueued before the
+	// first suspension, and no thread waits while the device runs them; x and y must
+	// stay alive until the task finishes.
+	CoTask<int> saxpy_gpu_async(size_t size, cl_float a_gpu, const std::vector<cl_float>& x_gpu, cl_long incx,
+		std::vector<cl_float>& y_gpu, cl_long incy, const char* _deviceName, Resumer* resumer = nullptr);
+	CoTask<int> daxpy_gpu_async(size_t size, cl_double a_gpu, const std::vector<cl_double>& x_gpu, cl_long incx,
+		std::vector<cl_double>& y_gpu, cl_long incy, const char* _deviceName, Resumer* resumer = nullptr);
+}
+
@@ -2,6 +2,11 @@
 #include <CL/cl.h>
 #include <iostream>
 #include <omp.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "KernelLibrary.h"
 
 namespace my
 {
@@ -10,9 +15,28 @@ class GpuTask
 {
 public:
 	GpuTask() = default;
-	GpuTask(cl_device_id device, const char* _sourceKernel) : m_device(device)
+	GpuTask(cl_device_id device, const char* _sourceKernel, const char* _buildOptions = nullptr,
+		cl_command_queue_properties _queueProperties = 0) : m_device(device)
+	{
+		// Balances the release in the destructor: a no-op for root devices, while
+		// sub-devices stay alive for as long as the task uses them
+		clRetainDevice(device);
+		status = initProgram(device, _sourceKernel, _buildOptions, _queueProperties);
+	}
+	GpuTask(const GpuTask&) = delete;
+	GpuTask& operator=(const GpuTask&) = delete;
+	GpuTask(GpuTask&& other) noexcept
 	{
-		status = initProgram(device, _sourceKernel);
+		swap(other);
+	}
+	GpuTask& operator=(GpuTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			GpuTask tmp(std::move(other));
+			swap(tmp);
+		}
+		return *this;
 	}
 
 	template <typename Arg>
@@ -26,6 +50,12 @@ public:
 	{
 		return setArgs<0, Targs...>::set(m_kernel, args...);
 	}
+	// For kernels made with createKernel, which the task's own calls leave untouched
+	template <typename... Targs>
+	static int passKernelParams(cl_kernel kernel, const Targs&... args)
+	{
+		return setArgs<0, Targs...>::set(kernel, args...);
+	}
 	int enqueueKernel(size_t numDims, size_t* localSize, size_t* global_size, double* totalTime)
 	{
 		cl_event event{};
@@ -36,10 +66,44 @@ public:
 		clReleaseEvent(event);
 		return retCode;
 	}
+	// Non-blocking launch ordered only by the wait list, for out-of-order queues
+	int enqueueKernel(size_t numDims, const size_t* localSize, const size_t* globalSize,
+		const std::vector<cl_event>& waitList, cl_event* event)
+	{
+		return clEnqueueNDRangeKernel(m_queue, m_kernel, numDims, NULL, globalSize, localSize,
+			static_cast<cl_uint>(waitList.size()), waitList.empty() ? NULL : waitList.data(), event);
+	}
 	bool isTaskFailed()
 	{
 		return status != CL_SUCCESS;
 	}
+	cl_context getContext() const
+	{
+		return m_context;
+	}
+	cl_command_queue getQueue() const
+	{
+		return m_queue;
+	}
+	cl_device_id getDevice() const
+	{
+		return m_device;
+	}
+	cl_kernel getKernel() const
+	{
+		return m_kernel;
+	}
+	// Another queue on the task's context, released by the caller
+	cl_command_queue createQueue(int& err, cl_command_queue_properties _queueProperties = 0)
+	{
+		cl_queue_properties properties[]{ CL_QUEUE_PROPERTIES, _queueProperties, 0 };
+		return clCreateCommandQueueWithProperties(m_context, m_device, _queueProperties ? properties : 0, &err);
+	}
+	// Further kernels from the same program, released by the caller
+	cl_kernel createKernel(const char* _kernelName, int& err)
+	{
+		return clCreateKernel(m_program, _kernelName, &err);
+	}
 	template <typename TYPE>
 	cl_mem addBuffer(size_t size, int type, int& err, TYPE* pointer = NULL)
 	{
@@ -57,10 +121,52 @@ public:
 		return clEnqueueWriteBuffer(m_queue, memBuffer, blockingWrite, 0, sizeof(TYPE) * size, ptr, 0, NULL, NULL);
 	}
 	template <typename TYPE>
+	int enqueueWriteBuffer(size_t size, const TYPE* ptr, cl_mem memBuffer, const std::vector<cl_event>& waitList, cl_event* event)
+	{
+		return clEnqueueWriteBuffer(m_queue, memBuffer, CL_FALSE, 0, sizeof(TYPE) * size, ptr,
+			static_cast<cl_uint>(waitList.size()), waitList.empty() ? NULL : waitList.data(), event);
+	}
+	template <typename TYPE>
 	int enqueueReadBuffer(size_t size, TYPE* ptr, cl_mem memBuffer, size_t blockingRead = CL_TRUE)
 	{
 		return clEnqueueReadBuffer(m_queue, memBuffer, blockingRead, 0, sizeof(TYPE) * size, ptr, 0, NULL, NULL);
 	}
+	template <typename TYPE>
+	int enqueueReadBuffer(size_t size, TYPE* ptr, cl_mem memBuffer, const std::vector<cl_event>& waitList, cl_event* event)
+	{
+		return clEnqueueReadBuffer(m_queue, memBuffer, CL_FALSE, 0, sizeof(TYPE) * size, ptr,
+			static_cast<cl_uint>(waitList.size()), waitList.empty() ? NULL : waitList.data(), event);
+	}
+
+	// Host memory wrapped with CL_MEM_USE_HOST_PTR holds what the device wrote only once
+	// the buffer has been mapped; the mapping is released again straight away. event, if
+	// given, completes with the unmap
+	static int enqueueHostSync(cl_command_queue queue, cl_mem buffer, size_t bytes,
+		cl_uint numWaits, const cl_event* waitList, cl_event* event)
+	{
+		int err = CL_SUCCESS;
+		cl_event mapped{};
+		void* ptr = clEnqueueMapBuffer(queue, buffer, CL_FALSE, CL_MAP_READ, 0, bytes, numWaits, waitList, &mapped, &err);
+		if (err == CL_SUCCESS)
+		{
+			// Ordered by the event, since the queue may be out of order
+			err = clEnqueueUnmapMemObject(queue, buffer, ptr, 1, &mapped, event);
+			clReleaseEvent(mapped);
+		}
+		return err;
+	}
+	// Blocking form on the task's own queue
+	int syncHostPtr(cl_mem buffer, size_t bytes)
+	{
+		cl_event done{};
+		int err = enqueueHostSync(m_queue, buffer, bytes, 0, NULL, &done);
+		if (err == CL_SUCCESS)
+		{
+			err = clWaitForEvents(1, &done);
+			clReleaseEvent(done);
+		}
+		return err;
+	}
 
 	// add n-dim
 	void getDecomposition(size_t* localSize, size_t* globalSize, const size_t* worksize)
@@ -102,7 +208,18 @@ public:
 		clReleaseDevice(m_device);
 	}
 private:
-	int initProgram(cl_device_id device, const char* _sourceKernel)
+	void swap(GpuTask& other) noexcept
+	{
+		std::swap(m_context, other.m_context);
+		std::swap(m_queue, other.m_queue);
+		std::swap(m_program, other.m_program);
+		std::swap(m_kernel, other.m_kernel);
+		std::swap(m_device, other.m_device);
+		std::swap(status, other.status);
+	}
+
+	int initProgram(cl_device_id device, const char* _sourceKernel, const char* _buildOptions,
+		cl_command_queue_properties _queueProperties)
 	{
 		int err{};
 		m_context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
@@ -110,23 +227,47 @@ private:
 			std::cout << "context error!\n";
 			return err;
 		}
-		m_queue = clCreateCommandQueueWithProperties(m_context, device, 0, &err);
+		cl_command_queue_properties supported{};
+		clGetDeviceInfo(device, CL_DEVICE_QUEUE_PROPERTIES, sizeof(supported), &supported, NULL);
+		if (_queueProperties & ~supported) {
+			std::cout << "unsupported queue properties, falling back to in-order queue\n";
+			_queueProperties &= supported;
+		}
+		m_queue = createQueue(err, _queueProperties);
 		if (err != CL_SUCCESS) {
 			std::cout << "command queue error!\n";
 			return err;
 		}
-		size_t srcLen = strlen(_sourceKernel);
-		m_program = clCreateProgramWithSource(m_context, 1,
-			(const char**)&_sourceKernel,
-			&srcLen, &err);
-		if (err != CL_SUCCESS) {
-			std::cout << "program creation error!\n";
-			return err;
+		// Prebuilt SPIR-V skips the driver's front end; options need the source, as does
+		// any device or driver that rejects the IL
+		const EmbeddedKernel* embedded = _buildOptions && *_buildOptions ? nullptr : findEmbeddedKernel(_sourceKernel);
+		if (embedded && embedded->ilSize && supportsSpirv(device)) {
+			m_program = clCreateProgramWithIL(m_context, embedded->il, embedded->ilSize, &err);
+			if (err == CL_SUCCESS && clBuildProgram(m_program, 1, &device, NULL, NULL, NULL) != CL_SUCCESS) {
+				printBuildLog(device);
+				std::cout << "SPIR-V build failed, falling back to source\n";
+				err = CL_BUILD_PROGRAM_FAILURE;
+			}
+			if (err != CL_SUCCESS && m_program) {
+				clReleaseProgram(m_program);
+				m_program = nullptr;
+			}
 		}
-		err = clBuildProgram(m_program, 1, &device, NULL, NULL, NULL);
-		if (err != CL_SUCCESS) {
-			std::cout << "program building error!\n";
-			return err;
+		if (!m_program) {
+			size_t srcLen = strlen(_sourceKernel);
+			m_program = clCreateProgramWithSource(m_context, 1,
+				(const char**)&_sourceKernel,
+				&srcLen, &err);
+			if (err != CL_SUCCESS) {
+				std::cout << "program creation error!\n";
+				return err;
+			}
+			err = clBuildProgram(m_program, 1, &device, _buildOptions, NULL, NULL);
+			if (err != CL_SUCCESS) {
+				std::cout << "program building error!\n";
+				printBuildLog(device);
+				return err;
+			}
 		}
 		m_kernel = clCreateKernel(m_program, "operation", &err);
 		if (err != CL_SUCCESS) {
@@ -136,6 +277,17 @@ private:
 		return CL_SUCCESS;
 	}
 
+	void printBuildLog(cl_device_id device)
+	{
+		size_t size{};
+		if (clGetProgramBuildInfo(m_program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &size) != CL_SUCCESS || size <= 1) {
+			return;
+		}
+		std::string log(size, '\0');
+		clGetProgramBuildInfo(m_program, device, CL_PROGRAM_BUILD_LOG, size, &log[0], NULL);
+		std::cout << log << '\n';
+	}
+
 	template <int Ind, typename... Args>
 	struct setArgs;
 
@@ -0,0 +1,10 @@
+__kernel void operation(__global long * inout,
+						 const unsigned long count)
+{
+	int index = get_global_id(0);
+	int group = get_group_id(0);
+	int lcl = get_local_id(0);
+	printf("Hello from %i block, %i thread (global id: %i)\n", group, lcl, index);
+	if (index < count)
+		inout[index] = inout[index] + index;
+}
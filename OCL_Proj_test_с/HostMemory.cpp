@@ -0,0 +1,126 @@
+#include "HostMemory.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "advapi32.lib")
+#else
+#include <sys/mman.h>
+#endif
+#include <cstdint>
+#include <mutex>
+
+namespace my
+{
+namespace
+{
+	size_t roundUp(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+#ifdef _WIN32
+	// Large pages need SeLockMemoryPrivilege, granted per account by policy; enabled once per process
+	size_t largePageSize()
+	{
+		static size_t size{};
+		static std::once_flag once;
+		std::call_once(once, []()
+		{
+			HANDLE token{};
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			{
+				return;
+			}
+			TOKEN_PRIVILEGES privileges{};
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+				AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+				GetLastError() == ERROR_SUCCESS)
+			{
+				size = GetLargePageMinimum();
+			}
+			CloseHandle(token);
+		});
+		return size;
+	}
+#endif
+}
+
+void* allocateHost(size_t bytes)
+{
+	if (bytes < HUGE_PAGE_SIZE)
+	{
+		return ::operator new(bytes);
+	}
+	const size_t size = roundUp(bytes, HUGE_PAGE_SIZE);
+#ifdef _WIN32
+	const size_t largePage = largePageSize();
+	if (largePage && size % largePage == 0)
+	{
+		void* ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (ptr)
+		{
+			return ptr;
+		}
+	}
+	void* ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+#else
+#ifdef MAP_HUGETLB
+	// Explicit huge pages exist only if the administrator reserved some (vm.nr_hugepages)
+	void* huge = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (huge != MAP_FAILED)
+	{
+		return huge;
+	}
+#endif
+	// Over-allocate by one huge page and trim, so that the region starts on a 2 MB
+	// boundary and transparent huge pages can back all of it
+	const size_t mapped = size + HUGE_PAGE_SIZE;
+	void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+	{
+		throw std::bad_alloc();
+	}
+	const uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+	const uintptr_t aligned = roundUp(begin, HUGE_PAGE_SIZE);
+	if (aligned > begin)
+	{
+		munmap(raw, aligned - begin);
+	}
+	const uintptr_t end = begin + mapped;
+	if (end > aligned + size)
+	{
+		munmap(reinterpret_cast<void*>(aligned + size), end - aligned - size);
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+	return reinterpret_cast<void*>(aligned);
+#endif
+}
+
+void freeHost(void* ptr, size_t bytes)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	if (bytes < HUGE_PAGE_SIZE)
+	{
+		::operator delete(ptr);
+		return;
+	}
+#ifdef _WIN32
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, roundUp(bytes, HUGE_PAGE_SIZE));
+#endif
+}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <utility>
+
+namespace my
+{
+	// Size of the pages large host allocations are backed with where the OS allows it
+	const size_t HUGE_PAGE_SIZE{ size_t(2) << 20 };
+
+	// Uninitialised memory. From HUGE_PAGE_SIZE up it is mapped directly: explicit huge pages
+	// when the system has them reserved (large pages on Windows), transparent huge pages
+	// otherwise. No page is touched here, so each lands on the NUMA node of the thread
+	// that writes it first. bytes must be passed unchanged to freeHost.
+	void* allocateHost(size_t bytes);
+	void freeHost(void* ptr, size_t bytes);
+
+	// Leaves elements default-initialised, so that the pages stay untouched until
+	// firstTouch places them
+	template <typename TYPE>
+	class HostAllocator
+	{
+	public:
+		using value_type = TYPE;
+
+		HostAllocator() = default;
+		template <typename OTHER>
+		HostAllocator(const HostAllocator<OTHER>&)
+		{
+		}
+
+		TYPE* allocate(size_t count)
+		{
+			return static_cast<TYPE*>(allocateHost(count * sizeof(TYPE)));
+		}
+		void deallocate(TYPE* ptr, size_t count)
+		{
+			freeHost(ptr, count * sizeof(TYPE));
+		}
+
+		template <typename OTHER>
+		void construct(OTHER* ptr)
+		{
+			::new (static_cast<void*>(ptr)) OTHER;
+		}
+		template <typename OTHER, typename... Args>
+		void construct(OTHER* ptr, Args&&... args)
+		{
+			::new (static_cast<void*>(ptr)) OTHER(std::forward<Args>(args)...);
+		}
+
+		template <typename OTHER>
+		bool operator==(const HostAllocator<OTHER>&) const
+		{
+			return true;
+		}
+		template <typename OTHER>
+		bool operator!=(const HostAllocator<OTHER>&) const
+		{
+			return false;
+		}
+	};
+
+	template <typename TYPE>
+	using HostVector = std::vector<TYPE, HostAllocator<TYPE>>;
+
+	// Writes value to rows of rowLength elements with the schedule(static) partition the
+	// CPU kernels use over the same rows, so every thread later works on pages local to
+	// its own socket. Threads should be bound (OMP_PROC_BIND=spread, OMP_PLACES=cores)
+	// for the placement to hold.
+	template <typename TYPE>
+	void firstTouchRows(TYPE* data, int64_t rows, int64_t rowLength, const TYPE& value = TYPE())
+	{
+#pragma omp parallel for schedule(static)
+		for (int64_t row = 0; row < rows; ++row)
+		{
+			TYPE* rowData = data + row * rowLength;
+			for (int64_t col = 0; col < rowLength; ++col)
+			{
+				rowData[col] = value;
+			}
+		}
+	}
+
+	// Vectors processed element by element, as the axpy kernels do
+	template <typename TYPE>
+	void firstTouch(TYPE* data, int64_t count, const TYPE& value = TYPE())
+	{
+		firstTouchRows(data, count, 1, value);
+	}
+}
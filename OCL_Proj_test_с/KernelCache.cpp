@@ -0,0 +1,152 @@
+#include "KernelCache.h"
+
+namespace my
+{
+KernelCache& KernelCache::instance()
+{
+	static KernelCache cache;
+	return cache;
+}
+
+void KernelCache::configure(const SpecializationConfig& config)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_config = config;
+	if (m_config.capacity == 0)
+	{
+		m_config.capacity = 1;
+	}
+	while (m_lru.size() > m_config.capacity)
+	{
+		m_index.erase(m_lru.back().first);
+		m_lru.pop_back();
+	}
+}
+
+SpecializationConfig KernelCache::config()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_config;
+}
+
+void KernelCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_lru.clear();
+	m_index.clear();
+	m_seen.clear();
+	m_seenIndex.clear();
+}
+
+void KernelCache::touchSeen(const std::string& key, size_t& hits)
+{
+	auto found = m_seenIndex.find(key);
+	if (found != m_seenIndex.end())
+	{
+		m_seen.splice(m_seen.begin(), m_seen, found->second);
+	}
+	else
+	{
+		m_seen.emplace_front(key, 0);
+		m_seenIndex[key] = m_seen.begin();
+		// Remember a few times more shapes than there are programs, so that
+		// shapes on their way to the threshold survive a burst of one-offs
+		while (m_seen.size() > 4 * m_config.capacity)
+		{
+			m_seenIndex.erase(m_seen.back().first);
+			m_seen.pop_back();
+		}
+	}
+	hits = ++m_seen.front().second;
+}
+
+KernelCache::SlotPtr KernelCache::findOrInsert(const std::string& key, bool& built)
+{
+	auto found = m_index.find(key);
+	if (found != m_index.end())
+	{
+		built = false;
+		m_lru.splice(m_lru.begin(), m_lru, found->second);
+		return m_lru.front().second;
+	}
+
+	built = true;
+	SlotPtr slot = std::make_shared<Lease::Slot>();
+	m_lru.emplace_front(key, slot);
+	m_index[key] = m_lru.begin();
+	// Evicted tasks still leased out are released when their lease ends
+	while (m_lru.size() > m_config.capacity)
+	{
+		m_index.erase(m_lru.back().first);
+		m_lru.pop_back();
+	}
+	return slot;
+}
+
+void KernelCache::forget(const std::string& key, const SlotPtr& slot)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto found = m_index.find(key);
+	if (found != m_index.end() && found->second->second == slot)
+	{
+		m_lru.erase(found->second);
+		m_index.erase(found);
+	}
+}
+
+KernelCache::Lease KernelCache::acquire(const char* _deviceName, const char* _sourceKernel, const Defines& defines,
+	const char* _buildOptions, cl_command_queue_properties _queueProperties)
+{
+	if (!config().enabled)
+	{
+		// Nothing shared: the build needs no lock beyond the slot's own
+		SlotPtr slot = std::make_shared<Lease::Slot>();
+		slot->task = m_worker.createGpuTask(_deviceName, _sourceKernel, _buildOptions, _queueProperties);
+		return Lease(std::move(slot), false);
+	}
+
+	const std::string baseOptions = _buildOptions ? _buildOptions : "";
+	// Sources are static strings, so their address identifies the kernel
+	const std::string genericKey = std::string(_deviceName) + '|' +
+		std::to_string(reinterpret_cast<uintptr_t>(_sourceKernel)) + '|' +
+		std::to_string(_queueProperties) + '|' + baseOptions;
+	std::string specializedOptions = baseOptions;
+	for (const auto& define : defines)
+	{
+		specializedOptions += " -D " + define.first + '=' + std::to_string(define.second);
+	}
+	const std::string specializedKey = genericKey + '|' + specializedOptions;
+
+	SlotPtr slot;
+	bool specialized = false;
+	bool built = false;
+	std::unique_lock<std::mutex> slotLock;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t hits{};
+		touchSeen(specializedKey, hits);
+		specialized = !defines.empty() && hits >= m_config.hitThreshold;
+		slot = findOrInsert(specialized ? specializedKey : genericKey, built);
+		if (built)
+		{
+			// Taken before the slot is visible to anyone else, so that callers finding it
+			// wait in their Lease for the build rather than seeing an empty task
+			slotLock = std::unique_lock<std::mutex>(slot->mutex);
+		}
+	}
+	if (!built)
+	{
+		return Lease(std::move(slot), specialized);
+	}
+
+	// Built outside m_mutex: hits on other keys and builds of other programs go on meanwhile
+	slot->task = m_worker.createGpuTask(_deviceName, _sourceKernel,
+		(specialized ? specializedOptions : baseOptions).c_str(), _queueProperties);
+	if (slot->task.isTaskFailed())
+	{
+		// Callers already waiting on the slot see the failure too; later ones build afresh
+		forget(specialized ? specializedKey : genericKey, slot);
+	}
+	return Lease(std::move(slot), std::move(slotLock), specialized);
+}
+}
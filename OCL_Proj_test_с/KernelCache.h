@@ -0,0 +1,120 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "DevWorker.h"
+
+namespace my
+{
+	struct SpecializationConfig
+	{
+		// When disabled every acquire builds a fresh, uncached task as before
+		bool enabled{ false };
+		// Calls with the same dimensions before a specialised variant is built
+		size_t hitThreshold{ 2 };
+		// Compiled programs kept per cache, least recently used evicted first
+		size_t capacity{ 16 };
+	};
+
+	// LRU of compiled GpuTasks. Kernel sources opt in by guarding their
+	// dimensions and strides with "#ifndef NAME / #define NAME runtimeArg",
+	// so that a "-D NAME=value" build option turns them into constants.
+	// Shapes seen fewer than hitThreshold times run the generic build, which
+	// is cached as well; hot shapes get their own specialised build.
+	class KernelCache
+	{
+	public:
+		using Defines = std::vector<std::pair<std::string, int64_t>>;
+
+		// Exclusive use of one cached task for as long as the lease lives
+		class Lease
+		{
+		public:
+			Lease() = default;
+			Lease(Lease&&) = default;
+			Lease& operator=(Lease&& other) noexcept
+			{
+				// Unlock before the old slot can be freed along with its mutex
+				m_lock = std::move(other.m_lock);
+				m_slot = std::move(other.m_slot);
+				m_specialized = other.m_specialized;
+				return *this;
+			}
+			GpuTask& operator*() const
+			{
+				return m_slot->task;
+			}
+			GpuTask* operator->() const
+			{
+				return &m_slot->task;
+			}
+			bool isSpecialized() const
+			{
+				return m_specialized;
+			}
+
+		private:
+			friend class KernelCache;
+			struct Slot
+			{
+				GpuTask task;
+				std::mutex mutex;
+			};
+
+			Lease(std::shared_ptr<Slot> slot, bool specialized)
+				: m_slot(std::move(slot)), m_lock(m_slot->mutex), m_specialized(specialized)
+			{
+			}
+			// Takes over the lock the building thread already holds on the slot
+			Lease(std::shared_ptr<Slot> slot, std::unique_lock<std::mutex> lock, bool specialized)
+				: m_slot(std::move(slot)), m_lock(std::move(lock)), m_specialized(specialized)
+			{
+			}
+
+			std::shared_ptr<Slot> m_slot;
+			std::unique_lock<std::mutex> m_lock;
+			bool m_specialized{ false };
+		};
+
+		static KernelCache& instance();
+
+		KernelCache(const KernelCache&) = delete;
+		KernelCache& operator=(const KernelCache&) = delete;
+
+		void configure(const SpecializationConfig& config);
+		SpecializationConfig config();
+
+		Lease acquire(const char* _deviceName, const char* _sourceKernel, const Defines& defines,
+			const char* _buildOptions = nullptr, cl_command_queue_properties _queueProperties = 0);
+
+		void clear();
+
+	private:
+		KernelCache() = default;
+
+		using SlotPtr = std::shared_ptr<Lease::Slot>;
+		// The slot cached under key, or a new empty one entered under it, with built set,
+		// for the caller to build outside m_mutex
+		SlotPtr findOrInsert(const std::string& key, bool& built);
+		void forget(const std::string& key, const SlotPtr& slot);
+		void touchSeen(const std::string& key, size_t& hits);
+
+		SpecializationConfig m_config;
+		DevWorker m_worker;
+
+		std::list<std::pair<std::string, SlotPtr>> m_lru;
+		std::map<std::string, std::list<std::pair<std::string, SlotPtr>>::iterator> m_index;
+
+		// Hit counts of recently seen shapes, bounded like the programs themselves
+		std::list<std::pair<std::string, size_t>> m_seen;
+		std::map<std::string, std::list<std::pair<std::string, size_t>>::iterator> m_seenIndex;
+
+		std::mutex m_mutex;
+	};
+}
@@ -0,0 +1,97 @@
+#include "KernelLibrary.h"
+
+#include <string>
+
+// Generated by EmbedKernel.ps1 from the .cl files, in $(IntDir)EmbeddedKernels
+#include "Saxpy.cl.h"
+#include "Daxpy.cl.h"
+#include "MatMultBase.cl.h"
+#include "MatMultShared.cl.h"
+#include "Hello.cl.h"
+#include "MatMultBatched.cl.h"
+#include "SaxpyBatched.cl.h"
+#include "DaxpyBatched.cl.h"
+#include "MatMultStrided.cl.h"
+#include "MatMultGemv.cl.h"
+#include "MatMultSmall.cl.h"
+#include "MatMultSplitK.cl.h"
+#include "Persistent.cl.h"
+#include "MatMultQuant.cl.h"
+#include "RooflineBench.cl.h"
+#include "RooflineDouble.cl.h"
+#include "SpmvCsrScalar.cl.h"
+#include "SpmvCsrVector.cl.h"
+#include "SpmvEll.cl.h"
+#include "SpmvSell.cl.h"
+#include "SpmmCsr.cl.h"
+#include "Strassen.cl.h"
+#include "TranspShared.cl.h"
+#include "VerifyMatrVecs.cl.h"
+#include "BenchScale.cl.h"
+#include "Tenant.cl.h"
+#include "Conv2dImplicit.cl.h"
+
+namespace my
+{
+namespace kernels
+{
+	const EmbeddedKernel saxpy{ SAXPY_SOURCE, SAXPY_IL, SAXPY_IL_SIZE };
+	const EmbeddedKernel daxpy{ DAXPY_SOURCE, DAXPY_IL, DAXPY_IL_SIZE };
+	const EmbeddedKernel matMultBase{ MATMULTBASE_SOURCE, MATMULTBASE_IL, MATMULTBASE_IL_SIZE };
+	const EmbeddedKernel matMultShared{ MATMULTSHARED_SOURCE, MATMULTSHARED_IL, MATMULTSHARED_IL_SIZE };
+	const EmbeddedKernel hello{ HELLO_SOURCE, HELLO_IL, HELLO_IL_SIZE };
+	const EmbeddedKernel matMultBatched{ MATMULTBATCHED_SOURCE, MATMULTBATCHED_IL, MATMULTBATCHED_IL_SIZE };
+	const EmbeddedKernel saxpyBatched{ SAXPYBATCHED_SOURCE, SAXPYBATCHED_IL, SAXPYBATCHED_IL_SIZE };
+	const EmbeddedKernel daxpyBatched{ DAXPYBATCHED_SOURCE, DAXPYBATCHED_IL, DAXPYBATCHED_IL_SIZE };
+	const EmbeddedKernel matMultStrided{ MATMULTSTRIDED_SOURCE, MATMULTSTRIDED_IL, MATMULTSTRIDED_IL_SIZE };
+	const EmbeddedKernel matMultGemv{ MATMULTGEMV_SOURCE, MATMULTGEMV_IL, MATMULTGEMV_IL_SIZE };
+	const EmbeddedKernel matMultSmall{ MATMULTSMALL_SOURCE, MATMULTSMALL_IL, MATMULTSMALL_IL_SIZE };
+	const EmbeddedKernel matMultSplitK{ MATMULTSPLITK_SOURCE, MATMULTSPLITK_IL, MATMULTSPLITK_IL_SIZE };
+	const EmbeddedKernel persistent{ PERSISTENT_SOURCE, PERSISTENT_IL, PERSISTENT_IL_SIZE };
+	const EmbeddedKernel matMultQuant{ MATMULTQUANT_SOURCE, MATMULTQUANT_IL, MATMULTQUANT_IL_SIZE };
+	const EmbeddedKernel rooflineBench{ ROOFLINEBENCH_SOURCE, ROOFLINEBENCH_IL, ROOFLINEBENCH_IL_SIZE };
+	const EmbeddedKernel rooflineDouble{ ROOFLINEDOUBLE_SOURCE, ROOFLINEDOUBLE_IL, ROOFLINEDOUBLE_IL_SIZE };
+	const EmbeddedKernel spmvCsrScalar{ SPMVCSRSCALAR_SOURCE, SPMVCSRSCALAR_IL, SPMVCSRSCALAR_IL_SIZE };
+	const EmbeddedKernel spmvCsrVector{ SPMVCSRVECTOR_SOURCE, SPMVCSRVECTOR_IL, SPMVCSRVECTOR_IL_SIZE };
+	const EmbeddedKernel spmvEll{ SPMVELL_SOURCE, SPMVELL_IL, SPMVELL_IL_SIZE };
+	const EmbeddedKernel spmvSell{ SPMVSELL_SOURCE, SPMVSELL_IL, SPMVSELL_IL_SIZE };
+	const EmbeddedKernel spmmCsr{ SPMMCSR_SOURCE, SPMMCSR_IL, SPMMCSR_IL_SIZE };
+	const EmbeddedKernel strassen{ STRASSEN_SOURCE, STRASSEN_IL, STRASSEN_IL_SIZE };
+	const EmbeddedKernel transpShared{ TRANSPSHARED_SOURCE, TRANSPSHARED_IL, TRANSPSHARED_IL_SIZE };
+	const EmbeddedKernel verifyMatrVecs{ VERIFYMATRVECS_SOURCE, VERIFYMATRVECS_IL, VERIFYMATRVECS_IL_SIZE };
+	const EmbeddedKernel benchScale{ BENCHSCALE_SOURCE, BENCHSCALE_IL, BENCHSCALE_IL_SIZE };
+	const EmbeddedKernel tenant{ TENANT_SOURCE, TENANT_IL, TENANT_IL_SIZE };
+	const EmbeddedKernel conv2dImplicit{ CONV2DIMPLICIT_SOURCE, CONV2DIMPLICIT_IL, CONV2DIMPLICIT_IL_SIZE };
+}
+
+const EmbeddedKernel* findEmbeddedKernel(const char* source)
+{
+	static const EmbeddedKernel* const all[]{ &kernels::saxpy, &kernels::daxpy, &kernels::matMultBase,
+		&kernels::matMultShared, &kernels::hello, &kernels::matMultBatched, &kernels::saxpyBatched,
+		&kernels::daxpyBatched, &kernels::matMultStrided, &kernels::matMultGemv, &kernels::matMultSmall,
+		&kernels::matMultSplitK, &kernels::persistent, &kernels::matMultQuant, &kernels::rooflineBench,
+		&kernels::rooflineDouble, &kernels::spmvCsrScalar, &kernels::spmvCsrVector, &kernels::spmvEll,
+		&kernels::spmvSell, &kernels::spmmCsr, &kernels::strassen, &kernels::transpShared,
+		&kernels::verifyMatrVecs, &kernels::benchScale, &kernels::tenant, &kernels::conv2dImplicit };
+	for (const EmbeddedKernel* kernel : all)
+	{
+		if (kernel->source == source)
+		{
+			return kernel;
+		}
+	}
+	return nullptr;
+}
+
+bool supportsSpirv(cl_device_id device)
+{
+	size_t size{};
+	if (clGetDeviceInfo(device, CL_DEVICE_IL_VERSION, 0, nullptr, &size) != CL_SUCCESS || size <= 1)
+	{
+		return false;
+	}
+	std::string versions(size, '\0');
+	clGetDeviceInfo(device, CL_DEVICE_IL_VERSION, size, &versions[0], nullptr);
+	return versions.find("SPIR-V") != std::string::npos;
+}
+}
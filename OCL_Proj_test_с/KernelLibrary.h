@@ -0,0 +1,55 @@
+#pragma once
+#include <CL/cl.h>
+#include <cstddef>
+
+namespace my
+{
+	// A kernel kept in its own .cl file. The build compiles it to SPIR-V and embeds
+	// both the source and the IL; il is empty when the build had no SPIR-V compiler
+	// and for kernels that only build with -D options.
+	// The IL is the generic build, so it serves only builds without options: anything
+	// specialised with -D, as KernelCache does, is compiled from source.
+	struct EmbeddedKernel
+	{
+		const char* source;
+		const unsigned char* il;
+		size_t ilSize;
+	};
+
+	namespace kernels
+	{
+		extern const EmbeddedKernel saxpy;
+		extern const EmbeddedKernel daxpy;
+		extern const EmbeddedKernel matMultBase;
+		extern const EmbeddedKernel matMultShared;
+		extern const EmbeddedKernel hello;
+		extern const EmbeddedKernel matMultBatched;
+		extern const EmbeddedKernel saxpyBatched;
+		extern const EmbeddedKernel daxpyBatched;
+		extern const EmbeddedKernel matMultStrided;
+		extern const EmbeddedKernel matMultGemv;
+		extern const EmbeddedKernel matMultSmall;
+		extern const EmbeddedKernel matMultSplitK;
+		extern const EmbeddedKernel persistent;
+		extern const EmbeddedKernel matMultQuant;
+		extern const EmbeddedKernel rooflineBench;
+		extern const EmbeddedKernel rooflineDouble;
+		extern const EmbeddedKernel spmvCsrScalar;
+		extern const EmbeddedKernel spmvCsrVector;
+		extern const EmbeddedKernel spmvEll;
+		extern const EmbeddedKernel spmvSell;
+		extern const EmbeddedKernel spmmCsr;
+		extern const EmbeddedKernel strassen;
+		extern const EmbeddedKernel transpShared;
+		extern const EmbeddedKernel verifyMatrVecs;
+		extern const EmbeddedKernel benchScale;
+		extern const EmbeddedKernel tenant;
+		extern const EmbeddedKernel conv2dImplicit;
+	}
+
+	// The embedded kernel whose source is this very string, or nullptr
+	const EmbeddedKernel* findEmbeddedKernel(const char* source);
+
+	// Whether the device accepts SPIR-V through clCreateProgramWithIL (OpenCL 2.1 and later)
+	bool supportsSpirv(cl_device_id device);
+}
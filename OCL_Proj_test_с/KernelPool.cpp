@@ -0,0 +1,164 @@
+#include "KernelPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+namespace my
+{
+namespace
+{
+	// clCloneKernel arrived with OpenCL 2.1
+	bool supportsCloneKernel(cl_device_id device)
+	{
+		char version[NAME_LENGTH]{};
+		if (clGetDeviceInfo(device, CL_DEVICE_VERSION, sizeof(version) - 1, version, NULL) != CL_SUCCESS)
+		{
+			return false;
+		}
+		int major{}, minor{};
+		if (std::sscanf(version, "OpenCL %d.%d", &major, &minor) != 2)
+		{
+			return false;
+		}
+		return major > 2 || (major == 2 && minor >= 1);
+	}
+}
+
+struct KernelPool::Instance::Entry
+{
+	cl_kernel kernel{};
+	cl_command_queue queue{};
+};
+
+KernelPool::Instance::Instance(Instance&& other) noexcept : m_pool(other.m_pool), m_entry(other.m_entry)
+{
+	other.m_pool = nullptr;
+	other.m_entry = nullptr;
+}
+
+KernelPool::Instance& KernelPool::Instance::operator=(Instance&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		m_pool = other.m_pool;
+		m_entry = other.m_entry;
+		other.m_pool = nullptr;
+		other.m_entry = nullptr;
+	}
+	return *this;
+}
+
+KernelPool::Instance::~Instance()
+{
+	release();
+}
+
+void KernelPool::Instance::release()
+{
+	if (m_entry)
+	{
+		m_pool->giveBack(m_entry);
+		m_pool = nullptr;
+		m_entry = nullptr;
+	}
+}
+
+cl_kernel KernelPool::Instance::getKernel() const
+{
+	return m_entry->kernel;
+}
+
+cl_command_queue KernelPool::Instance::getQueue() const
+{
+	return m_entry->queue;
+}
+
+int KernelPool::Instance::enqueueKernel(size_t numDims, const size_t* localSize, const size_t* globalSize,
+	const std::vector<cl_event>& waitList, cl_event* event)
+{
+	return clEnqueueNDRangeKernel(m_entry->queue, m_entry->kernel, static_cast<cl_uint>(numDims), NULL, globalSize, localSize,
+		static_cast<cl_uint>(waitList.size()), waitList.empty() ? NULL : waitList.data(), event);
+}
+
+KernelPool::KernelPool(const char* _deviceName, const char* _sourceKernel, const char* _buildOptions,
+	const char* _kernelName, size_t maxInstances) : m_kernelName(_kernelName), m_maxInstances(maxInstances)
+{
+	if (!m_maxInstances)
+	{
+		m_maxInstances = std::max(1u, std::thread::hardware_concurrency());
+	}
+	DevWorker worker;
+	m_task = worker.createGpuTask(_deviceName, _sourceKernel, _buildOptions);
+	if (m_task.isTaskFailed())
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return;
+	}
+	m_clone = m_kernelName == "operation" && supportsCloneKernel(m_task.getDevice());
+	m_failed = false;
+}
+
+KernelPool::~KernelPool()
+{
+	for (auto& entry : m_entries)
+	{
+		clReleaseKernel(entry->kernel);
+		clReleaseCommandQueue(entry->queue);
+	}
+}
+
+KernelPool::Instance KernelPool::acquire(int& err)
+{
+	err = CL_SUCCESS;
+	if (m_failed)
+	{
+		err = CL_INVALID_PROGRAM;
+		return {};
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this]()
+	{
+		return !m_free.empty() || m_entries.size() < m_maxInstances;
+	});
+	if (!m_free.empty())
+	{
+		Instance::Entry* entry = m_free.back();
+		m_free.pop_back();
+		return Instance(this, entry);
+	}
+
+	// Created under the lock: clCloneKernel, like clSetKernelArg, must not run on
+	// the same source kernel from two threads at once. It happens once per instance.
+	auto entry = std::make_unique<Instance::Entry>();
+	entry->kernel = m_clone ? clCloneKernel(m_task.getKernel(), &err) : m_task.createKernel(m_kernelName.c_str(), err);
+	if (err != CL_SUCCESS)
+	{
+		std::cout << "Kernel creation failed!\n";
+		return {};
+	}
+	entry->queue = m_task.createQueue(err);
+	if (err != CL_SUCCESS)
+	{
+		std::cout << "command queue error!\n";
+		clReleaseKernel(entry->kernel);
+		return {};
+	}
+	m_entries.push_back(std::move(entry));
+	return Instance(this, m_entries.back().get());
+}
+
+size_t KernelPool::instancesCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+void KernelPool::giveBack(Instance::Entry* entry)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_free.push_back(entry);
+	m_cv.notify_one();
+}
+}
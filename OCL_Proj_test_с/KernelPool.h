@@ -0,0 +1,104 @@
+#pragma once
+#include <CL/cl.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DevWorker.h"
+
+namespace my
+{
+	// One program shared by any number of submitting threads. clSetKernelArg is not safe
+	// on a kernel object used by two threads at once, so every caller leases a kernel
+	// instance of its own, cloned from the built one (re-created from the program on
+	// devices before OpenCL 2.1), together with a command queue of its own. Arguments
+	// are then bound and commands enqueued without any lock; only the lease itself takes
+	// the pool's mutex. Instances are created on demand up to maxInstances and reused
+	// most recently returned first.
+	class KernelPool
+	{
+	public:
+		// A leased kernel and its in-order queue, returned to the pool on destruction.
+		// Commands still in flight on the queue are fine; the next lessee's commands
+		// simply queue behind them. Must not outlive the pool.
+		class Instance
+		{
+		public:
+			Instance() = default;
+			Instance(Instance&& other) noexcept;
+			Instance& operator=(Instance&& other) noexcept;
+			~Instance();
+
+			Instance(const Instance&) = delete;
+			Instance& operator=(const Instance&) = delete;
+
+			bool isValid() const
+			{
+				return m_entry != nullptr;
+			}
+			cl_kernel getKernel() const;
+			cl_command_queue getQueue() const;
+
+			template <typename... Targs>
+			int passParams(const Targs&... args)
+			{
+				return GpuTask::passKernelParams(getKernel(), args...);
+			}
+			int enqueueKernel(size_t numDims, const size_t* localSize, const size_t* globalSize,
+				const std::vector<cl_event>& waitList, cl_event* event);
+
+		private:
+			friend class KernelPool;
+			struct Entry;
+
+			Instance(KernelPool* pool, Entry* entry) : m_pool(pool), m_entry(entry)
+			{
+			}
+			void release();
+
+			KernelPool* m_pool{};
+			Entry* m_entry{};
+		};
+
+		// maxInstances of 0 means one per hardware thread
+		KernelPool(const char* _deviceName, const char* _sourceKernel, const char* _buildOptions = nullptr,
+			const char* _kernelName = "operation", size_t maxInstances = 0);
+		~KernelPool();
+
+		KernelPool(const KernelPool&) = delete;
+		KernelPool& operator=(const KernelPool&) = delete;
+
+		bool isFailed() const
+		{
+			return m_failed;
+		}
+		cl_context getContext() const
+		{
+			return m_task.getContext();
+		}
+		cl_device_id getDevice() const
+		{
+			return m_task.getDevice();
+		}
+
+		// Blocks while maxInstances are leased; an invalid instance on failure
+		Instance acquire(int& err);
+		size_t instancesCount();
+
+	private:
+		void giveBack(Instance::Entry* entry);
+
+		GpuTask m_task;
+		std::string m_kernelName;
+		bool m_failed{ true };
+		bool m_clone{ false };
+		size_t m_maxInstances{};
+
+		std::vector<std::unique_ptr<Instance::Entry>> m_entries;
+		std::vector<Instance::Entry*> m_free;
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+	};
+}
@@ -1,181 +1,539 @@
 #include "MatMult.h"
 #include "DevWorker.h"
+#include "DeviceSelector.h"
+#include "DagScheduler.h"
+#include "KernelCache.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <string>
 
 namespace
 {
-	char const* matMultBase = 
-		"__kernel void operation(const __global int * matrA,				\n"
-		"	const __global int * matrB, __global int * resMatr,				\n"
-		"	unsigned int Z, unsigned int Y, unsigned int X)					\n"
-		"{																	\n"
-		"	int z = get_global_id(0);										\n"
-		"	int x = get_global_id(1);										\n"				
-		"	int sum = 0;													\n"
-		"	for (int y = 0; y < Y; ++y)										\n"
-		"	{																\n"
-		"		sum += matrA[z * Y + y] * matrB[y * X + x];					\n"
-		"	}																\n"
-		"	resMatr[z * X + x] = sum;										\n"
-		"}																	\n";
-
-	char const* matMulWithSharedMemory =
-		"#define TILE_SIZE 16												\n"
-		"__kernel void operation(const __global int * matrA,				\n"
-		"	const __global int * matrB, __global int * resMatr,				\n"
-		"	unsigned int Z, unsigned int Y, unsigned int X)					\n"
-		"{																	\n"
-		"	int z = get_global_id(0);										\n"
-		"	int x = get_global_id(1);										\n"
-		"	int lz = get_local_id(0);										\n"
-		"	int lx = get_local_id(1);										\n"
-		"																	\n"
-		"	__local int tileA[TILE_SIZE][TILE_SIZE];						\n"
-		"	__local int tileB[TILE_SIZE][TILE_SIZE];						\n"
-		"																	\n"
-		"	int sum = 0;													\n"
-		"	for (int tileY = 0; tileY * TILE_SIZE < Y; ++tileY)				\n"
-		"	{																\n"
-		"		tileA[lz][lx] = matrA[z * Y + (tileY * TILE_SIZE + lx)];	\n"
-		"		tileB[lz][lx] = matrB[(tileY * TILE_SIZE + lz) * X + x];	\n"
-		"		barrier(CLK_LOCAL_MEM_FENCE);								\n"
-		"		for (int y = 0; y < TILE_SIZE; ++y)							\n"
-		"		{															\n"
-		"			sum += tileA[lz][y] * tileB[y][lx];						\n"
-		"		}															\n"
-		"		barrier(CLK_LOCAL_MEM_FENCE);								\n"
-		"	}																\n"
-		"	resMatr[z * X + x] = sum;										\n"
-		"}																	\n";
-}
-
-std::vector<cl_int> matMultGpu(std::vector<cl_int>& matrA, std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
-	const char* device, bool useSharedMemory)
-{
-	std::vector<cl_int> resMatr(sizeZ * sizeX, 0);
-	my::DevWorker worker = my::DevWorker();
+	const size_t GEMM_TILE{ 16 };
+	const size_t GEMV_GROUP_SIZE{ 64 };
+	// The small kernel runs as a single work-group holding both operands in local memory
+	const cl_int SMALL_GEMM_THREADS{ 256 };
+	const cl_int SMALL_GEMM_ELEMENTS{ 4096 };
+	// Shortest Y range worth giving its own split
+	const cl_int SPLIT_K_MIN_CHUNK{ 256 };
 
-	my::GpuTask task = worker.createGpuTask(device, useSharedMemory ? matMulWithSharedMemory : matMultBase);
-	if (!task.isTaskFailed())
+	// Full unrolling for short loops, otherwise the largest power of two up to 16 dividing the trip count
+	inline cl_int unrollFactor(cl_int tripCount)
 	{
-		int res = CL_SUCCESS;
-
-		size_t localSize[]{ 16, 16 };
-		size_t globalSize[]{ sizeX, sizeZ };
-		size_t matrABuffer = matrA.size();
-		size_t matrBBuffer = matrB.size();
-		size_t resMatrBuffer = resMatr.size();
+		if (tripCount <= 64)
+		{
+			return std::max(tripCount, 1);
+		}
+		cl_int factor = 16;
+		while (tripCount % factor)
+		{
+			factor /= 2;
+		}
+		return factor;
+	}
 
-		double totalTime = omp_get_wtime();
-		cl_mem matrABuff, matrBBuff, resMatrBuff;
+	inline size_t roundUp(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
 
-		std::string AMD_device{ "gfx902" };
+	template <MatrLayout Layout>
+	inline size_t viewIndex(size_t offset, int64_t ld, int64_t row, int64_t col)
+	{
+		return Layout == MatrLayout::RowMajor ? offset + row * ld + col : offset + col * ld + row;
+	}
 
-		if (AMD_device.find(device) != AMD_device.npos)
+	// Default access pattern: rows of B are contiguous, so every output row is
+	// accumulated as a sum of scaled rows of B
+	template <MatrLayout LayoutA, MatrLayout LayoutB>
+	struct ViewMatMult
+	{
+		static void run(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr,
+			cl_int* scratch, int threads)
 		{
-			matrABuff = task.addBuffer<cl_int>(matrABuffer, CL_MEM_USE_HOST_PTR, res, matrA.data());
-			if (res != CL_SUCCESS)
+			const int64_t sizeZ = matrA.rows;
+			const int64_t sizeY = matrA.cols;
+			const int64_t sizeX = matrB.cols;
+#pragma omp parallel num_threads(threads)
 			{
-				std::cout << "Problem in buffer creation process\n";
-				return {};
+				cl_int* accRow = scratch + omp_get_thread_num() * sizeX;
+#pragma omp for schedule(static)
+				for (int64_t z = 0; z < sizeZ; ++z)
+				{
+					std::fill(accRow, accRow + sizeX, 0);
+					for (int64_t y = 0; y < sizeY; ++y)
+					{
+						const cl_int a = matrA.data[viewIndex<LayoutA>(matrA.offset, matrA.ld, z, y)];
+						const cl_int* rowB = matrB.data + viewIndex<LayoutB>(matrB.offset, matrB.ld, y, 0);
+						for (int64_t x = 0; x < sizeX; ++x)
+						{
+							accRow[x] += a * rowB[x];
+						}
+					}
+					for (int64_t x = 0; x < sizeX; ++x)
+					{
+						resMatr.at(z, x) = accRow[x];
+					}
+				}
 			}
+		}
+	};
 
-			matrBBuff = task.addBuffer<cl_int>(matrBBuffer, CL_MEM_USE_HOST_PTR, res, matrB.data());
-			if (res != CL_SUCCESS)
+	// Row-major A times column-major B: both operands are contiguous along y (the transposed case)
+	template <>
+	struct ViewMatMult<MatrLayout::RowMajor, MatrLayout::ColMajor>
+	{
+		static void run(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr,
+			cl_int*, int)
+		{
+			const int64_t sizeZ = matrA.rows;
+			const int64_t sizeY = matrA.cols;
+			const int64_t sizeX = matrB.cols;
+#pragma omp parallel for schedule(static)
+			for (int64_t z = 0; z < sizeZ; ++z)
 			{
-				std::cout << "Problem in buffer creation process\n";
-				return {};
+				const cl_int* rowA = matrA.data + matrA.offset + z * matrA.ld;
+				for (int64_t x = 0; x < sizeX; ++x)
+				{
+					const cl_int* colB = matrB.data + matrB.offset + x * matrB.ld;
+					cl_int tmp = 0;
+					for (int64_t y = 0; y < sizeY; ++y)
+					{
+						tmp += rowA[y] * colB[y];
+					}
+					resMatr.at(z, x) = tmp;
+				}
 			}
+		}
+	};
 
-			resMatrBuff = task.addBuffer<cl_int>(resMatrBuffer, CL_MEM_USE_HOST_PTR, res, resMatr.data());
-			if (res != CL_SUCCESS)
+	// Both column-major: columns of A are contiguous, so every output column is
+	// accumulated as a sum of scaled columns of A
+	template <>
+	struct ViewMatMult<MatrLayout::ColMajor, MatrLayout::ColMajor>
+	{
+		static void run(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr,
+			cl_int* scratch, int threads)
+		{
+			const int64_t sizeZ = matrA.rows;
+			const int64_t sizeY = matrA.cols;
+			const int64_t sizeX = matrB.cols;
+#pragma omp parallel num_threads(threads)
 			{
-				std::cout << "Problem in buffer creation process\n";
-				return {};
+				cl_int* accCol = scratch + omp_get_thread_num() * sizeZ;
+#pragma omp for schedule(static)
+				for (int64_t x = 0; x < sizeX; ++x)
+				{
+					std::fill(accCol, accCol + sizeZ, 0);
+					for (int64_t y = 0; y < sizeY; ++y)
+					{
+						const cl_int b = matrB.data[matrB.offset + x * matrB.ld + y];
+						const cl_int* colA = matrA.data + matrA.offset + y * matrA.ld;
+						for (int64_t z = 0; z < sizeZ; ++z)
+						{
+							accCol[z] += colA[z] * b;
+						}
+					}
+					for (int64_t z = 0; z < sizeZ; ++z)
+					{
+						resMatr.at(z, x) = accCol[z];
+					}
+				}
 			}
 		}
-		else
+	};
+}
+
+MatMultWorkspace::~MatMultWorkspace()
+{
+	releaseDevice();
+}
+
+cl_int* MatMultWorkspace::hostScratch(size_t count)
+{
+	if (m_hostScratch.size() < count)
+	{
+		m_hostScratch.resize(count);
+	}
+	return m_hostScratch.data();
+}
+
+cl_mem MatMultWorkspace::deviceBuffer(size_t slot, cl_context context, size_t bytes, int& err)
+{
+	DeviceBuffer& entry = m_buffers[slot];
+	if (entry.buffer && entry.context == context && entry.bytes >= bytes)
+	{
+		err = CL_SUCCESS;
+		return entry.buffer;
+	}
+	if (entry.buffer)
+	{
+		clReleaseMemObject(entry.buffer);
+		entry = DeviceBuffer();
+	}
+	entry.buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+	if (err != CL_SUCCESS)
+	{
+		entry.buffer = nullptr;
+		return nullptr;
+	}
+	entry.context = context;
+	entry.bytes = bytes;
+	return entry.buffer;
+}
+
+bool MatMultWorkspace::repeats(const char* device, const char* source, cl_int sizeY, cl_int sizeX)
+{
+	if (m_source == source && m_sizeY == sizeY && m_sizeX == sizeX && m_device == device)
+	{
+		return true;
+	}
+	releaseTask();
+	m_device = device;
+	m_source = source;
+	m_sizeY = sizeY;
+	m_sizeX = sizeX;
+	return false;
+}
+
+my::GpuTask& MatMultWorkspace::buildTask(const std::string& options, cl_command_queue_properties properties)
+{
+	my::DevWorker worker;
+	m_task = worker.createGpuTask(m_device.c_str(), m_source, options.c_str(), properties);
+	m_hasTask = !m_task.isTaskFailed();
+	return m_task;
+}
+
+void MatMultWorkspace::releaseTask()
+{
+	m_task = my::GpuTask();
+	m_hasTask = false;
+}
+
+void MatMultWorkspace::releaseDevice()
+{
+	releaseTask();
+	for (auto& entry : m_buffers)
+	{
+		if (entry.buffer)
 		{
-			matrABuff = task.addBuffer<cl_int>(matrABuffer, CL_MEM_READ_ONLY, res);
-			if (res != CL_SUCCESS)
-			{
-				std::cout << "Problem in buffer1 creation process\n";
-				return {};
-			}
+			clReleaseMemObject(entry.buffer);
+		}
+		entry = DeviceBuffer();
+	}
+}
 
-			matrBBuff = task.addBuffer<cl_int>(matrBBuffer, CL_MEM_READ_ONLY, res);
-			if (res != CL_SUCCESS)
-			{
-				std::cout << "Problem in buffer2 creation process\n";
-				return {};
-			}
+int matMultGpu(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, MatMultWorkspace& workspace, bool useSharedMemory)
+{
+	const char* source = useSharedMemory ? my::kernels::matMultShared.source : my::kernels::matMultBase.source;
+	// Out of order, so the uploads of A and B can overlap
+	const cl_command_queue_properties properties = CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE;
+	my::KernelCache::Lease lease;
+	my::GpuTask* taskPtr = nullptr;
+	if (!workspace.repeats(device, source, sizeY, sizeX))
+	{
+		// A shape this workspace has not run before goes through the cache and its
+		// generic-then-specialised policy, holding the cached task for this call only
+		lease = my::KernelCache::instance().acquire(device, source,
+			{ { "DIM_Y", sizeY }, { "DIM_X", sizeX }, { "UNROLL_Y", unrollFactor(sizeY) } }, nullptr, properties);
+		taskPtr = &*lease;
+	}
+	else
+	{
+		if (!workspace.hasTask())
+		{
+			// The workspace runs this shape repeatedly, so it is worth a specialised build of its own
+			const std::string options = "-D DIM_Y=" + std::to_string(sizeY) + " -D DIM_X=" + std::to_string(sizeX) +
+				" -D UNROLL_Y=" + std::to_string(unrollFactor(sizeY));
+			workspace.buildTask(options, properties);
+		}
+		taskPtr = &workspace.task();
+	}
+	my::GpuTask& task = *taskPtr;
+	if (task.isTaskFailed())
+	{
+		workspace.releaseTask();
+		std::cout << "GpuTask creation failed!\n";
+		return EXIT_FAILURE;
+	}
 
-			resMatrBuff = task.addBuffer<cl_int>(resMatrBuffer, CL_MEM_WRITE_ONLY, res);
-			if (res != CL_SUCCESS)
-			{
-				std::cout << "Problem in buffer3 creation process\n";
-				return {};
-			}
+	int res = CL_SUCCESS;
+	size_t localSize[]{ 16, 16 };
+	size_t globalSize[]{ static_cast<size_t>(sizeX), static_cast<size_t>(sizeZ) };
+	const size_t matrABytes = sizeof(cl_int) * sizeZ * sizeY;
+	const size_t matrBBytes = sizeof(cl_int) * sizeY * sizeX;
+	const size_t resMatrBytes = sizeof(cl_int) * sizeZ * sizeX;
 
-			res = task.enqueueWriteBuffer<cl_int>(matrABuffer, matrA.data(), matrABuff);
-			if (res != CL_SUCCESS)
-			{
-				std::cout << res << '\n';
-				std::cout << "Problem in write buffer enqueue\n";
-				return {};
-			}
-			res = task.enqueueWriteBuffer<cl_int>(matrBBuffer, matrB.data(), matrBBuff);
-			if (res != CL_SUCCESS)
+	double totalTime = omp_get_wtime();
+	cl_mem matrABuff{}, matrBBuff{}, resMatrBuff{};
+
+	const my::DeviceInfo* deviceInfo = my::DeviceSelector::instance().find(task.getDevice());
+	const bool zeroCopy = deviceInfo && deviceInfo->unifiedMemory;
+
+	// Zero-copy buffers wrap the caller's memory, which may move between calls, so only
+	// the copying path keeps its buffers in the workspace
+	auto releaseZeroCopy = [&]()
+	{
+		for (cl_mem buffer : { matrABuff, matrBBuff, resMatrBuff })
+		{
+			if (zeroCopy && buffer)
 			{
-				std::cout << res << '\n';
-				std::cout << "Problem in write buffer enqueue\n";
-				return {};
+				clReleaseMemObject(buffer);
 			}
 		}
+	};
+	if (zeroCopy)
+	{
+		matrABuff = clCreateBuffer(task.getContext(), CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, matrABytes, const_cast<cl_int*>(matrA), &res);
+		if (res == CL_SUCCESS)
+		{
+			matrBBuff = clCreateBuffer(task.getContext(), CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, matrBBytes, const_cast<cl_int*>(matrB), &res);
+		}
+		if (res == CL_SUCCESS)
+		{
+			resMatrBuff = clCreateBuffer(task.getContext(), CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, resMatrBytes, resMatr, &res);
+		}
+	}
+	else
+	{
+		matrABuff = workspace.deviceBuffer(0, task.getContext(), matrABytes, res);
+		if (res == CL_SUCCESS)
+		{
+			matrBBuff = workspace.deviceBuffer(1, task.getContext(), matrBBytes, res);
+		}
+		if (res == CL_SUCCESS)
+		{
+			resMatrBuff = workspace.deviceBuffer(2, task.getContext(), resMatrBytes, res);
+		}
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in buffer creation process\n";
+		releaseZeroCopy();
+		return EXIT_FAILURE;
+	}
 
-		res = task.passParams(matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX);
-		if (res != CL_SUCCESS)
+	res = task.passParams(matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in params passing process\n";
+		std::cout << res << std::endl;
+		releaseZeroCopy();
+		return EXIT_FAILURE;
+	}
+
+	// Plain event arrays rather than a DagScheduler, which would allocate its node lists on every call
+	cl_command_queue queue = task.getQueue();
+	cl_event uploads[2]{};
+	cl_uint uploadCount = 0;
+	cl_event kernelEvent{};
+	if (!zeroCopy)
+	{
+		res = clEnqueueWriteBuffer(queue, matrABuff, CL_FALSE, 0, matrABytes, matrA, 0, NULL, &uploads[uploadCount++]);
+		if (res == CL_SUCCESS)
 		{
-			std::cout << "Problem in params passing process\n";
-			std::cout << res << std::endl;
-			return {};
+			res = clEnqueueWriteBuffer(queue, matrBBuff, CL_FALSE, 0, matrBBytes, matrB, 0, NULL, &uploads[uploadCount++]);
 		}
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = clEnqueueNDRangeKernel(queue, task.getKernel(), 2, NULL, globalSize, localSize,
+			uploadCount, uploadCount ? uploads : NULL, &kernelEvent);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = zeroCopy ?
+			my::GpuTask::enqueueHostSync(queue, resMatrBuff, resMatrBytes, 1, &kernelEvent, NULL) :
+			clEnqueueReadBuffer(queue, resMatrBuff, CL_TRUE, 0, resMatrBytes, resMatr, 1, &kernelEvent, NULL);
+	}
+	clFinish(queue);
 
-		double kernelTime{};
+	double kernelTime{};
+	cl_ulong start{}, end{};
+	if (res == CL_SUCCESS &&
+		clGetEventProfilingInfo(kernelEvent, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS &&
+		clGetEventProfilingInfo(kernelEvent, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS)
+	{
+		kernelTime = (end - start) * 1e-9;
+	}
+	for (cl_event event : { uploads[0], uploads[1], kernelEvent })
+	{
+		if (event)
+		{
+			clReleaseEvent(event);
+		}
+	}
+	releaseZeroCopy();
+	if (res != CL_SUCCESS)
+	{
+		std::cout << res << '\n';
+		std::cout << "With enqueue task proc problems\n";
+		return EXIT_FAILURE;
+	}
+	totalTime = omp_get_wtime() - totalTime;
+	std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+	std::cout << "Total time on GPU: " << totalTime << '\n';
+	return EXIT_SUCCESS;
+}
 
-		res = task.enqueueKernel(2, localSize, globalSize, &kernelTime);
+std::vector<cl_int> matMultGpu(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, bool useSharedMemory)
+{
+	if (matrA.size() < static_cast<size_t>(sizeZ) * sizeY || matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return {};
+	}
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	MatMultWorkspace workspace;
+	if (matMultGpu(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX, device, workspace, useSharedMemory) != EXIT_SUCCESS)
+	{
+		return {};
+	}
+	return resMatr;
+}
+
+my::CoTask<std::vector<cl_int>> matMultGpuAsync(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB,
+	cl_int sizeZ, cl_int sizeY, cl_int sizeX, const char* device, bool useSharedMemory, my::Resumer* resumer)
+{
+	if (matrA.size() < static_cast<size_t>(sizeZ) * sizeY || matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		co_return std::vector<cl_int>();
+	}
+	const char* source = useSharedMemory ? my::kernels::matMultShared.source : my::kernels::matMultBase.source;
+	int res = CL_SUCCESS;
+	cl_context context{};
+	cl_command_queue queue{};
+	cl_kernel kernel{};
+	bool zeroCopy{ false };
+	{
+		// Same cache entry as matMultGpu; the call sets its arguments on a kernel object of
+		// its own, so the cached task goes back to the cache before the first suspension
+		my::KernelCache::Lease lease = my::KernelCache::instance().acquire(device, source,
+			{ { "DIM_Y", sizeY }, { "DIM_X", sizeX }, { "UNROLL_Y", unrollFactor(sizeY) } }, nullptr,
+			CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE);
+		my::GpuTask& task = *lease;
+		if (task.isTaskFailed())
+		{
+			std::cout << "GpuTask creation failed!\n";
+			co_return std::vector<cl_int>();
+		}
+		kernel = task.createKernel("operation", res);
 		if (res != CL_SUCCESS)
 		{
-			std::cout << "With enqueue task proc problems\n";
-			return {};
+			std::cout << "Kernel creation failed!\n";
+			co_return std::vector<cl_int>();
 		}
-		if (AMD_device.find(device) == AMD_device.npos)
+		context = task.getContext();
+		// Outlives an eviction of the cached task while the commands are in flight
+		queue = task.getQueue();
+		clRetainCommandQueue(queue);
+		const my::DeviceInfo* deviceInfo = my::DeviceSelector::instance().find(task.getDevice());
+		zeroCopy = deviceInfo && deviceInfo->unifiedMemory;
+	}
+
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	size_t localSize[]{ 16, 16 };
+	size_t globalSize[]{ static_cast<size_t>(sizeX), static_cast<size_t>(sizeZ) };
+	const size_t matrABytes = sizeof(cl_int) * sizeZ * sizeY;
+	const size_t matrBBytes = sizeof(cl_int) * sizeY * sizeX;
+	const size_t resMatrBytes = sizeof(cl_int) * resMatr.size();
+
+	cl_mem matrABuff{}, matrBBuff{}, resMatrBuff{};
+	cl_event uploads[2]{};
+	cl_uint uploadCount = 0;
+	cl_event kernelEvent{};
+	cl_event done{};
+	auto release = [&]()
+	{
+		for (cl_mem buffer : { matrABuff, matrBBuff, resMatrBuff })
 		{
-			std::cout << "HERE\n";
-			res = task.enqueueReadBuffer<cl_int>(resMatrBuffer, resMatr.data(), resMatrBuff);
-			if (res != CL_SUCCESS)
+			if (buffer)
 			{
-				std::cout << "Problem in read buffer enqueue\n";
-				return {};
+				clReleaseMemObject(buffer);
 			}
 		}
-		totalTime = omp_get_wtime() - totalTime;
-		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
-		std::cout << "Total time on GPU: " << totalTime << '\n';
-		clReleaseMemObject(matrABuff);
-		clReleaseMemObject(matrBBuff);
-		clReleaseMemObject(resMatrBuff);
-		return resMatr;
+		for (cl_event event : { uploads[0], uploads[1], kernelEvent, done })
+		{
+			if (event)
+			{
+				clReleaseEvent(event);
+			}
+		}
+		clReleaseKernel(kernel);
+		clReleaseCommandQueue(queue);
+	};
+
+	const cl_mem_flags hostPtr = zeroCopy ? CL_MEM_USE_HOST_PTR : 0;
+	matrABuff = clCreateBuffer(context, CL_MEM_READ_ONLY | hostPtr, matrABytes, zeroCopy ? const_cast<cl_int*>(matrA.data()) : NULL, &res);
+	if (res == CL_SUCCESS)
+	{
+		matrBBuff = clCreateBuffer(context, CL_MEM_READ_ONLY | hostPtr, matrBBytes, zeroCopy ? const_cast<cl_int*>(matrB.data()) : NULL, &res);
 	}
-	else
+	if (res == CL_SUCCESS)
 	{
-		std::cout << "GpuTask creation failed!\n";
-		return {};
+		resMatrBuff = clCreateBuffer(context, CL_MEM_WRITE_ONLY | hostPtr, resMatrBytes, zeroCopy ? resMatr.data() : NULL, &res);
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in buffer creation process\n";
+		release();
+		co_return std::vector<cl_int>();
 	}
+
+	res = my::GpuTask::passKernelParams(kernel, matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in params passing process\n";
+		std::cout << res << std::endl;
+		release();
+		co_return std::vector<cl_int>();
+	}
+
+	// The cached queue is out of order, so the uploads overlap and the events carry the ordering
+	if (!zeroCopy)
+	{
+		res = clEnqueueWriteBuffer(queue, matrABuff, CL_FALSE, 0, matrABytes, matrA.data(), 0, NULL, &uploads[uploadCount++]);
+		if (res == CL_SUCCESS)
+		{
+			res = clEnqueueWriteBuffer(queue, matrBBuff, CL_FALSE, 0, matrBBytes, matrB.data(), 0, NULL, &uploads[uploadCount++]);
+		}
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSize, localSize,
+			uploadCount, uploadCount ? uploads : NULL, &kernelEvent);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = zeroCopy ?
+			my::GpuTask::enqueueHostSync(queue, resMatrBuff, resMatrBytes, 1, &kernelEvent, &done) :
+			clEnqueueReadBuffer(queue, resMatrBuff, CL_FALSE, 0, resMatrBytes, resMatr.data(), 1, &kernelEvent, &done);
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "With enqueue task proc problems\n";
+		// Commands already queued may still be reading the caller's matrices
+		clFinish(queue);
+		release();
+		co_return std::vector<cl_int>();
+	}
+
+	const cl_int status = co_await my::awaitEvent(done, resumer);
+	release();
+	if (status != CL_COMPLETE)
+	{
+		std::cout << "Device execution failed: " << status << '\n';
+		co_return std::vector<cl_int>();
+	}
+	co_return std::move(resMatr);
 }
 
-std::vector<cl_int> matMultCpu(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+void matMultCpu(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeZ);
 	for (int64_t z = 0; z < sizeZ; ++z)
 	{
 		for (int64_t x = 0; x < sizeX; ++x)
@@ -188,12 +546,17 @@ std::vector<cl_int> matMultCpu(const std::vector<cl_int>& matrA, const std::vect
 			resMatr[z * sizeX + x] = tmp;
 		}
 	}
+}
+
+std::vector<cl_int> matMultCpu(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeZ);
+	matMultCpu(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX);
 	return resMatr;
 }
 
-std::vector<cl_int> matMultCpuTransp(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+void matMultCpuTransp(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeZ);
 	for (int64_t z = 0; z < sizeZ; ++z)
 	{
 		for (int64_t x = 0; x < sizeX; ++x)
@@ -206,44 +569,57 @@ std::vector<cl_int> matMultCpuTransp(const std::vector<cl_int>& matrA, const std
 			resMatr[z * sizeX + x] = tmp;
 		}
 	}
-	return resMatr;
 }
 
-std::vector<cl_int> matMultCpuBlock(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+std::vector<cl_int> matMultCpuTransp(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeZ);
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeZ);
+	matMultCpuTransp(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX);
+	return resMatr;
+}
 
-	int64_t yBlock = 16;
-	int64_t xBlock = 16;
-	int64_t zBlock = 16;
+void matMultCpuBlock(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	const int64_t yBlock = 16;
+	const int64_t xBlock = 16;
+	const int64_t zBlock = 16;
 
 	for (int64_t z = 0; z < sizeZ; z += zBlock)
 	{
+		const int64_t zEnd = std::min<int64_t>(z + zBlock, sizeZ);
 		for (int64_t x = 0; x < sizeX; x += xBlock)
 		{
+			const int64_t xEnd = std::min<int64_t>(x + xBlock, sizeX);
 			for (int64_t y = 0; y < sizeY; y += yBlock)
 			{
-				for (int64_t zb = z; zb < z + zBlock; ++zb)
+				const int64_t yEnd = std::min<int64_t>(y + yBlock, sizeY);
+				for (int64_t zb = z; zb < zEnd; ++zb)
 				{
-					for (int64_t xb = x; xb < x + xBlock; ++xb)
+					for (int64_t xb = x; xb < xEnd; ++xb)
 					{
 						cl_int tmp = 0;
-						for (int64_t yb = y; yb < y + yBlock; ++yb)
+						for (int64_t yb = y; yb < yEnd; ++yb)
 						{
 							tmp += matrA[zb * sizeY + yb] * matrB[yb * sizeX + xb];
 						}
-						resMatr[zb * sizeX + xb] += tmp;
+						// The first y block initialises the output, so it needs no clearing
+						resMatr[zb * sizeX + xb] = y == 0 ? tmp : resMatr[zb * sizeX + xb] + tmp;
 					}
 				}
 			}
 		}
 	}
+}
+
+std::vector<cl_int> matMultCpuBlock(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeZ);
+	matMultCpuBlock(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX);
 	return resMatr;
 }
 
-std::vector<cl_int> transpMatr(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY)
+void transpMatr(const cl_int* matrA, cl_int* resMatr, cl_int sizeX, cl_int sizeY)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeY);
 	for (int64_t y = 0; y < sizeY; ++y)
 	{
 		for (int64_t x = 0; x < sizeX; ++x)
@@ -251,13 +627,18 @@ std::vector<cl_int> transpMatr(const std::vector<cl_int>& matrA, cl_int sizeX, c
 			resMatr[x * sizeY + y] = matrA[y * sizeX + x];
 		}
 	}
+}
+
+std::vector<cl_int> transpMatr(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeY);
+	transpMatr(matrA.data(), resMatr.data(), sizeX, sizeY);
 	return resMatr;
 }
 
-std::vector<cl_int> matMultCpuOMP(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+void matMultCpuOMP(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeZ);
-#pragma omp parallel for num_threads(8)
+#pragma omp parallel for schedule(static)
 	for (int64_t z = 0; z < sizeZ; ++z)
 	{
 		for (int64_t x = 0; x < sizeX; ++x)
@@ -270,13 +651,18 @@ std::vector<cl_int> matMultCpuOMP(const std::vector<cl_int>& matrA, const std::v
 			resMatr[z * sizeX + x] = tmp;
 		}
 	}
+}
+
+std::vector<cl_int> matMultCpuOMP(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeZ);
+	matMultCpuOMP(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX);
 	return resMatr;
 }
 
-std::vector<cl_int> matMultCpuTranspOMP(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+void matMultCpuTranspOMP(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeZ);
-#pragma omp parallel for num_threads(8)
+#pragma omp parallel for schedule(static)
 	for (int64_t z = 0; z < sizeZ; ++z)
 	{
 		for (int64_t x = 0; x < sizeX; ++x)
@@ -289,13 +675,18 @@ std::vector<cl_int> matMultCpuTranspOMP(const std::vector<cl_int>& matrA, const
 			resMatr[z * sizeX + x] = tmp;
 		}
 	}
+}
+
+std::vector<cl_int> matMultCpuTranspOMP(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeZ);
+	matMultCpuTranspOMP(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX);
 	return resMatr;
 }
 
-std::vector<cl_int> transpMatrOMP(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY)
+void transpMatrOMP(const cl_int* matrA, cl_int* resMatr, cl_int sizeX, cl_int sizeY)
 {
-	std::vector<cl_int> resMatr(sizeX * sizeY);
-#pragma omp parallel for num_threads(8)
+#pragma omp parallel for schedule(static)
 	for (int64_t y = 0; y < sizeY; ++y)
 	{
 		for (int64_t x = 0; x < sizeX; ++x)
@@ -303,5 +694,506 @@ std::vector<cl_int> transpMatrOMP(const std::vector<cl_int>& matrA, cl_int sizeX
 			resMatr[x * sizeY + y] = matrA[y * sizeX + x];
 		}
 	}
+}
+
+std::vector<cl_int> transpMatrOMP(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeY);
+	transpMatrOMP(matrA.data(), resMatr.data(), sizeX, sizeY);
+	return resMatr;
+}
+
+void matMultCpu(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr)
+{
+	MatMultWorkspace workspace;
+	matMultCpu(matrA, matrB, resMatr, workspace);
+}
+
+void matMultCpu(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr,
+	MatMultWorkspace& workspace)
+{
+	if (!matrA.isValid() || !matrB.isValid() || !resMatr.isValid() ||
+		matrA.cols != matrB.rows || resMatr.rows != matrA.rows || resMatr.cols != matrB.cols)
+	{
+		std::cout << "Incompatible matrix views\n";
+		return;
+	}
+
+	const bool colA = matrA.layout == MatrLayout::ColMajor;
+	const bool colB = matrB.layout == MatrLayout::ColMajor;
+	// One accumulator row (or column) per thread
+	const int threads = omp_get_max_threads();
+	cl_int* scratch = !colA && colB ? nullptr :
+		workspace.hostScratch(static_cast<size_t>(threads) * std::max(resMatr.rows, resMatr.cols));
+	if (!colA && !colB)
+	{
+		ViewMatMult<MatrLayout::RowMajor, MatrLayout::RowMajor>::run(matrA, matrB, resMatr, scratch, threads);
+	}
+	else if (!colA && colB)
+	{
+		ViewMatMult<MatrLayout::RowMajor, MatrLayout::ColMajor>::run(matrA, matrB, resMatr, scratch, threads);
+	}
+	else if (colA && !colB)
+	{
+		ViewMatMult<MatrLayout::ColMajor, MatrLayout::RowMajor>::run(matrA, matrB, resMatr, scratch, threads);
+	}
+	else
+	{
+		ViewMatMult<MatrLayout::ColMajor, MatrLayout::ColMajor>::run(matrA, matrB, resMatr, scratch, threads);
+	}
+}
+
+std::vector<cl_int> matMultGpu(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const char* device)
+{
+	if (!matrA.isValid() || !matrB.isValid() || matrA.cols != matrB.rows)
+	{
+		std::cout << "Incompatible matrix views\n";
+		return {};
+	}
+	const cl_int sizeZ = matrA.rows;
+	const cl_int sizeY = matrA.cols;
+	const cl_int sizeX = matrB.cols;
+
+	std::string options;
+	if (matrA.layout == MatrLayout::ColMajor)
+	{
+		options += "-D A_COL_MAJOR ";
+	}
+	if (matrB.layout == MatrLayout::ColMajor)
+	{
+		options += "-D B_COL_MAJOR ";
+	}
+
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	my::DevWorker worker = my::DevWorker();
+
+	my::GpuTask task = worker.createGpuTask(device, my::kernels::matMultStrided.source, options.c_str());
+	if (!task.isTaskFailed())
+	{
+		int res = CL_SUCCESS;
+
+		const size_t tileSize = 16;
+		size_t localSize[]{ tileSize, tileSize };
+		size_t globalSize[]{ (sizeZ + tileSize - 1) / tileSize * tileSize, (sizeX + tileSize - 1) / tileSize * tileSize };
+
+		// Only the span the view covers is uploaded, starting at its first element
+		const size_t matrABuffer = matrA.span();
+		const size_t matrBBuffer = matrB.span();
+		const size_t resMatrBuffer = resMatr.size();
+
+		double totalTime = omp_get_wtime();
+
+		cl_mem matrABuff = task.addBuffer<cl_int>(matrABuffer, CL_MEM_READ_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer1 creation process\n";
+			return {};
+		}
+
+		cl_mem matrBBuff = task.addBuffer<cl_int>(matrBBuffer, CL_MEM_READ_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer2 creation process\n";
+			clReleaseMemObject(matrABuff);
+			return {};
+		}
+
+		cl_mem resMatrBuff = task.addBuffer<cl_int>(resMatrBuffer, CL_MEM_WRITE_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer3 creation process\n";
+			clReleaseMemObject(matrABuff);
+			clReleaseMemObject(matrBBuff);
+			return {};
+		}
+
+		auto release = [&]()
+		{
+			clReleaseMemObject(matrABuff);
+			clReleaseMemObject(matrBBuff);
+			clReleaseMemObject(resMatrBuff);
+		};
+
+		res = task.enqueueWriteBuffer<cl_int>(matrABuffer, matrA.data + matrA.offset, matrABuff);
+		if (res == CL_SUCCESS)
+		{
+			res = task.enqueueWriteBuffer<cl_int>(matrBBuffer, matrB.data + matrB.offset, matrBBuff);
+		}
+		if (res != CL_SUCCESS)
+		{
+			std::cout << res << '\n';
+			std::cout << "Problem in write buffer enqueue\n";
+			release();
+			return {};
+		}
+
+		res = task.passParams(matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX, matrA.ld, matrB.ld);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in params passing process\n";
+			std::cout << res << std::endl;
+			release();
+			return {};
+		}
+
+		double kernelTime{};
+		res = task.enqueueKernel(2, localSize, globalSize, &kernelTime);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "With enqueue task proc problems\n";
+			release();
+			return {};
+		}
+
+		res = task.enqueueReadBuffer<cl_int>(resMatrBuffer, resMatr.data(), resMatrBuff);
+		release();
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in read buffer enqueue\n";
+			return {};
+		}
+		totalTime = omp_get_wtime() - totalTime;
+		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+		std::cout << "Total time on GPU: " << totalTime << '\n';
+		return resMatr;
+	}
+	else
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return {};
+	}
+}
+
+GemmPlan planGemm(cl_int sizeZ, cl_int sizeY, cl_int sizeX, cl_uint parallelUnits)
+{
+	GemmPlan plan;
+	plan.chunk = sizeY;
+	if (sizeX == 1)
+	{
+		plan.shape = GemmShape::Gemv;
+		return plan;
+	}
+	const int64_t outputs = static_cast<int64_t>(sizeZ) * sizeX;
+	if (outputs <= SMALL_GEMM_THREADS && static_cast<int64_t>(sizeY) * (sizeZ + sizeX) <= SMALL_GEMM_ELEMENTS)
+	{
+		plan.shape = GemmShape::Small;
+		return plan;
+	}
+
+	// A few work-groups per compute unit are needed to hide memory latency
+	const int64_t targetGroups = 4 * static_cast<int64_t>(std::max<cl_uint>(parallelUnits, 1));
+	const int64_t tiles = static_cast<int64_t>(roundUp(sizeZ, GEMM_TILE) / GEMM_TILE) * (roundUp(sizeX, GEMM_TILE) / GEMM_TILE);
+	const int64_t maxSplits = sizeY / SPLIT_K_MIN_CHUNK;
+	if (tiles < targetGroups && maxSplits >= 2)
+	{
+		const int64_t splits = std::min(maxSplits, (targetGroups + tiles - 1) / tiles);
+		const int64_t chunk = roundUp((sizeY + splits - 1) / splits, GEMM_TILE);
+		plan.splits = static_cast<cl_int>((sizeY + chunk - 1) / chunk);
+		plan.chunk = static_cast<cl_int>(chunk);
+		if (plan.splits >= 2)
+		{
+			plan.shape = GemmShape::SplitK;
+			return plan;
+		}
+		plan.splits = 1;
+		plan.chunk = sizeY;
+	}
+
+	if (sizeZ == 1)
+	{
+		plan.shape = GemmShape::Gemv;
+	}
+	return plan;
+}
+
+std::vector<cl_int> matMultCpuDispatch(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	if (sizeZ <= 0 || sizeY <= 0 || sizeX <= 0 ||
+		matrA.size() < static_cast<size_t>(sizeZ) * sizeY || matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return {};
+	}
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	MatMultWorkspace workspace;
+	matMultCpuDispatch(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX, workspace);
 	return resMatr;
 }
+
+void matMultCpuDispatch(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	MatMultWorkspace& workspace)
+{
+	if (sizeZ <= 0 || sizeY <= 0 || sizeX <= 0)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return;
+	}
+	const GemmPlan plan = planGemm(sizeZ, sizeY, sizeX, omp_get_max_threads());
+
+	switch (plan.shape)
+	{
+	case GemmShape::Gemv:
+		if (sizeX == 1)
+		{
+#pragma omp parallel for schedule(static)
+			for (int64_t z = 0; z < sizeZ; ++z)
+			{
+				const cl_int* rowA = matrA + z * sizeY;
+				cl_int tmp = 0;
+				for (int64_t y = 0; y < sizeY; ++y)
+				{
+					tmp += rowA[y] * matrB[y];
+				}
+				resMatr[z] = tmp;
+			}
+		}
+		else
+		{
+			// Row vector times matrix: each thread accumulates scaled rows of B over its own columns
+#pragma omp parallel
+			{
+				const int64_t threads = omp_get_num_threads();
+				const int64_t thread = omp_get_thread_num();
+				const int64_t xBegin = sizeX * thread / threads;
+				const int64_t xEnd = sizeX * (thread + 1) / threads;
+				std::fill(resMatr + xBegin, resMatr + xEnd, 0);
+				for (int64_t y = 0; y < sizeY; ++y)
+				{
+					const cl_int a = matrA[y];
+					const cl_int* rowB = matrB + y * sizeX;
+					for (int64_t x = xBegin; x < xEnd; ++x)
+					{
+						resMatr[x] += a * rowB[x];
+					}
+				}
+			}
+		}
+		break;
+	case GemmShape::Small:
+		// Too little work to pay for a parallel region
+		for (int64_t z = 0; z < sizeZ; ++z)
+		{
+			cl_int* rowRes = resMatr + z * sizeX;
+			std::fill(rowRes, rowRes + sizeX, 0);
+			for (int64_t y = 0; y < sizeY; ++y)
+			{
+				const cl_int a = matrA[z * sizeY + y];
+				const cl_int* rowB = matrB + y * sizeX;
+				for (int64_t x = 0; x < sizeX; ++x)
+				{
+					rowRes[x] += a * rowB[x];
+				}
+			}
+		}
+		break;
+	case GemmShape::SplitK:
+	{
+		const int64_t outputs = static_cast<int64_t>(sizeZ) * sizeX;
+		cl_int* partials = workspace.hostScratch(plan.splits * outputs);
+#pragma omp parallel for schedule(static)
+		for (int64_t split = 0; split < plan.splits; ++split)
+		{
+			cl_int* partial = partials + split * outputs;
+			std::fill(partial, partial + outputs, 0);
+			const int64_t yBegin = split * plan.chunk;
+			const int64_t yEnd = std::min<int64_t>(sizeY, yBegin + plan.chunk);
+			for (int64_t z = 0; z < sizeZ; ++z)
+			{
+				for (int64_t y = yBegin; y < yEnd; ++y)
+				{
+					const cl_int a = matrA[z * sizeY + y];
+					const cl_int* rowB = matrB + y * sizeX;
+					for (int64_t x = 0; x < sizeX; ++x)
+					{
+						partial[z * sizeX + x] += a * rowB[x];
+					}
+				}
+			}
+		}
+#pragma omp parallel for schedule(static)
+		for (int64_t index = 0; index < outputs; ++index)
+		{
+			cl_int tmp = 0;
+			for (int64_t split = 0; split < plan.splits; ++split)
+			{
+				tmp += partials[split * outputs + index];
+			}
+			resMatr[index] = tmp;
+		}
+		break;
+	}
+	case GemmShape::General:
+		matMultCpu(MatrView<const cl_int>(matrA, sizeZ, sizeY), MatrView<const cl_int>(matrB, sizeY, sizeX),
+			MatrView<cl_int>(resMatr, sizeZ, sizeX), workspace);
+		break;
+	}
+}
+
+std::vector<cl_int> matMultGpuDispatch(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device)
+{
+	if (sizeZ <= 0 || sizeY <= 0 || sizeX <= 0 ||
+		matrA.size() < static_cast<size_t>(sizeZ) * sizeY || matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return {};
+	}
+	const my::DeviceInfo* deviceInfo = my::DeviceSelector::instance().findByName(device);
+	const GemmPlan plan = planGemm(sizeZ, sizeY, sizeX, deviceInfo ? deviceInfo->computeUnits : 0);
+
+	const char* source = my::kernels::matMultStrided.source;
+	std::string options;
+	cl_uint numDims = 2;
+	size_t localSize[]{ GEMM_TILE, GEMM_TILE, 1 };
+	size_t globalSize[]{ roundUp(sizeZ, GEMM_TILE), roundUp(sizeX, GEMM_TILE), 1 };
+	switch (plan.shape)
+	{
+	case GemmShape::Gemv:
+		source = my::kernels::matMultGemv.source;
+		numDims = 1;
+		localSize[0] = GEMV_GROUP_SIZE;
+		if (sizeX == 1)
+		{
+			options = "-D VECTOR_RIGHT -D GROUP_SIZE=" + std::to_string(GEMV_GROUP_SIZE);
+			globalSize[0] = static_cast<size_t>(sizeZ) * GEMV_GROUP_SIZE;
+		}
+		else
+		{
+			globalSize[0] = roundUp(sizeX, GEMV_GROUP_SIZE);
+		}
+		break;
+	case GemmShape::Small:
+		source = my::kernels::matMultSmall.source;
+		options = "-D SIZE_A=" + std::to_string(sizeZ * sizeY) + " -D SIZE_B=" + std::to_string(sizeY * sizeX);
+		localSize[0] = globalSize[0] = sizeZ;
+		localSize[1] = globalSize[1] = sizeX;
+		break;
+	case GemmShape::SplitK:
+		source = my::kernels::matMultSplitK.source;
+		numDims = 3;
+		globalSize[2] = plan.splits;
+		break;
+	case GemmShape::General:
+		break;
+	}
+
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	my::DevWorker worker = my::DevWorker();
+	my::GpuTask task = worker.createGpuTask(device, source, options.c_str(),
+		CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE);
+	if (!task.isTaskFailed())
+	{
+		int res = CL_SUCCESS;
+		const size_t matrABuffer = static_cast<size_t>(sizeZ) * sizeY;
+		const size_t matrBBuffer = static_cast<size_t>(sizeY) * sizeX;
+		const size_t resMatrBuffer = resMatr.size();
+		const size_t partialsBuffer = plan.shape == GemmShape::SplitK ? plan.splits * resMatrBuffer : 0;
+
+		double totalTime = omp_get_wtime();
+		cl_mem matrABuff{}, matrBBuff{}, resMatrBuff{}, partialsBuff{};
+		cl_kernel reduceKernel{};
+		auto release = [&]()
+		{
+			for (cl_mem buffer : { matrABuff, matrBBuff, resMatrBuff, partialsBuff })
+			{
+				if (buffer)
+				{
+					clReleaseMemObject(buffer);
+				}
+			}
+			if (reduceKernel)
+			{
+				clReleaseKernel(reduceKernel);
+			}
+		};
+
+		matrABuff = task.addBuffer<cl_int>(matrABuffer, CL_MEM_READ_ONLY, res);
+		if (res == CL_SUCCESS)
+		{
+			matrBBuff = task.addBuffer<cl_int>(matrBBuffer, CL_MEM_READ_ONLY, res);
+		}
+		if (res == CL_SUCCESS)
+		{
+			resMatrBuff = task.addBuffer<cl_int>(resMatrBuffer, CL_MEM_READ_WRITE, res);
+		}
+		if (res == CL_SUCCESS && partialsBuffer)
+		{
+			partialsBuff = task.addBuffer<cl_int>(partialsBuffer, CL_MEM_READ_WRITE, res);
+		}
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			release();
+			return {};
+		}
+
+		switch (plan.shape)
+		{
+		case GemmShape::General:
+			res = task.passParams(matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX, sizeY, sizeX);
+			break;
+		case GemmShape::SplitK:
+		{
+			res = task.passParams(matrABuff, matrBBuff, partialsBuff, sizeZ, sizeY, sizeX, plan.chunk);
+			const cl_uint count = static_cast<cl_uint>(resMatrBuffer);
+			const cl_uint splits = static_cast<cl_uint>(plan.splits);
+			if (res == CL_SUCCESS)
+			{
+				reduceKernel = task.createKernel("reducePartials", res);
+			}
+			if (res == CL_SUCCESS)
+			{
+				clSetKernelArg(reduceKernel, 0, sizeof(cl_mem), &partialsBuff);
+				clSetKernelArg(reduceKernel, 1, sizeof(cl_mem), &resMatrBuff);
+				clSetKernelArg(reduceKernel, 2, sizeof(cl_uint), &count);
+				res = clSetKernelArg(reduceKernel, 3, sizeof(cl_uint), &splits);
+			}
+			break;
+		}
+		default:
+			res = task.passParams(matrABuff, matrBBuff, resMatrBuff, sizeZ, sizeY, sizeX);
+			break;
+		}
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in params passing process\n";
+			std::cout << res << std::endl;
+			release();
+			return {};
+		}
+
+		double kernelTime{};
+		{
+			my::DagScheduler scheduler(task);
+			auto uploadA = scheduler.addWrite(matrABuff, matrA.data(), sizeof(cl_int) * matrABuffer);
+			auto uploadB = scheduler.addWrite(matrBBuff, matrB.data(), sizeof(cl_int) * matrBBuffer);
+			auto kernel = scheduler.addKernel(task.getKernel(), numDims, globalSize, localSize, { uploadA, uploadB });
+			auto result = kernel;
+			if (reduceKernel)
+			{
+				size_t reduceLocal = GEMV_GROUP_SIZE;
+				size_t reduceGlobal = roundUp(resMatrBuffer, reduceLocal);
+				result = scheduler.addKernel(reduceKernel, 1, &reduceGlobal, &reduceLocal, { kernel });
+			}
+			scheduler.addRead(resMatrBuff, resMatr.data(), sizeof(cl_int) * resMatrBuffer, { result });
+			res = scheduler.wait();
+			kernelTime = scheduler.nodeTime(kernel) + (reduceKernel ? scheduler.nodeTime(result) : 0);
+		}
+		release();
+		if (res != CL_SUCCESS)
+		{
+			std::cout << res << '\n';
+			std::cout << "With enqueue task proc problems\n";
+			return {};
+		}
+		totalTime = omp_get_wtime() - totalTime;
+		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+		std::cout << "Total time on GPU: " << totalTime << '\n';
+		return resMatr;
+	}
+	else
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return {};
+	}
+}
@@ -1,17 +1,124 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <CL/cl.h>
+#include "MatrView.h"
+#include "KernelCache.h"
+#include "GpuAsync.h"
+
+// Scratch space reused across calls: host scratch and device buffers only grow. A call
+// leases its task from the KernelCache for its own duration only; once the same workspace
+// runs the same shape again it builds a task of its own, specialised for that shape, so
+// repeated calls of one shape allocate nothing once warmed up and never hold a cache slot
+// between calls. A workspace is not thread-safe; give each thread its own.
+class MatMultWorkspace
+{
+public:
+	MatMultWorkspace() = default;
+	~MatMultWorkspace();
+	MatMultWorkspace(const MatMultWorkspace&) = delete;
+	MatMultWorkspace& operator=(const MatMultWorkspace&) = delete;
+
+	// At least count elements, contents unspecified
+	cl_int* hostScratch(size_t count);
+	// At least bytes on context in the given slot, contents unspecified
+	cl_mem deviceBuffer(size_t slot, cl_context context, size_t bytes, int& err);
+
+	// Records the device, kernel and shape of a call; true if the previous call had the
+	// same ones. A different one drops the task built for the old
+	bool repeats(const char* device, const char* source, cl_int sizeY, cl_int sizeX);
+	bool hasTask() const
+	{
+		return m_hasTask;
+	}
+	my::GpuTask& buildTask(const std::string& options, cl_command_queue_properties properties);
+	my::GpuTask& task()
+	{
+		return m_task;
+	}
+	void releaseTask();
+	// Frees the task and the device buffers
+	void releaseDevice();
+
+private:
+	struct DeviceBuffer
+	{
+		cl_mem buffer{};
+		cl_context context{};
+		size_t bytes{};
+	};
+	static const size_t BUFFER_SLOTS{ 4 };
+
+	std::vector<cl_int> m_hostScratch;
+	DeviceBuffer m_buffers[BUFFER_SLOTS];
+
+	my::GpuTask m_task;
+	bool m_hasTask{ false };
+	std::string m_device;
+	const char* m_source{};
+	cl_int m_sizeY{};
+	cl_int m_sizeX{};
+};
 
 std::vector<cl_int> matMultCpu(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, cl_int sizeY, cl_int sizeZ);
 std::vector<cl_int> matMultCpuTransp(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, cl_int sizeY, cl_int sizeZ);
 std::vector<cl_int> matMultCpuOMP(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, cl_int sizeY, cl_int sizeZ);
 std::vector<cl_int> transpMatr(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY);
 
+// The OMP variants split output rows (source rows for the transpose) with schedule(static)
+// over all threads, so operands placed with my::firstTouchRows over the same rows stay
+// on the socket of the thread that reads them
 std::vector<cl_int> matMultCpuTranspOMP(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, cl_int sizeY, cl_int sizeZ);
 std::vector<cl_int> transpMatrOMP(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY);
 
 std::vector<cl_int> matMultCpuBlock(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, cl_int sizeY, cl_int sizeZ);
 
-std::vector<cl_int> matMultGpu(std::vector<cl_int>& matrA, std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+std::vector<cl_int> matMultGpu(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
 	const char* device, bool useSharedMemory = false);
 
+// Output-parameter forms: resMatr holds sizeZ * sizeX elements (sizeX * sizeY for transposes)
+// and is only written, so it needs no clearing beforehand
+void matMultCpu(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+void matMultCpuTransp(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+void matMultCpuOMP(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+void matMultCpuTranspOMP(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+void matMultCpuBlock(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+void transpMatr(const cl_int* matrA, cl_int* resMatr, cl_int sizeX, cl_int sizeY);
+void transpMatrOMP(const cl_int* matrA, cl_int* resMatr, cl_int sizeX, cl_int sizeY);
+
+// Returns EXIT_SUCCESS or EXIT_FAILURE
+int matMultGpu(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, MatMultWorkspace& workspace, bool useSharedMemory = false);
+
+// Coroutine form of matMultGpu, empty on failure. It suspends instead of blocking while the
+// device works; matrA and matrB must stay alive until the task finishes.
+my::CoTask<std::vector<cl_int>> matMultGpuAsync(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB,
+	cl_int sizeZ, cl_int sizeY, cl_int sizeX, const char* device, bool useSharedMemory = false, my::Resumer* resumer = nullptr);
+
+// Strided views: transposed operands and sub-blocks are read in place, resMatr must be matrA.rows x matrB.cols
+void matMultCpu(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr);
+void matMultCpu(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const MatrView<cl_int>& resMatr,
+	MatMultWorkspace& workspace);
+std::vector<cl_int> matMultGpu(const MatrView<const cl_int>& matrA, const MatrView<const cl_int>& matrB, const char* device);
+
+// Shape-aware dispatch. Gemv: one operand is a vector; Small: both operands fit in local memory
+// of one work-group; SplitK: too few output tiles to fill the device, so Y is split across
+// work-groups and the partial products are summed in a second pass
+enum class GemmShape { General, Gemv, Small, SplitK };
+
+struct GemmPlan
+{
+	GemmShape shape{ GemmShape::General };
+	cl_int splits{ 1 };
+	// Length of the Y range each split covers
+	cl_int chunk{};
+};
+
+// parallelUnits is the number of compute units (GPU) or threads (CPU) to keep busy
+GemmPlan planGemm(cl_int sizeZ, cl_int sizeY, cl_int sizeX, cl_uint parallelUnits);
+
+std::vector<cl_int> matMultCpuDispatch(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+void matMultCpuDispatch(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	MatMultWorkspace& workspace);
+std::vector<cl_int> matMultGpuDispatch(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device);
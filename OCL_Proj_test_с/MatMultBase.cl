@@ -0,0 +1,23 @@
+// Dimensions fall back to the kernel arguments unless KernelCache bakes them in with -D
+#ifndef DIM_Y
+#define DIM_Y Y
+#endif
+#ifndef DIM_X
+#define DIM_X X
+#endif
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X)
+{
+	int z = get_global_id(0);
+	int x = get_global_id(1);
+	int sum = 0;
+#ifdef UNROLL_Y
+	#pragma unroll UNROLL_Y
+#endif
+	for (int y = 0; y < DIM_Y; ++y)
+	{
+		sum += matrA[z * DIM_Y + y] * matrB[y * DIM_X + x];
+	}
+	resMatr[z * DIM_X + x] = sum;
+}
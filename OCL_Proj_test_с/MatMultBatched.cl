@@ -0,0 +1,18 @@
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X)
+{
+	int z = get_global_id(0);
+	int x = get_global_id(1);
+	size_t b = get_global_id(2);
+	if (z >= Z || x >= X) return;
+	matrA += b * Z * Y;
+	matrB += b * Y * X;
+	resMatr += b * Z * X;
+	int sum = 0;
+	for (int y = 0; y < Y; ++y)
+	{
+		sum += matrA[z * Y + y] * matrB[y * X + x];
+	}
+	resMatr[z * X + x] = sum;
+}
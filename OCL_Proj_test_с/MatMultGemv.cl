@@ -0,0 +1,36 @@
+// -D VECTOR_RIGHT: matrix times column vector, one work-group reduces each row;
+// otherwise row vector times matrix, one work-item per output column
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X)
+{
+#ifdef VECTOR_RIGHT
+	int z = get_group_id(0);
+	int lid = get_local_id(0);
+	__local int partial[GROUP_SIZE];
+	int sum = 0;
+	for (int y = lid; y < Y; y += GROUP_SIZE)
+	{
+		sum += matrA[(size_t)z * Y + y] * matrB[y];
+	}
+	partial[lid] = sum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for (int step = GROUP_SIZE / 2; step > 0; step >>= 1)
+	{
+		if (lid < step)
+			partial[lid] += partial[lid + step];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (lid == 0)
+		resMatr[z] = partial[0];
+#else
+	int x = get_global_id(0);
+	if (x >= X) return;
+	int sum = 0;
+	for (int y = 0; y < Y; ++y)
+	{
+		sum += matrA[y] * matrB[(size_t)y * X + x];
+	}
+	resMatr[x] = sum;
+#endif
+}
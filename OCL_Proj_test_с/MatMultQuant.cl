@@ -0,0 +1,28 @@
+// uchar4 x char4 products through cl_khr_integer_dot_product when the device has it
+#ifdef USE_INTEGER_DOT
+#pragma OPENCL EXTENSION cl_khr_integer_dot_product : enable
+#define DOT4(a, b) dot(a, b)
+#else
+#define DOT4(a, b) ((int)(a).x * (b).x + (int)(a).y * (b).y + \
+	(int)(a).z * (b).z + (int)(a).w * (b).w)
+#endif
+__kernel void operation(const __global uchar4 * matrA,
+	const __global char4 * matrBT, const __global int * rowSumA,
+	const __global int * colSumB, const __global int * zeroA,
+	const __global int * zeroB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X, unsigned int K4)
+{
+	int x = get_global_id(0);
+	int z = get_global_id(1);
+	if (x >= X || z >= Z) return;
+	const __global uchar4 * rowA = matrA + (size_t)z * K4;
+	const __global char4 * colB = matrBT + (size_t)x * K4;
+	int sum = 0;
+	for (int k = 0; k < K4; ++k)
+	{
+		sum += DOT4(rowA[k], colB[k]);
+	}
+	int za = zeroA[z];
+	int zb = zeroB[x];
+	resMatr[z * X + x] = sum - zb * rowSumA[z] - za * colSumB[x] + (int)Y * za * zb;
+}
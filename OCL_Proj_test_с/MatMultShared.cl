@@ -0,0 +1,34 @@
+#define TILE_SIZE 16
+#ifndef DIM_Y
+#define DIM_Y Y
+#endif
+#ifndef DIM_X
+#define DIM_X X
+#endif
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X)
+{
+	int z = get_global_id(0);
+	int x = get_global_id(1);
+	int lz = get_local_id(0);
+	int lx = get_local_id(1);
+
+	__local int tileA[TILE_SIZE][TILE_SIZE];
+	__local int tileB[TILE_SIZE][TILE_SIZE];
+
+	int sum = 0;
+	for (int tileY = 0; tileY * TILE_SIZE < DIM_Y; ++tileY)
+	{
+		tileA[lz][lx] = matrA[z * DIM_Y + (tileY * TILE_SIZE + lx)];
+		tileB[lz][lx] = matrB[(tileY * TILE_SIZE + lz) * DIM_X + x];
+		barrier(CLK_LOCAL_MEM_FENCE);
+		#pragma unroll
+		for (int y = 0; y < TILE_SIZE; ++y)
+		{
+			sum += tileA[lz][y] * tileB[y][lx];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	resMatr[z * DIM_X + x] = sum;
+}
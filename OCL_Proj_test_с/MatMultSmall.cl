@@ -0,0 +1,23 @@
+// Operand sizes are passed as -D SIZE_A / -D SIZE_B
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X)
+{
+	__local int localA[SIZE_A];
+	__local int localB[SIZE_B];
+	int z = get_local_id(0);
+	int x = get_local_id(1);
+	int lid = x * get_local_size(0) + z;
+	int groupSize = get_local_size(0) * get_local_size(1);
+	for (int i = lid; i < Z * Y; i += groupSize)
+		localA[i] = matrA[i];
+	for (int i = lid; i < Y * X; i += groupSize)
+		localB[i] = matrB[i];
+	barrier(CLK_LOCAL_MEM_FENCE);
+	int sum = 0;
+	for (int y = 0; y < Y; ++y)
+	{
+		sum += localA[z * Y + y] * localB[y * X + x];
+	}
+	resMatr[z * X + x] = sum;
+}
@@ -0,0 +1,47 @@
+// Each slice along z of the grid multiplies one Y range into its own partial result;
+// reducePartials sums the slices
+#define TILE_SIZE 16
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * partials,
+	unsigned int Z, unsigned int Y, unsigned int X, unsigned int chunk)
+{
+	int z = get_global_id(0);
+	int x = get_global_id(1);
+	int lz = get_local_id(0);
+	int lx = get_local_id(1);
+	size_t split = get_global_id(2);
+	int yBegin = split * chunk;
+	int yEnd = min(Y, yBegin + chunk);
+
+	__local int tileA[TILE_SIZE][TILE_SIZE];
+	__local int tileB[TILE_SIZE][TILE_SIZE];
+
+	int sum = 0;
+	for (int tileY = yBegin; tileY < yEnd; tileY += TILE_SIZE)
+	{
+		int ya = tileY + lx;
+		int yb = tileY + lz;
+		tileA[lz][lx] = (z < Z && ya < yEnd) ? matrA[(size_t)z * Y + ya] : 0;
+		tileB[lz][lx] = (yb < yEnd && x < X) ? matrB[(size_t)yb * X + x] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		for (int y = 0; y < TILE_SIZE; ++y)
+		{
+			sum += tileA[lz][y] * tileB[y][lx];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (z < Z && x < X)
+		partials[split * Z * X + z * X + x] = sum;
+}
+__kernel void reducePartials(const __global int * partials,
+	__global int * resMatr, unsigned int count, unsigned int splits)
+{
+	size_t index = get_global_id(0);
+	if (index >= count) return;
+	int sum = 0;
+	for (size_t split = 0; split < splits; ++split)
+	{
+		sum += partials[split * count + index];
+	}
+	resMatr[index] = sum;
+}
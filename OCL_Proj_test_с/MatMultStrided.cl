@@ -0,0 +1,42 @@
+// Operand layouts are selected at build time with -D A_COL_MAJOR / -D B_COL_MAJOR
+#define TILE_SIZE 16
+#ifdef A_COL_MAJOR
+#define A_AT(r, c) matrA[(c) * ldA + (r)]
+#else
+#define A_AT(r, c) matrA[(r) * ldA + (c)]
+#endif
+#ifdef B_COL_MAJOR
+#define B_AT(r, c) matrB[(c) * ldB + (r)]
+#else
+#define B_AT(r, c) matrB[(r) * ldB + (c)]
+#endif
+__kernel void operation(const __global int * matrA,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int Z, unsigned int Y, unsigned int X,
+	unsigned int ldA, unsigned int ldB)
+{
+	int z = get_global_id(0);
+	int x = get_global_id(1);
+	int lz = get_local_id(0);
+	int lx = get_local_id(1);
+
+	__local int tileA[TILE_SIZE][TILE_SIZE];
+	__local int tileB[TILE_SIZE][TILE_SIZE];
+
+	int sum = 0;
+	for (int tileY = 0; tileY * TILE_SIZE < Y; ++tileY)
+	{
+		int ya = tileY * TILE_SIZE + lx;
+		int yb = tileY * TILE_SIZE + lz;
+		tileA[lz][lx] = (z < Z && ya < Y) ? A_AT(z, ya) : 0;
+		tileB[lz][lx] = (yb < Y && x < X) ? B_AT(yb, x) : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		for (int y = 0; y < TILE_SIZE; ++y)
+		{
+			sum += tileA[lz][y] * tileB[y][lx];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (z < Z && x < X)
+		resMatr[z * X + x] = sum;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <CL/cl.h>
+
+enum class MatrLayout { RowMajor, ColMajor };
+
+// Non-owning strided view of a matrix. ld is the distance between the starts of
+// consecutive rows (row-major) or columns (column-major); offset is counted from data.
+// Transposing or taking a sub-block only changes the descriptor, never the elements.
+template <typename TYPE>
+struct MatrView
+{
+	TYPE* data{};
+	cl_int rows{};
+	cl_int cols{};
+	cl_int ld{};
+	MatrLayout layout{ MatrLayout::RowMajor };
+	size_t offset{};
+
+	MatrView() = default;
+	MatrView(TYPE* _data, cl_int _rows, cl_int _cols, MatrLayout _layout = MatrLayout::RowMajor, cl_int _ld = 0, size_t _offset = 0)
+		: data(_data), rows(_rows), cols(_cols), ld(_ld), layout(_layout), offset(_offset)
+	{
+		if (ld == 0)
+		{
+			ld = layout == MatrLayout::RowMajor ? cols : rows;
+		}
+	}
+
+	// A mutable view can always be read through a const one
+	operator MatrView<const TYPE>() const
+	{
+		return MatrView<const TYPE>(data, rows, cols, layout, ld, offset);
+	}
+
+	size_t index(cl_int row, cl_int col) const
+	{
+		return layout == MatrLayout::RowMajor ?
+			offset + static_cast<size_t>(row) * ld + col :
+			offset + static_cast<size_t>(col) * ld + row;
+	}
+
+	TYPE& at(cl_int row, cl_int col) const
+	{
+		return data[index(row, col)];
+	}
+
+	MatrView transposed() const
+	{
+		return MatrView(data, cols, rows,
+			layout == MatrLayout::RowMajor ? MatrLayout::ColMajor : MatrLayout::RowMajor, ld, offset);
+	}
+
+	MatrView block(cl_int row, cl_int col, cl_int blockRows, cl_int blockCols) const
+	{
+		return MatrView(data, blockRows, blockCols, layout, ld, index(row, col));
+	}
+
+	// Elements between the first and the last element of the view, inclusive
+	size_t span() const
+	{
+		if (rows <= 0 || cols <= 0)
+		{
+			return 0;
+		}
+		return layout == MatrLayout::RowMajor ?
+			static_cast<size_t>(rows - 1) * ld + cols :
+			static_cast<size_t>(cols - 1) * ld + rows;
+	}
+
+	bool isValid() const
+	{
+		return data != nullptr && rows > 0 && cols > 0 &&
+			ld >= (layout == MatrLayout::RowMajor ? cols : rows);
+	}
+};
@@ -0,0 +1,73 @@
+// Requires OpenCL C 2.0. One work-group polls the mailbox in fine-grain SVM for the
+// rest of its life; requests and their operands never cross a kernel launch.
+#define OP_STOP 0
+#define OP_SAXPY 1
+#define OP_MATMULT 2
+// Acknowledged without work: the start-up handshake
+#define OP_NOP 3
+
+typedef struct
+{
+	int op;
+	int sizeZ;
+	int sizeY;
+	int sizeX;
+	float a;
+	uint offA;
+	uint offB;
+	uint offC;
+} Request;
+
+// control[0]: sequence number of the last posted request, control[1]: of the last finished one
+__kernel void operation(__global atomic_int * control, __global Request * request, __global int * arena)
+{
+	__local int posted;
+	int lid = get_local_id(0);
+	int groupSize = get_local_size(0);
+	int last = 0;
+	for (;;)
+	{
+		if (lid == 0)
+		{
+			int next;
+			while ((next = atomic_load_explicit(&control[0], memory_order_acquire, memory_scope_all_svm_devices)) == last)
+				;
+			posted = next;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+		atomic_work_item_fence(CLK_GLOBAL_MEM_FENCE, memory_order_acquire, memory_scope_all_svm_devices);
+		last = posted;
+		int op = request->op;
+		if (op == OP_STOP)
+			return;
+		if (op == OP_SAXPY)
+		{
+			const __global float * x = (const __global float *)(arena + request->offA);
+			__global float * y = (__global float *)(arena + request->offB);
+			float a = request->a;
+			for (int i = lid; i < request->sizeX; i += groupSize)
+				y[i] = y[i] + a * x[i];
+		}
+		else if (op == OP_MATMULT)
+		{
+			const __global int * matrA = arena + request->offA;
+			const __global int * matrB = arena + request->offB;
+			__global int * resMatr = arena + request->offC;
+			int Y = request->sizeY;
+			int X = request->sizeX;
+			for (int i = lid; i < request->sizeZ * X; i += groupSize)
+			{
+				int z = i / X;
+				int x = i % X;
+				int sum = 0;
+				for (int y = 0; y < Y; ++y)
+					sum += matrA[z * Y + y] * matrB[y * X + x];
+				resMatr[i] = sum;
+			}
+		}
+		atomic_work_item_fence(CLK_GLOBAL_MEM_FENCE, memory_order_release, memory_scope_all_svm_devices);
+		barrier(CLK_GLOBAL_MEM_FENCE);
+		if (lid == 0)
+			atomic_store_explicit(&control[1], last, memory_order_release, memory_scope_all_svm_devices);
+	}
+}
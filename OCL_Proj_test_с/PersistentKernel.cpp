@@ -0,0 +1,274 @@
+#include "PersistentKernel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "AxpyGPU.h"
+#include "DeviceSelector.h"
+#include "DevWorker.h"
+#include "MatMult.h"
+#include "Verify.h"
+#include "KernelLibrary.h"
+
+namespace my
+{
+namespace
+{
+	enum PersistentOp : cl_int { OP_STOP = 0, OP_SAXPY = 1, OP_MATMULT = 2, OP_NOP = 3 };
+
+	static_assert(sizeof(std::atomic<cl_int>) == sizeof(cl_int) && std::atomic<cl_int>::is_always_lock_free,
+		"the mailbox is shared with OpenCL atomic_int");
+
+	// -cl-std for the device's OpenCL C if it is 2.0 or later, empty otherwise
+	std::string persistentBuildOptions(cl_device_id device)
+	{
+		char version[NAME_LENGTH]{};
+		int major{}, minor{};
+		if (clGetDeviceInfo(device, CL_DEVICE_OPENCL_C_VERSION, sizeof(version) - 1, version, NULL) != CL_SUCCESS ||
+			std::sscanf(version, "OpenCL C %d.%d", &major, &minor) != 2 || major < 2)
+		{
+			return {};
+		}
+		return "-cl-std=CL" + std::to_string(major) + ".0";
+	}
+
+	bool supportsFineGrainAtomics(cl_device_id device)
+	{
+		cl_device_svm_capabilities caps{};
+		if (clGetDeviceInfo(device, CL_DEVICE_SVM_CAPABILITIES, sizeof(caps), &caps, NULL) != CL_SUCCESS)
+		{
+			return false;
+		}
+		return (caps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) && (caps & CL_DEVICE_SVM_ATOMICS);
+	}
+}
+
+PersistentExecutor::PersistentExecutor(const char* _deviceName, const PersistentConfig& config)
+	: m_device(_deviceName), m_config(config)
+{
+	if (!start())
+	{
+		std::cout << "Persistent kernel unavailable, using ordinary launches\n";
+	}
+}
+
+PersistentExecutor::~PersistentExecutor()
+{
+	stop();
+}
+
+bool PersistentExecutor::start()
+{
+	const DeviceInfo* deviceInfo = DeviceSelector::instance().findByName(m_device.c_str());
+	if (!deviceInfo)
+	{
+		return false;
+	}
+	const std::string options = persistentBuildOptions(deviceInfo->device);
+	if (options.empty() || !supportsFineGrainAtomics(deviceInfo->device))
+	{
+		return false;
+	}
+
+	DevWorker worker;
+	m_task = worker.createGpuTask(m_device.c_str(), kernels::persistent.source, options.c_str());
+	if (m_task.isTaskFailed())
+	{
+		return false;
+	}
+
+	const size_t bytes = 2 * sizeof(cl_int) + sizeof(Request) + sizeof(cl_int) * m_config.arenaElements;
+	m_svm = clSVMAlloc(m_task.getContext(), CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER | CL_MEM_SVM_ATOMICS, bytes, 0);
+	if (!m_svm)
+	{
+		std::cout << "SVM allocation failed\n";
+		return false;
+	}
+	char* base = static_cast<char*>(m_svm);
+	m_control = reinterpret_cast<std::atomic<cl_int>*>(base);
+	new (&m_control[0]) std::atomic<cl_int>(0);
+	new (&m_control[1]) std::atomic<cl_int>(0);
+	m_request = new (base + 2 * sizeof(cl_int)) Request{};
+	m_arena = reinterpret_cast<cl_int*>(base + 2 * sizeof(cl_int) + sizeof(Request));
+
+	size_t groupSize = m_config.groupSize;
+	size_t kernelLimit{};
+	if (clGetKernelWorkGroupInfo(m_task.getKernel(), m_task.getDevice(), CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelLimit), &kernelLimit, NULL) == CL_SUCCESS &&
+		kernelLimit)
+	{
+		groupSize = std::min(groupSize, kernelLimit);
+	}
+	cl_kernel kernel = m_task.getKernel();
+	int res = clSetKernelArgSVMPointer(kernel, 0, m_control);
+	if (res == CL_SUCCESS)
+	{
+		res = clSetKernelArgSVMPointer(kernel, 1, m_request);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = clSetKernelArgSVMPointer(kernel, 2, m_arena);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = clEnqueueNDRangeKernel(m_task.getQueue(), kernel, 1, NULL, &groupSize, &groupSize, 0, NULL, NULL);
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "With enqueue task proc problems\n";
+		std::cout << res << std::endl;
+		clSVMFree(m_task.getContext(), m_svm);
+		m_svm = nullptr;
+		return false;
+	}
+	clFlush(m_task.getQueue());
+
+	// The kernel is queued either way, so from here on stop() has to retire it
+	m_running = true;
+	m_request->op = OP_NOP;
+	if (!post(m_config.startTimeout))
+	{
+		std::cout << "Persistent kernel did not start in time\n";
+		abandon();
+		return false;
+	}
+	return true;
+}
+
+bool PersistentExecutor::post(double timeout)
+{
+	const cl_int sequence = ++m_sequence;
+	m_control[0].store(sequence, std::memory_order_release);
+	const double start = omp_get_wtime();
+	for (size_t spins = 0; m_control[1].load(std::memory_order_acquire) != sequence; ++spins)
+	{
+		if (spins < m_config.spinCount)
+		{
+			continue;
+		}
+		std::this_thread::yield();
+		if (omp_get_wtime() - start > timeout)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void PersistentExecutor::abandon()
+{
+	m_running = false;
+	m_abandoned = true;
+	// Ends a kernel that is merely late once it gets back to the mailbox
+	m_request->op = OP_STOP;
+	m_control[0].store(++m_sequence, std::memory_order_release);
+}
+
+void PersistentExecutor::stop()
+{
+	if (!m_svm)
+	{
+		return;
+	}
+	if (m_abandoned)
+	{
+		// Queued behind the kernel, so the memory outlives it however it ends
+		if (clEnqueueSVMFree(m_task.getQueue(), 1, &m_svm, NULL, NULL, 0, NULL, NULL) == CL_SUCCESS)
+		{
+			clFlush(m_task.getQueue());
+		}
+	}
+	else
+	{
+		if (m_running)
+		{
+			// A kernel that has not started yet sees the stop as soon as it does
+			m_request->op = OP_STOP;
+			m_control[0].store(++m_sequence, std::memory_order_release);
+			clFinish(m_task.getQueue());
+			m_running = false;
+		}
+		clSVMFree(m_task.getContext(), m_svm);
+	}
+	m_svm = nullptr;
+}
+
+int PersistentExecutor::saxpy(size_t size, cl_float a, const std::vector<cl_float>& x, cl_long incx, std::vector<cl_float>& y, cl_long incy)
+{
+	if (size <= 0 || incx <= 0 || incy <= 0)
+	{
+		return EXIT_FAILURE;
+	}
+	const int64_t count = axpyCount(size, x.size(), incx, y.size(), incy);
+	if (!m_running || static_cast<size_t>(2 * count) > m_config.arenaElements)
+	{
+		// saxpy_gpu only reads x
+		return saxpy_gpu(size, a, const_cast<std::vector<cl_float>&>(x), incx, y, incy, m_device.c_str());
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_running)
+	{
+		lock.unlock();
+		return saxpy_gpu(size, a, const_cast<std::vector<cl_float>&>(x), incx, y, incy, m_device.c_str());
+	}
+	cl_float* xArena = reinterpret_cast<cl_float*>(m_arena);
+	cl_float* yArena = xArena + count;
+	for (int64_t index = 0; index < count; ++index)
+	{
+		xArena[index] = x[index * incx];
+		yArena[index] = y[index * incy];
+	}
+	*m_request = { OP_SAXPY, 0, 0, static_cast<cl_int>(count), a, 0, static_cast<cl_uint>(count), 0 };
+	if (!post(m_config.requestTimeout))
+	{
+		// y is still untouched, so the request can simply run again elsewhere
+		std::cout << "Persistent kernel stopped answering, using ordinary launches\n";
+		abandon();
+		lock.unlock();
+		return saxpy_gpu(size, a, const_cast<std::vector<cl_float>&>(x), incx, y, incy, m_device.c_str());
+	}
+	for (int64_t index = 0; index < count; ++index)
+	{
+		y[index * incy] = yArena[index];
+	}
+	return EXIT_SUCCESS;
+}
+
+std::vector<cl_int> PersistentExecutor::matMult(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB,
+	cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	const size_t matrASize = static_cast<size_t>(sizeZ) * sizeY;
+	const size_t matrBSize = static_cast<size_t>(sizeY) * sizeX;
+	const size_t resMatrSize = static_cast<size_t>(sizeZ) * sizeX;
+	if (sizeZ <= 0 || sizeY <= 0 || sizeX <= 0 || matrA.size() < matrASize || matrB.size() < matrBSize)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return {};
+	}
+	if (!m_running || matrASize + matrBSize + resMatrSize > m_config.arenaElements)
+	{
+		return matMultGpu(matrA, matrB, sizeZ, sizeY, sizeX, m_device.c_str());
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_running)
+	{
+		lock.unlock();
+		return matMultGpu(matrA, matrB, sizeZ, sizeY, sizeX, m_device.c_str());
+	}
+	std::memcpy(m_arena, matrA.data(), sizeof(cl_int) * matrASize);
+	std::memcpy(m_arena + matrASize, matrB.data(), sizeof(cl_int) * matrBSize);
+	*m_request = { OP_MATMULT, sizeZ, sizeY, sizeX, 0.0f, 0, static_cast<cl_uint>(matrASize), static_cast<cl_uint>(matrASize + matrBSize) };
+	if (!post(m_config.requestTimeout))
+	{
+		std::cout << "Persistent kernel stopped answering, using ordinary launches\n";
+		abandon();
+		lock.unlock();
+		return matMultGpu(matrA, matrB, sizeZ, sizeY, sizeX, m_device.c_str());
+	}
+	const cl_int* resArena = m_arena + matrASize + matrBSize;
+	return std::vector<cl_int>(resArena, resArena + resMatrSize);
+}
+}
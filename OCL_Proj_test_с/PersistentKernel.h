@@ -0,0 +1,90 @@
+#pragma once
+#include <CL/cl.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "GpuTask.h"
+
+namespace my
+{
+	struct PersistentConfig
+	{
+		// Room for the operands of one request, in 4-byte elements; larger requests take
+		// the ordinary launch path
+		size_t arenaElements{ 1 << 18 };
+		// Work-items of the resident work-group, capped by the device
+		size_t groupSize{ 256 };
+		// Busy-wait iterations before a waiting caller starts yielding its thread
+		size_t spinCount{ 1 << 14 };
+		// How long the resident kernel may take to answer its first request, and any later
+		// one, before the executor gives up on it for good and falls back; a request that
+		// fits the arena finishes in well under a millisecond on a healthy device
+		double startTimeout{ 1.0 };
+		double requestTimeout{ 1.0 };
+	};
+
+	// Runs tiny requests on one work-group that stays resident on the device and polls
+	// a mailbox in fine-grain SVM with atomics: a request costs a copy of its operands
+	// and two atomic handoffs instead of a launch, an NDRange setup and an event wait.
+	// Needs OpenCL C 2.0 or later and CL_DEVICE_SVM_FINE_GRAIN_BUFFER with
+	// CL_DEVICE_SVM_ATOMICS, as CPU runtimes commonly offer; elsewhere, and for
+	// requests that do not fit the arena, calls go through saxpy_gpu and matMultGpu.
+	// The resident kernel holds its compute unit for the executor's lifetime, so keep it
+	// off GPUs driving a display, whose watchdog would reset it. Requests are served one
+	// at a time; concurrent callers are serialised.
+	class PersistentExecutor
+	{
+	public:
+		explicit PersistentExecutor(const char* _deviceName, const PersistentConfig& config = PersistentConfig());
+		~PersistentExecutor();
+
+		PersistentExecutor(const PersistentExecutor&) = delete;
+		PersistentExecutor& operator=(const PersistentExecutor&) = delete;
+
+		bool isPersistent() const
+		{
+			return m_running.load(std::memory_order_relaxed);
+		}
+
+		// Same semantics as saxpy_gpu; returns EXIT_SUCCESS or EXIT_FAILURE
+		int saxpy(size_t size, cl_float a, const std::vector<cl_float>& x, cl_long incx, std::vector<cl_float>& y, cl_long incy);
+		// Same semantics as matMultGpu; empty on failure
+		std::vector<cl_int> matMult(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+
+	private:
+		// Mirrors Request in the kernel source
+		struct Request
+		{
+			cl_int op;
+			cl_int sizeZ;
+			cl_int sizeY;
+			cl_int sizeX;
+			cl_float a;
+			cl_uint offA;
+			cl_uint offB;
+			cl_uint offC;
+		};
+
+		bool start();
+		// Publishes m_request and waits for the kernel to finish it; false on timeout
+		bool post(double timeout);
+		// After a timeout: the kernel may be dead, reset or just late, so it is told to stop
+		// but never waited for, and the SVM is freed behind it on its queue
+		void abandon();
+		void stop();
+
+		std::string m_device;
+		PersistentConfig m_config;
+		GpuTask m_task;
+		void* m_svm{};
+		std::atomic<cl_int>* m_control{};
+		Request* m_request{};
+		cl_int* m_arena{};
+		cl_int m_sequence{};
+		std::atomic<bool> m_running{ false };
+		bool m_abandoned{ false };
+		std::mutex m_mutex;
+	};
+}
@@ -0,0 +1,481 @@
+#include "QuantMatMult.h"
+#include "DevWorker.h"
+#include "CpuFeatures.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace
+{
+	// Rows of packed operands are padded with zeros to a multiple of one 512-bit register
+	const int64_t PACK_BYTES = 64;
+	// Output columns computed together so every load of A is reused
+	const int64_t COLS_BLOCK = 4;
+
+	inline int64_t roundUp(int64_t value, int64_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	template <typename TYPE>
+	QuantMatr<TYPE> quantizeAffine(const std::vector<cl_float>& matr, cl_int rows, cl_int cols, bool perRow, bool symmetric)
+	{
+		const cl_int qMin = std::numeric_limits<TYPE>::min();
+		const cl_int qMax = std::numeric_limits<TYPE>::max();
+
+		QuantMatr<TYPE> quant;
+		quant.rows = rows;
+		quant.cols = cols;
+		quant.values.resize(static_cast<size_t>(rows) * cols);
+
+		const int64_t lines = perRow ? rows : cols;
+		const int64_t length = perRow ? cols : rows;
+		const int64_t lineStride = perRow ? cols : 1;
+		const int64_t elemStride = perRow ? 1 : cols;
+		quant.scales.resize(lines);
+		quant.zeroPoints.resize(lines);
+
+		for (int64_t line = 0; line < lines; ++line)
+		{
+			cl_float minValue = 0.f;
+			cl_float maxValue = 0.f;
+			for (int64_t i = 0; i < length; ++i)
+			{
+				const cl_float value = matr[line * lineStride + i * elemStride];
+				minValue = std::min(minValue, value);
+				maxValue = std::max(maxValue, value);
+			}
+
+			cl_float scale{};
+			cl_int zeroPoint{};
+			if (symmetric)
+			{
+				scale = std::max(std::abs(minValue), std::abs(maxValue)) / qMax;
+			}
+			else
+			{
+				scale = (maxValue - minValue) / (qMax - qMin);
+			}
+			if (scale == 0.f)
+			{
+				scale = 1.f;
+			}
+			if (!symmetric)
+			{
+				zeroPoint = static_cast<cl_int>(std::lround(qMin - minValue / scale));
+				zeroPoint = std::min(qMax, std::max(qMin, zeroPoint));
+			}
+
+			for (int64_t i = 0; i < length; ++i)
+			{
+				const int64_t idx = line * lineStride + i * elemStride;
+				cl_int q = static_cast<cl_int>(std::lround(matr[idx] / scale)) + zeroPoint;
+				quant.values[idx] = static_cast<TYPE>(std::min(qMax, std::max(qMin, q)));
+			}
+			quant.scales[line] = scale;
+			quant.zeroPoints[line] = zeroPoint;
+		}
+		return quant;
+	}
+
+	template <typename TYPE_A, typename TYPE_B>
+	bool isValidPair(const QuantMatr<TYPE_A>& matrA, const QuantMatr<TYPE_B>& matrB)
+	{
+		return matrA.rows > 0 && matrA.cols > 0 && matrB.cols > 0 && matrA.cols == matrB.rows &&
+			matrA.values.size() == static_cast<size_t>(matrA.rows) * matrA.cols &&
+			matrB.values.size() == static_cast<size_t>(matrB.rows) * matrB.cols &&
+			matrA.zeroPoints.size() == static_cast<size_t>(matrA.rows) &&
+			matrB.zeroPoints.size() == static_cast<size_t>(matrB.cols);
+	}
+
+	// Copies A row by row and B column by column, so both are contiguous along y
+	template <typename TYPE_A, typename TYPE_B>
+	void packOperands(const QuantMatr<TYPE_A>& matrA, const QuantMatr<TYPE_B>& matrB, int64_t ldK,
+		std::vector<TYPE_A>& packedA, std::vector<TYPE_B>& packedBT, std::vector<cl_int>& rowSumA, std::vector<cl_int>& colSumB)
+	{
+		const int64_t sizeZ = matrA.rows;
+		const int64_t sizeY = matrA.cols;
+		const int64_t sizeX = matrB.cols;
+
+		packedA.assign(sizeZ * ldK, 0);
+		packedBT.assign(sizeX * ldK, 0);
+		rowSumA.assign(sizeZ, 0);
+		colSumB.assign(sizeX, 0);
+		for (int64_t z = 0; z < sizeZ; ++z)
+		{
+			for (int64_t y = 0; y < sizeY; ++y)
+			{
+				packedA[z * ldK + y] = matrA.values[z * sizeY + y];
+				rowSumA[z] += matrA.values[z * sizeY + y];
+			}
+		}
+		for (int64_t y = 0; y < sizeY; ++y)
+		{
+			for (int64_t x = 0; x < sizeX; ++x)
+			{
+				packedBT[x * ldK + y] = matrB.values[y * sizeX + x];
+				colSumB[x] += matrB.values[y * sizeX + x];
+			}
+		}
+	}
+
+	// Removes both zero points from the raw sum; evaluated in 64 bits and wrapped like the accumulator
+	inline cl_int correctZeroPoints(cl_int raw, int64_t sizeY, cl_int zeroA, cl_int zeroB, cl_int rowSumA, cl_int colSumB)
+	{
+		const int64_t correction = static_cast<int64_t>(zeroB) * rowSumA + static_cast<int64_t>(zeroA) * colSumB -
+			sizeY * zeroA * static_cast<int64_t>(zeroB);
+		return static_cast<cl_int>(static_cast<uint32_t>(raw) - static_cast<uint32_t>(correction));
+	}
+
+	// len is a multiple of PACK_BYTES
+	void dotBlockScalar(const cl_uchar* rowA, const cl_char* const* colsB, int64_t len, cl_int* out)
+	{
+		for (int c = 0; c < COLS_BLOCK; ++c)
+		{
+			cl_int sum = 0;
+			for (int64_t k = 0; k < len; ++k)
+			{
+				sum += static_cast<cl_int>(rowA[k]) * colsB[c][k];
+			}
+			out[c] = sum;
+		}
+	}
+
+	void dotBlockScalar(const cl_short* rowA, const cl_short* const* colsB, int64_t len, cl_int* out)
+	{
+		for (int c = 0; c < COLS_BLOCK; ++c)
+		{
+			cl_int sum = 0;
+			for (int64_t k = 0; k < len; ++k)
+			{
+				sum += static_cast<cl_int>(rowA[k]) * colsB[c][k];
+			}
+			out[c] = sum;
+		}
+	}
+
+#ifdef MY_X86
+	MY_TARGET("avx2") inline cl_int horizontalSum(__m256i value)
+	{
+		__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+		return _mm_cvtsi128_si32(sum);
+	}
+
+#if defined(__GNUC__) && !defined(__clang__)
+	// GCC 12's AVX-512 headers self-initialise their undefined registers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+	MY_TARGET("avx512f,avx512bw,avx512vnni") void dotBlockVnni512(const cl_uchar* rowA, const cl_char* const* colsB, int64_t len, cl_int* out)
+	{
+		__m512i acc[COLS_BLOCK];
+		for (int c = 0; c < COLS_BLOCK; ++c) acc[c] = _mm512_setzero_si512();
+		for (int64_t k = 0; k < len; k += 64)
+		{
+			const __m512i a = _mm512_loadu_si512(rowA + k);
+			for (int c = 0; c < COLS_BLOCK; ++c)
+			{
+				acc[c] = _mm512_dpbusd_epi32(acc[c], a, _mm512_loadu_si512(colsB[c] + k));
+			}
+		}
+		for (int c = 0; c < COLS_BLOCK; ++c) out[c] = _mm512_reduce_add_epi32(acc[c]);
+	}
+
+	MY_TARGET("avx512f,avx512bw") void dotBlockAvx512(const cl_short* rowA, const cl_short* const* colsB, int64_t len, cl_int* out)
+	{
+		__m512i acc[COLS_BLOCK];
+		for (int c = 0; c < COLS_BLOCK; ++c) acc[c] = _mm512_setzero_si512();
+		for (int64_t k = 0; k < len; k += 32)
+		{
+			const __m512i a = _mm512_loadu_si512(rowA + k);
+			for (int c = 0; c < COLS_BLOCK; ++c)
+			{
+				acc[c] = _mm512_add_epi32(acc[c], _mm512_madd_epi16(a, _mm512_loadu_si512(colsB[c] + k)));
+			}
+		}
+		for (int c = 0; c < COLS_BLOCK; ++c) out[c] = _mm512_reduce_add_epi32(acc[c]);
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+	MY_TARGET("avx2,avxvnni") void dotBlockVnni256(const cl_uchar* rowA, const cl_char* const* colsB, int64_t len, cl_int* out)
+	{
+		__m256i acc[COLS_BLOCK];
+		for (int c = 0; c < COLS_BLOCK; ++c) acc[c] = _mm256_setzero_si256();
+		for (int64_t k = 0; k < len; k += 32)
+		{
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rowA + k));
+			for (int c = 0; c < COLS_BLOCK; ++c)
+			{
+				acc[c] = _mm256_dpbusd_avx_epi32(acc[c], a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colsB[c] + k)));
+			}
+		}
+		for (int c = 0; c < COLS_BLOCK; ++c) out[c] = horizontalSum(acc[c]);
+	}
+
+	MY_TARGET("avx2") void dotBlockAvx2(const cl_uchar* rowA, const cl_char* const* colsB, int64_t len, cl_int* out)
+	{
+		// maddubs would saturate u8 * s8 pair sums at 16 bits, so both sides are widened and multiplied exactly
+		__m256i acc[COLS_BLOCK];
+		for (int c = 0; c < COLS_BLOCK; ++c) acc[c] = _mm256_setzero_si256();
+		for (int64_t k = 0; k < len; k += 16)
+		{
+			const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rowA + k)));
+			for (int c = 0; c < COLS_BLOCK; ++c)
+			{
+				const __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(colsB[c] + k)));
+				acc[c] = _mm256_add_epi32(acc[c], _mm256_madd_epi16(a, b));
+			}
+		}
+		for (int c = 0; c < COLS_BLOCK; ++c) out[c] = horizontalSum(acc[c]);
+	}
+
+	MY_TARGET("avx2") void dotBlockAvx2(const cl_short* rowA, const cl_short* const* colsB, int64_t len, cl_int* out)
+	{
+		__m256i acc[COLS_BLOCK];
+		for (int c = 0; c < COLS_BLOCK; ++c) acc[c] = _mm256_setzero_si256();
+		for (int64_t k = 0; k < len; k += 16)
+		{
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rowA + k));
+			for (int c = 0; c < COLS_BLOCK; ++c)
+			{
+				const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colsB[c] + k));
+				acc[c] = _mm256_add_epi32(acc[c], _mm256_madd_epi16(a, b));
+			}
+		}
+		for (int c = 0; c < COLS_BLOCK; ++c) out[c] = horizontalSum(acc[c]);
+	}
+#endif
+
+	// Widest dot product the processor runs, chosen once per multiplication
+	using DotBlockU8 = void (*)(const cl_uchar*, const cl_char* const*, int64_t, cl_int*);
+	using DotBlockS16 = void (*)(const cl_short*, const cl_short* const*, int64_t, cl_int*);
+
+	DotBlockU8 selectDotBlock(const cl_uchar*, const cl_char*)
+	{
+#ifdef MY_X86
+		const my::CpuFeatures& features = my::cpuFeatures();
+		if (features.avx512vnni)
+		{
+			return dotBlockVnni512;
+		}
+		if (features.avxvnni)
+		{
+			return dotBlockVnni256;
+		}
+		if (features.avx2)
+		{
+			return dotBlockAvx2;
+		}
+#endif
+		return dotBlockScalar;
+	}
+
+	DotBlockS16 selectDotBlock(const cl_short*, const cl_short*)
+	{
+#ifdef MY_X86
+		const my::CpuFeatures& features = my::cpuFeatures();
+		if (features.avx512bw)
+		{
+			return dotBlockAvx512;
+		}
+		if (features.avx2)
+		{
+			return dotBlockAvx2;
+		}
+#endif
+		return dotBlockScalar;
+	}
+
+	template <typename TYPE_A, typename TYPE_B>
+	std::vector<cl_int> matMultQuantPacked(const QuantMatr<TYPE_A>& matrA, const QuantMatr<TYPE_B>& matrB)
+	{
+		if (!isValidPair(matrA, matrB))
+		{
+			std::cout << "Invalid quantized matrix sizes\n";
+			return {};
+		}
+		const int64_t sizeZ = matrA.rows;
+		const int64_t sizeY = matrA.cols;
+		const int64_t sizeX = matrB.cols;
+		const int64_t ldK = roundUp(sizeY, PACK_BYTES / sizeof(TYPE_A));
+
+		std::vector<TYPE_A> packedA;
+		std::vector<TYPE_B> packedBT;
+		std::vector<cl_int> rowSumA;
+		std::vector<cl_int> colSumB;
+		packOperands(matrA, matrB, ldK, packedA, packedBT, rowSumA, colSumB);
+
+		const auto dotBlock = selectDotBlock(packedA.data(), packedBT.data());
+		std::vector<cl_int> resMatr(sizeZ * sizeX);
+#pragma omp parallel for schedule(static)
+		for (int64_t z = 0; z < sizeZ; ++z)
+		{
+			const TYPE_A* rowA = packedA.data() + z * ldK;
+			for (int64_t x = 0; x < sizeX; x += COLS_BLOCK)
+			{
+				// The last block repeats its final column instead of reading past B
+				const TYPE_B* colsB[COLS_BLOCK];
+				for (int64_t c = 0; c < COLS_BLOCK; ++c)
+				{
+					colsB[c] = packedBT.data() + std::min(x + c, sizeX - 1) * ldK;
+				}
+				cl_int raw[COLS_BLOCK];
+				dotBlock(rowA, colsB, ldK, raw);
+				for (int64_t c = 0; c < COLS_BLOCK && x + c < sizeX; ++c)
+				{
+					resMatr[z * sizeX + x + c] = correctZeroPoints(raw[c], sizeY, matrA.zeroPoints[z], matrB.zeroPoints[x + c],
+						rowSumA[z], colSumB[x + c]);
+				}
+			}
+		}
+		return resMatr;
+	}
+}
+
+QuantMatr<cl_uchar> quantizeRowsU8(const std::vector<cl_float>& matr, cl_int rows, cl_int cols)
+{
+	return quantizeAffine<cl_uchar>(matr, rows, cols, true, false);
+}
+
+QuantMatr<cl_char> quantizeColsS8(const std::vector<cl_float>& matr, cl_int rows, cl_int cols)
+{
+	return quantizeAffine<cl_char>(matr, rows, cols, false, false);
+}
+
+QuantMatr<cl_short> quantizeRowsS16(const std::vector<cl_float>& matr, cl_int rows, cl_int cols)
+{
+	return quantizeAffine<cl_short>(matr, rows, cols, true, true);
+}
+
+QuantMatr<cl_short> quantizeColsS16(const std::vector<cl_float>& matr, cl_int rows, cl_int cols)
+{
+	return quantizeAffine<cl_short>(matr, rows, cols, false, true);
+}
+
+std::vector<cl_int> matMultQuantCpu(const QuantMatr<cl_uchar>& matrA, const QuantMatr<cl_char>& matrB)
+{
+	return matMultQuantPacked(matrA, matrB);
+}
+
+std::vector<cl_int> matMultQuantCpu(const QuantMatr<cl_short>& matrA, const QuantMatr<cl_short>& matrB)
+{
+	return matMultQuantPacked(matrA, matrB);
+}
+
+std::vector<cl_int> matMultQuantGpu(const QuantMatr<cl_uchar>& matrA, const QuantMatr<cl_char>& matrB, const char* device)
+{
+	if (!isValidPair(matrA, matrB))
+	{
+		std::cout << "Invalid quantized matrix sizes\n";
+		return {};
+	}
+	const cl_uint sizeZ = matrA.rows;
+	const cl_uint sizeY = matrA.cols;
+	const cl_uint sizeX = matrB.cols;
+	const cl_uint ldK = static_cast<cl_uint>(roundUp(sizeY, 4));
+	const cl_uint k4 = ldK / 4;
+
+	std::vector<cl_uchar> packedA;
+	std::vector<cl_char> packedBT;
+	std::vector<cl_int> rowSumA;
+	std::vector<cl_int> colSumB;
+	packOperands(matrA, matrB, ldK, packedA, packedBT, rowSumA, colSumB);
+
+	my::DevWorker worker = my::DevWorker();
+	const bool integerDot = worker.hasExtension(device, "cl_khr_integer_dot_product");
+	my::GpuTask task = worker.createGpuTask(device, my::kernels::matMultQuant.source, integerDot ? "-D USE_INTEGER_DOT" : "");
+	if (task.isTaskFailed())
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return {};
+	}
+
+	int res = CL_SUCCESS;
+	std::vector<cl_mem> buffers;
+	auto release = [&buffers]()
+	{
+		for (auto buff : buffers)
+		{
+			clReleaseMemObject(buff);
+		}
+	};
+	auto upload = [&](const void* data, size_t bytes)
+	{
+		cl_mem buff = task.addBuffer<cl_uchar>(bytes, CL_MEM_READ_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			return;
+		}
+		buffers.push_back(buff);
+		res = task.enqueueWriteBuffer<cl_uchar>(bytes, static_cast<const cl_uchar*>(data), buff, CL_FALSE);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in write buffer enqueue\n";
+		}
+	};
+
+	double totalTime = omp_get_wtime();
+	upload(packedA.data(), packedA.size());
+	if (res == CL_SUCCESS) upload(packedBT.data(), packedBT.size());
+	if (res == CL_SUCCESS) upload(rowSumA.data(), sizeof(cl_int) * rowSumA.size());
+	if (res == CL_SUCCESS) upload(colSumB.data(), sizeof(cl_int) * colSumB.size());
+	if (res == CL_SUCCESS) upload(matrA.zeroPoints.data(), sizeof(cl_int) * matrA.zeroPoints.size());
+	if (res == CL_SUCCESS) upload(matrB.zeroPoints.data(), sizeof(cl_int) * matrB.zeroPoints.size());
+	if (res != CL_SUCCESS)
+	{
+		release();
+		return {};
+	}
+
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	cl_mem resMatrBuff = task.addBuffer<cl_int>(resMatr.size(), CL_MEM_WRITE_ONLY, res);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in buffer creation process\n";
+		release();
+		return {};
+	}
+	buffers.push_back(resMatrBuff);
+
+	res = task.passParams(buffers[0], buffers[1], buffers[2], buffers[3], buffers[4], buffers[5], resMatrBuff,
+		sizeZ, sizeY, sizeX, k4);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in params passing process\n";
+		std::cout << res << std::endl;
+		release();
+		return {};
+	}
+
+	size_t localSize[]{ 16, 16 };
+	size_t globalSize[]{ (sizeX + 15) / 16 * 16, (sizeZ + 15) / 16 * 16 };
+	double kernelTime{};
+	res = task.enqueueKernel(2, localSize, globalSize, &kernelTime);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "With enqueue task proc problems\n";
+		release();
+		return {};
+	}
+
+	res = task.enqueueReadBuffer<cl_int>(resMatr.size(), resMatr.data(), resMatrBuff);
+	release();
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in read buffer enqueue\n";
+		return {};
+	}
+	totalTime = omp_get_wtime() - totalTime;
+	std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+	std::cout << "Total time on GPU: " << totalTime << '\n';
+	return resMatr;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <CL/cl.h>
+
+// Affine-quantised matrix: real = scale * (value - zeroPoint).
+// Left operands carry one scale/zero point per row, right operands one per column
+template <typename TYPE>
+struct QuantMatr
+{
+	cl_int rows{};
+	cl_int cols{};
+	std::vector<TYPE> values;
+	std::vector<cl_float> scales;
+	std::vector<cl_int> zeroPoints;
+};
+
+QuantMatr<cl_uchar> quantizeRowsU8(const std::vector<cl_float>& matr, cl_int rows, cl_int cols);
+QuantMatr<cl_char> quantizeColsS8(const std::vector<cl_float>& matr, cl_int rows, cl_int cols);
+QuantMatr<cl_short> quantizeRowsS16(const std::vector<cl_float>& matr, cl_int rows, cl_int cols);
+QuantMatr<cl_short> quantizeColsS16(const std::vector<cl_float>& matr, cl_int rows, cl_int cols);
+
+// int32 accumulators with both zero points already removed: sum((a - zeroA[z]) * (b - zeroB[x]))
+std::vector<cl_int> matMultQuantCpu(const QuantMatr<cl_uchar>& matrA, const QuantMatr<cl_char>& matrB);
+std::vector<cl_int> matMultQuantCpu(const QuantMatr<cl_short>& matrA, const QuantMatr<cl_short>& matrB);
+std::vector<cl_int> matMultQuantGpu(const QuantMatr<cl_uchar>& matrA, const QuantMatr<cl_char>& matrB, const char* device);
+
+template <typename TYPE_A, typename TYPE_B>
+std::vector<cl_float> dequantizeResult(const std::vector<cl_int>& resMatr, const QuantMatr<TYPE_A>& matrA, const QuantMatr<TYPE_B>& matrB)
+{
+	std::vector<cl_float> result(resMatr.size());
+	for (size_t z = 0; z < static_cast<size_t>(matrA.rows); ++z)
+	{
+		for (size_t x = 0; x < static_cast<size_t>(matrB.cols); ++x)
+		{
+			result[z * matrB.cols + x] = resMatr[z * matrB.cols + x] * matrA.scales[z] * matrB.scales[x];
+		}
+	}
+	return result;
+}
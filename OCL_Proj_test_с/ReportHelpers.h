@@ -0,0 +1,48 @@
+#pragma once
+#include <CL/cl.h>
+#include <string>
+
+// Device queries and JSON escaping shared by the device profiles and the benchmark reports
+namespace my
+{
+	// A string device property without its terminating zero, empty if the query fails
+	inline std::string deviceString(cl_device_id device, cl_device_info param)
+	{
+		size_t size{};
+		if (clGetDeviceInfo(device, param, 0, nullptr, &size) != CL_SUCCESS || size == 0)
+		{
+			return {};
+		}
+		std::string value(size, '\0');
+		clGetDeviceInfo(device, param, size, &value[0], nullptr);
+		value.resize(size - 1);
+		return value;
+	}
+
+	// A fixed-size device property, value-initialised if the query fails
+	template <typename TYPE>
+	TYPE deviceValue(cl_device_id device, cl_device_info param)
+	{
+		TYPE value{};
+		clGetDeviceInfo(device, param, sizeof(TYPE), &value, nullptr);
+		return value;
+	}
+
+	// value as a quoted JSON string; control characters are dropped
+	inline std::string jsonString(const std::string& value)
+	{
+		std::string escaped{ "\"" };
+		for (char ch : value)
+		{
+			if (ch == '"' || ch == '\\')
+			{
+				escaped += '\\';
+			}
+			if (static_cast<unsigned char>(ch) >= 0x20)
+			{
+				escaped += ch;
+			}
+		}
+		return escaped + '"';
+	}
+}
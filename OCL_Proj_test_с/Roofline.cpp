@@ -0,0 +1,423 @@
+#include "Roofline.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <omp.h>
+
+#include "GpuTask.h"
+#include "DeviceSelector.h"
+#include "KernelLibrary.h"
+#include "ReportHelpers.h"
+
+namespace my
+{
+namespace
+{
+	const int BENCH_ITERATIONS{ 256 };
+	// Multiply-adds per iteration of the compute kernels, two ops each
+	const int BENCH_CHAINS{ 4 };
+	const int BENCH_REPEATS{ 4 };
+
+	// Average seconds per launch, after one warm-up launch
+	double timeKernel(cl_command_queue queue, cl_kernel kernel, size_t globalSize, const size_t* localSize)
+	{
+		if (clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalSize, localSize, 0, NULL, NULL) != CL_SUCCESS ||
+			clFinish(queue) != CL_SUCCESS)
+		{
+			return 0;
+		}
+		double time = omp_get_wtime();
+		for (int i = 0; i < BENCH_REPEATS; ++i)
+		{
+			clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalSize, localSize, 0, NULL, NULL);
+		}
+		clFinish(queue);
+		return (omp_get_wtime() - time) / BENCH_REPEATS;
+	}
+
+	// Bytes/s of blocking transfers between host and buffer, after one warm-up transfer
+	double transferRate(cl_command_queue queue, cl_mem buffer, void* hostPtr, size_t bytes, bool toDevice)
+	{
+		auto transfer = [&]()
+		{
+			return toDevice ?
+				clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0, bytes, hostPtr, 0, NULL, NULL) :
+				clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0, bytes, hostPtr, 0, NULL, NULL);
+		};
+		if (transfer() != CL_SUCCESS)
+		{
+			return 0;
+		}
+		double time = omp_get_wtime();
+		for (int i = 0; i < BENCH_REPEATS; ++i)
+		{
+			transfer();
+		}
+		time = omp_get_wtime() - time;
+		return time > 0 ? static_cast<double>(bytes) * BENCH_REPEATS / time : 0;
+	}
+
+	double rate(double work, double time)
+	{
+		return time > 0 ? work / time : 0;
+	}
+
+	std::string typeName(cl_device_type type)
+	{
+		if (type & CL_DEVICE_TYPE_GPU)
+		{
+			return "GPU";
+		}
+		if (type & CL_DEVICE_TYPE_CPU)
+		{
+			return "CPU";
+		}
+		if (type & CL_DEVICE_TYPE_ACCELERATOR)
+		{
+			return "ACCELERATOR";
+		}
+		return "OTHER";
+	}
+
+	const std::pair<const char*, double RooflineProfile::*> measuredFields[] = {
+		{ "copyBandwidth", &RooflineProfile::copyBandwidth },
+		{ "triadBandwidth", &RooflineProfile::triadBandwidth },
+		{ "localBandwidth", &RooflineProfile::localBandwidth },
+		{ "int32Rate", &RooflineProfile::int32Rate },
+		{ "fp32Rate", &RooflineProfile::fp32Rate },
+		{ "fp64Rate", &RooflineProfile::fp64Rate },
+		{ "hostToDevicePageable", &RooflineProfile::hostToDevicePageable },
+		{ "deviceToHostPageable", &RooflineProfile::deviceToHostPageable },
+		{ "hostToDevicePinned", &RooflineProfile::hostToDevicePinned },
+		{ "deviceToHostPinned", &RooflineProfile::deviceToHostPinned },
+		{ "launchLatency", &RooflineProfile::launchLatency },
+	};
+}
+
+RooflineProfile measureRoofline(cl_device_id device)
+{
+	RooflineProfile profile;
+	profile.name = deviceString(device, CL_DEVICE_NAME);
+	profile.vendor = deviceString(device, CL_DEVICE_VENDOR);
+	profile.type = typeName(deviceValue<cl_device_type>(device, CL_DEVICE_TYPE));
+	profile.computeUnits = deviceValue<cl_uint>(device, CL_DEVICE_MAX_COMPUTE_UNITS);
+	profile.clockMHz = deviceValue<cl_uint>(device, CL_DEVICE_MAX_CLOCK_FREQUENCY);
+	profile.globalMemSize = deviceValue<cl_ulong>(device, CL_DEVICE_GLOBAL_MEM_SIZE);
+	profile.localMemSize = deviceValue<cl_ulong>(device, CL_DEVICE_LOCAL_MEM_SIZE);
+	const cl_ulong maxAllocSize = deviceValue<cl_ulong>(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE);
+	const size_t maxGroupSize = deviceValue<size_t>(device, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+
+	size_t localSize = 1;
+	while (localSize * 2 <= std::min<size_t>(maxGroupSize, 256))
+	{
+		localSize *= 2;
+	}
+	const std::string options = "-D LOCAL_SIZE=" + std::to_string(localSize);
+	GpuTask task(device, kernels::rooflineBench.source, options.c_str());
+	if (task.isTaskFailed())
+	{
+		std::cout << "Roofline kernels failed to build for " << profile.name << '\n';
+		return profile;
+	}
+	int err = CL_SUCCESS;
+	cl_command_queue queue = task.getQueue();
+
+	// Global memory: 64 MB per buffer, well past the last-level cache of host CPUs
+	const size_t bytes = static_cast<size_t>(std::min<cl_ulong>(cl_ulong(64) << 20, maxAllocSize / 2)) & ~size_t(15);
+	const size_t vectors = bytes / 16;
+	cl_mem bufA = task.addBuffer<cl_uchar>(bytes, CL_MEM_READ_WRITE, err);
+	cl_mem bufB = err == CL_SUCCESS ? task.addBuffer<cl_uchar>(bytes, CL_MEM_READ_WRITE, err) : nullptr;
+	cl_mem bufC = err == CL_SUCCESS ? task.addBuffer<cl_uchar>(bytes, CL_MEM_READ_WRITE, err) : nullptr;
+	if (err == CL_SUCCESS)
+	{
+		std::vector<cl_uchar> pageable(bytes, 1);
+		profile.hostToDevicePageable = transferRate(queue, bufA, pageable.data(), bytes, true);
+		profile.deviceToHostPageable = transferRate(queue, bufA, pageable.data(), bytes, false);
+		transferRate(queue, bufB, pageable.data(), bytes, true);
+
+		if (task.passParams(bufA, bufB) == CL_SUCCESS)
+		{
+			profile.copyBandwidth = rate(2.0 * bytes, timeKernel(queue, task.getKernel(), vectors, nullptr));
+		}
+		cl_kernel triad = task.createKernel("triad", err);
+		if (err == CL_SUCCESS)
+		{
+			cl_float scalar = 3.0f;
+			clSetKernelArg(triad, 0, sizeof(cl_mem), &bufA);
+			clSetKernelArg(triad, 1, sizeof(cl_mem), &bufB);
+			clSetKernelArg(triad, 2, sizeof(cl_mem), &bufC);
+			clSetKernelArg(triad, 3, sizeof(cl_float), &scalar);
+			profile.triadBandwidth = rate(3.0 * bytes, timeKernel(queue, triad, vectors, nullptr));
+			clReleaseKernel(triad);
+		}
+
+		// Pinned staging memory: a host-allocated buffer mapped once and used as the transfer source
+		cl_mem pinned = task.addBuffer<cl_uchar>(bytes, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, err);
+		if (err == CL_SUCCESS)
+		{
+			void* pinnedPtr = clEnqueueMapBuffer(queue, pinned, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes, 0, NULL, NULL, &err);
+			if (err == CL_SUCCESS)
+			{
+				profile.hostToDevicePinned = transferRate(queue, bufC, pinnedPtr, bytes, true);
+				profile.deviceToHostPinned = transferRate(queue, bufC, pinnedPtr, bytes, false);
+				clEnqueueUnmapMemObject(queue, pinned, pinnedPtr, 0, NULL, NULL);
+				clFinish(queue);
+			}
+			clReleaseMemObject(pinned);
+		}
+	}
+	for (cl_mem buffer : { bufA, bufB, bufC })
+	{
+		if (buffer)
+		{
+			clReleaseMemObject(buffer);
+		}
+	}
+
+	// Arithmetic and local memory: enough work-items to fill every compute unit several times
+	const size_t items = std::max<size_t>(size_t(1) << 16, size_t(profile.computeUnits) * 4096) / localSize * localSize;
+	const double computeOps = 2.0 * BENCH_CHAINS * BENCH_ITERATIONS * items;
+	err = CL_SUCCESS;
+	cl_mem out = task.addBuffer<cl_double>(items, CL_MEM_WRITE_ONLY, err);
+	if (err == CL_SUCCESS)
+	{
+		cl_kernel localRead = task.createKernel("localRead", err);
+		if (err == CL_SUCCESS)
+		{
+			clSetKernelArg(localRead, 0, sizeof(cl_mem), &out);
+			const double localBytes = static_cast<double>(sizeof(cl_float)) * BENCH_ITERATIONS * items;
+			profile.localBandwidth = rate(localBytes, timeKernel(queue, localRead, items, &localSize));
+			clReleaseKernel(localRead);
+		}
+		cl_kernel intMad = task.createKernel("intMad", err);
+		if (err == CL_SUCCESS)
+		{
+			cl_int seed = 3;
+			clSetKernelArg(intMad, 0, sizeof(cl_mem), &out);
+			clSetKernelArg(intMad, 1, sizeof(cl_int), &seed);
+			profile.int32Rate = rate(computeOps, timeKernel(queue, intMad, items, nullptr));
+			clReleaseKernel(intMad);
+		}
+		cl_kernel floatMad = task.createKernel("floatMad", err);
+		if (err == CL_SUCCESS)
+		{
+			cl_float seed = 0.999f;
+			clSetKernelArg(floatMad, 0, sizeof(cl_mem), &out);
+			clSetKernelArg(floatMad, 1, sizeof(cl_float), &seed);
+			profile.fp32Rate = rate(computeOps, timeKernel(queue, floatMad, items, nullptr));
+			clReleaseKernel(floatMad);
+		}
+		cl_kernel emptyKernel = task.createKernel("emptyKernel", err);
+		if (err == CL_SUCCESS)
+		{
+			// Latency includes waiting for completion, as every wrapper does
+			clSetKernelArg(emptyKernel, 0, sizeof(cl_mem), &out);
+			const int launches = 32;
+			size_t one = 1;
+			double time = omp_get_wtime();
+			for (int i = 0; i < launches; ++i)
+			{
+				clEnqueueNDRangeKernel(queue, emptyKernel, 1, NULL, &one, NULL, 0, NULL, NULL);
+				clFinish(queue);
+			}
+			profile.launchLatency = (omp_get_wtime() - time) / launches;
+			clReleaseKernel(emptyKernel);
+		}
+		clReleaseMemObject(out);
+	}
+
+	if (deviceValue<cl_device_fp_config>(device, CL_DEVICE_DOUBLE_FP_CONFIG) != 0)
+	{
+		GpuTask doubleTask(device, kernels::rooflineDouble.source);
+		if (!doubleTask.isTaskFailed())
+		{
+			cl_mem doubleOut = doubleTask.addBuffer<cl_double>(items, CL_MEM_WRITE_ONLY, err);
+			if (err == CL_SUCCESS)
+			{
+				if (doubleTask.passParams(doubleOut, cl_double(0.999)) == CL_SUCCESS)
+				{
+					profile.fp64Rate = rate(computeOps, timeKernel(doubleTask.getQueue(), doubleTask.getKernel(), items, nullptr));
+				}
+				clReleaseMemObject(doubleOut);
+			}
+		}
+	}
+	return profile;
+}
+
+void writeRooflineJson(std::ostream& out, const std::vector<RooflineProfile>& profiles)
+{
+	out << "{\n\t\"devices\": [";
+	for (size_t i = 0; i < profiles.size(); ++i)
+	{
+		const auto& profile = profiles[i];
+		out << (i ? ",\n" : "\n") << "\t\t{\n";
+		out << "\t\t\t\"name\": " << jsonString(profile.name) << ",\n";
+		out << "\t\t\t\"vendor\": " << jsonString(profile.vendor) << ",\n";
+		out << "\t\t\t\"type\": " << jsonString(profile.type) << ",\n";
+		out << "\t\t\t\"computeUnits\": " << profile.computeUnits << ",\n";
+		out << "\t\t\t\"clockMHz\": " << profile.clockMHz << ",\n";
+		out << "\t\t\t\"globalMemSize\": " << profile.globalMemSize << ",\n";
+		out << "\t\t\t\"localMemSize\": " << profile.localMemSize;
+		for (const auto& field : measuredFields)
+		{
+			out << ",\n\t\t\t\"" << field.first << "\": " << std::setprecision(6) << profile.*field.second;
+		}
+		out << "\n";
+		out << "\t\t}";
+	}
+	out << "\n\t]\n}\n";
+}
+
+std::vector<RooflineProfile> readRooflineJson(std::istream& in)
+{
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	const std::string text = buffer.str();
+
+	std::vector<RooflineProfile> profiles;
+	size_t pos = text.find("\"devices\"");
+	if (pos == std::string::npos)
+	{
+		return profiles;
+	}
+	auto skipSpaces = [&]()
+	{
+		while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+		{
+			++pos;
+		}
+	};
+	auto readString = [&]()
+	{
+		std::string value;
+		for (++pos; pos < text.size() && text[pos] != '"'; ++pos)
+		{
+			if (text[pos] == '\\' && pos + 1 < text.size())
+			{
+				++pos;
+			}
+			value += text[pos];
+		}
+		++pos;
+		return value;
+	};
+
+	// Flat objects of string and number members inside the devices array
+	while ((pos = text.find('{', pos)) != std::string::npos)
+	{
+		RooflineProfile profile;
+		++pos;
+		for (;;)
+		{
+			skipSpaces();
+			if (pos >= text.size() || text[pos] == '}')
+			{
+				break;
+			}
+			if (text[pos] == ',')
+			{
+				++pos;
+				continue;
+			}
+			if (text[pos] != '"')
+			{
+				return profiles;
+			}
+			const std::string key = readString();
+			skipSpaces();
+			if (pos >= text.size() || text[pos] != ':')
+			{
+				return profiles;
+			}
+			++pos;
+			skipSpaces();
+			std::string stringValue;
+			double number{};
+			if (pos < text.size() && text[pos] == '"')
+			{
+				stringValue = readString();
+			}
+			else
+			{
+				size_t end = pos;
+				while (end < text.size() && text[end] != ',' && text[end] != '}' && !std::isspace(static_cast<unsigned char>(text[end])))
+				{
+					++end;
+				}
+				number = std::atof(text.substr(pos, end - pos).c_str());
+				pos = end;
+			}
+
+			if (key == "name")
+			{
+				profile.name = stringValue;
+			}
+			else if (key == "vendor")
+			{
+				profile.vendor = stringValue;
+			}
+			else if (key == "type")
+			{
+				profile.type = stringValue;
+			}
+			else if (key == "computeUnits")
+			{
+				profile.computeUnits = static_cast<cl_uint>(number);
+			}
+			else if (key == "clockMHz")
+			{
+				profile.clockMHz = static_cast<cl_uint>(number);
+			}
+			else if (key == "globalMemSize")
+			{
+				profile.globalMemSize = static_cast<cl_ulong>(number);
+			}
+			else if (key == "localMemSize")
+			{
+				profile.localMemSize = static_cast<cl_ulong>(number);
+			}
+			else
+			{
+				for (const auto& field : measuredFields)
+				{
+					if (key == field.first)
+					{
+						profile.*field.second = number;
+					}
+				}
+			}
+		}
+		profiles.push_back(std::move(profile));
+	}
+	return profiles;
+}
+
+int runRoofline(const char* outputPath)
+{
+	std::vector<RooflineProfile> profiles;
+	for (const auto& info : DeviceSelector::instance().devices())
+	{
+		std::cerr << "Characterising " << info.name << "...\n";
+		profiles.push_back(measureRoofline(info.device));
+	}
+
+	if (!outputPath)
+	{
+		writeRooflineJson(std::cout, profiles);
+		return EXIT_SUCCESS;
+	}
+	std::ofstream out(outputPath);
+	if (!out)
+	{
+		std::cout << "Cannot open " << outputPath << '\n';
+		return EXIT_FAILURE;
+	}
+	writeRooflineJson(out, profiles);
+	return EXIT_SUCCESS;
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+namespace my
+{
+	// Measured peaks of one device. Rates are in bytes/s or ops/s, latency in
+	// seconds; zero means the measurement was not possible on that device
+	struct RooflineProfile
+	{
+		std::string name;
+		std::string vendor;
+		std::string type;
+		cl_uint computeUnits{};
+		cl_uint clockMHz{};
+		cl_ulong globalMemSize{};
+		cl_ulong localMemSize{};
+
+		double copyBandwidth{};
+		double triadBandwidth{};
+		double localBandwidth{};
+		double int32Rate{};
+		double fp32Rate{};
+		double fp64Rate{};
+		double hostToDevicePageable{};
+		double deviceToHostPageable{};
+		double hostToDevicePinned{};
+		double deviceToHostPinned{};
+		double launchLatency{};
+	};
+
+	// Runs every micro-benchmark on one device, using plain OpenCL C 1.2 only
+	// so that CPU runtimes such as PoCL can execute it as well
+	RooflineProfile measureRoofline(cl_device_id device);
+
+	void writeRooflineJson(std::ostream& out, const std::vector<RooflineProfile>& profiles);
+	// Reads back what writeRooflineJson produced; unknown keys are skipped
+	std::vector<RooflineProfile> readRooflineJson(std::istream& in);
+
+	// Characterises every device and writes the profile to outputPath, or to stdout when it is null
+	int runRoofline(const char* outputPath);
+}
@@ -0,0 +1,52 @@
+// Kernel names other than operation are created from the same program;
+// LOCAL_SIZE is a power of two set at build time
+__kernel void operation(const __global float4 * src,
+	__global float4 * dst)
+{
+	size_t index = get_global_id(0);
+	dst[index] = src[index];
+}
+__kernel void triad(const __global float4 * b,
+	const __global float4 * c, __global float4 * a, float scalar)
+{
+	size_t index = get_global_id(0);
+	a[index] = b[index] + scalar * c[index];
+}
+__kernel void localRead(__global float * out)
+{
+	__local float tile[LOCAL_SIZE];
+	int lid = get_local_id(0);
+	tile[lid] = lid;
+	barrier(CLK_LOCAL_MEM_FENCE);
+	float sum = 0;
+	for (int i = 0; i < 256; ++i)
+	{
+		sum += tile[(lid + i) & (LOCAL_SIZE - 1)];
+	}
+	out[get_global_id(0)] = sum;
+}
+__kernel void intMad(__global int * out, int seed)
+{
+	int index = get_global_id(0);
+	int a = index, b = index + 1, c = index + 2, d = index + 3;
+	for (int i = 0; i < 256; ++i)
+	{
+		a = a * seed + 1; b = b * seed + 3;
+		c = c * seed + 5; d = d * seed + 7;
+	}
+	out[index] = a + b + c + d;
+}
+__kernel void floatMad(__global float * out, float seed)
+{
+	float index = get_global_id(0);
+	float a = index, b = index + 1, c = index + 2, d = index + 3;
+	for (int i = 0; i < 256; ++i)
+	{
+		a = mad(a, seed, 1.0f); b = mad(b, seed, 3.0f);
+		c = mad(c, seed, 5.0f); d = mad(d, seed, 7.0f);
+	}
+	out[get_global_id(0)] = a + b + c + d;
+}
+__kernel void emptyKernel(__global int * out)
+{
+}
@@ -0,0 +1,12 @@
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+__kernel void operation(__global double * out, double seed)
+{
+	double index = get_global_id(0);
+	double a = index, b = index + 1, c = index + 2, d = index + 3;
+	for (int i = 0; i < 256; ++i)
+	{
+		a = mad(a, seed, 1.0); b = mad(b, seed, 3.0);
+		c = mad(c, seed, 5.0); d = mad(d, seed, 7.0);
+	}
+	out[get_global_id(0)] = a + b + c + d;
+}
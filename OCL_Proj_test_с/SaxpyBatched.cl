@@ -0,0 +1,10 @@
+__kernel void operation(const __global long * sizes,
+	const __global long * offsets, const __global float * alphas,
+	const __global float * x, __global float * y)
+{
+	long index = get_global_id(0);
+	int req = get_global_id(1);
+	if (index >= sizes[req]) return;
+	long pos = offsets[req] + index;
+	y[pos] = y[pos] + alphas[req] * x[pos];
+}
@@ -0,0 +1,387 @@
+#include "Sparse.h"
+#include "DevWorker.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <omp.h>
+
+namespace
+{
+	const size_t GROUP_SIZE = 128;
+	// Rows shorter than this on average leave most lanes of a vector idle
+	const cl_int VECTOR_MIN_ROW = 4;
+
+	// Row boundaries that give every part about nnz / parts nonzeros
+	std::vector<cl_int> partitionByNnz(const CsrMatr& matr, int parts)
+	{
+		std::vector<cl_int> bounds(parts + 1, matr.rows);
+		bounds[0] = 0;
+		const int64_t nnz = matr.rowPtr[matr.rows];
+		for (int part = 1; part < parts; ++part)
+		{
+			const int64_t target = nnz * part / parts;
+			cl_int row = static_cast<cl_int>(std::lower_bound(matr.rowPtr.begin(), matr.rowPtr.end(), target) - matr.rowPtr.begin());
+			bounds[part] = std::max(bounds[part - 1], std::min(row, matr.rows));
+		}
+		return bounds;
+	}
+
+	bool isValidCsr(const CsrMatr& matr)
+	{
+		return matr.rows > 0 && matr.cols > 0 &&
+			matr.rowPtr.size() == static_cast<size_t>(matr.rows) + 1 &&
+			matr.colInd.size() == matr.values.size() &&
+			static_cast<size_t>(matr.rowPtr.back()) == matr.values.size();
+	}
+
+	// Uploads the inputs in order, then binds them, the result buffer and the scalars
+	// as consecutive kernel arguments
+	template <typename... Scalars>
+	std::vector<cl_int> runSparseKernel(const char* device, const char* source, const std::string& options,
+		const std::vector<const std::vector<cl_int>*>& inputs, size_t resultSize,
+		cl_uint numDims, size_t* localSize, size_t* globalSize, const Scalars&... scalars)
+	{
+		std::vector<cl_int> result(resultSize);
+		my::DevWorker worker = my::DevWorker();
+		my::GpuTask task = worker.createGpuTask(device, source, options.c_str());
+		if (task.isTaskFailed())
+		{
+			std::cout << "GpuTask creation failed!\n";
+			return {};
+		}
+
+		int res = CL_SUCCESS;
+		std::vector<cl_mem> buffers;
+		auto release = [&buffers]()
+		{
+			for (auto buff : buffers)
+			{
+				clReleaseMemObject(buff);
+			}
+		};
+
+		double totalTime = omp_get_wtime();
+		for (auto input : inputs)
+		{
+			cl_mem buff = task.addBuffer<cl_int>(input->size(), CL_MEM_READ_ONLY, res);
+			if (res != CL_SUCCESS)
+			{
+				std::cout << "Problem in buffer creation process\n";
+				release();
+				return {};
+			}
+			buffers.push_back(buff);
+			res = task.enqueueWriteBuffer<cl_int>(input->size(), input->data(), buff, CL_FALSE);
+			if (res != CL_SUCCESS)
+			{
+				std::cout << res << '\n';
+				std::cout << "Problem in write buffer enqueue\n";
+				release();
+				return {};
+			}
+		}
+		cl_mem resultBuff = task.addBuffer<cl_int>(resultSize, CL_MEM_WRITE_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			release();
+			return {};
+		}
+		buffers.push_back(resultBuff);
+
+		int argIndex = 0;
+		for (auto buff : buffers)
+		{
+			if (res == CL_SUCCESS)
+			{
+				res = task.passParam(argIndex++, buff);
+			}
+		}
+		int expand[] = { 0, (res = (res == CL_SUCCESS ? task.passParam(argIndex++, scalars) : res))... };
+		(void)expand;
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in params passing process\n";
+			std::cout << res << std::endl;
+			release();
+			return {};
+		}
+
+		double kernelTime{};
+		res = task.enqueueKernel(numDims, localSize, globalSize, &kernelTime);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "With enqueue task proc problems\n";
+			release();
+			return {};
+		}
+
+		res = task.enqueueReadBuffer<cl_int>(resultSize, result.data(), resultBuff);
+		release();
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in read buffer enqueue\n";
+			return {};
+		}
+		totalTime = omp_get_wtime() - totalTime;
+		std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+		std::cout << "Total time on GPU: " << totalTime << '\n';
+		return result;
+	}
+}
+
+CsrMatr csrFromDense(const std::vector<cl_int>& matr, cl_int rows, cl_int cols)
+{
+	CsrMatr csr;
+	csr.rows = rows;
+	csr.cols = cols;
+	csr.rowPtr.resize(static_cast<size_t>(rows) + 1, 0);
+	for (int64_t row = 0; row < rows; ++row)
+	{
+		for (int64_t col = 0; col < cols; ++col)
+		{
+			const cl_int value = matr[row * cols + col];
+			if (value != 0)
+			{
+				csr.colInd.push_back(static_cast<cl_int>(col));
+				csr.values.push_back(value);
+			}
+		}
+		csr.rowPtr[row + 1] = static_cast<cl_int>(csr.values.size());
+	}
+	return csr;
+}
+
+EllMatr ellFromCsr(const CsrMatr& matr)
+{
+	EllMatr ell;
+	ell.rows = matr.rows;
+	ell.cols = matr.cols;
+	for (cl_int row = 0; row < matr.rows; ++row)
+	{
+		ell.width = std::max(ell.width, matr.rowPtr[row + 1] - matr.rowPtr[row]);
+	}
+
+	const size_t total = static_cast<size_t>(ell.rows) * ell.width;
+	ell.colInd.assign(total, -1);
+	ell.values.assign(total, 0);
+	for (cl_int row = 0; row < matr.rows; ++row)
+	{
+		for (cl_int j = matr.rowPtr[row]; j < matr.rowPtr[row + 1]; ++j)
+		{
+			const size_t idx = static_cast<size_t>(j - matr.rowPtr[row]) * ell.rows + row;
+			ell.colInd[idx] = matr.colInd[j];
+			ell.values[idx] = matr.values[j];
+		}
+	}
+	return ell;
+}
+
+SellMatr sellFromCsr(const CsrMatr& matr, cl_int sliceHeight, cl_int sigma)
+{
+	SellMatr sell;
+	sell.rows = matr.rows;
+	sell.cols = matr.cols;
+	sell.sliceHeight = std::max(sliceHeight, 1);
+	sell.sigma = std::max(sigma, 1);
+
+	auto rowLength = [&matr](cl_int row) { return matr.rowPtr[row + 1] - matr.rowPtr[row]; };
+
+	// Sorting only inside sigma-sized windows keeps access to x local
+	sell.rowPerm.resize(matr.rows);
+	std::iota(sell.rowPerm.begin(), sell.rowPerm.end(), 0);
+	for (cl_int first = 0; first < matr.rows; first += sell.sigma)
+	{
+		auto begin = sell.rowPerm.begin() + first;
+		auto end = sell.rowPerm.begin() + std::min(matr.rows, first + sell.sigma);
+		std::stable_sort(begin, end, [&rowLength](cl_int a, cl_int b) { return rowLength(a) > rowLength(b); });
+	}
+
+	const cl_int slices = (matr.rows + sell.sliceHeight - 1) / sell.sliceHeight;
+	sell.sliceOffsets.resize(static_cast<size_t>(slices) + 1, 0);
+	sell.sliceWidths.resize(slices, 0);
+	for (cl_int slice = 0; slice < slices; ++slice)
+	{
+		const cl_int first = slice * sell.sliceHeight;
+		const cl_int last = std::min(matr.rows, first + sell.sliceHeight);
+		for (cl_int row = first; row < last; ++row)
+		{
+			sell.sliceWidths[slice] = std::max(sell.sliceWidths[slice], rowLength(sell.rowPerm[row]));
+		}
+		sell.sliceOffsets[slice + 1] = sell.sliceOffsets[slice] + sell.sliceWidths[slice] * sell.sliceHeight;
+	}
+
+	sell.colInd.assign(sell.sliceOffsets.back(), -1);
+	sell.values.assign(sell.sliceOffsets.back(), 0);
+	for (cl_int row = 0; row < matr.rows; ++row)
+	{
+		const cl_int slice = row / sell.sliceHeight;
+		const cl_int base = sell.sliceOffsets[slice] + row % sell.sliceHeight;
+		const cl_int source = sell.rowPerm[row];
+		for (cl_int j = matr.rowPtr[source]; j < matr.rowPtr[source + 1]; ++j)
+		{
+			const cl_int idx = base + (j - matr.rowPtr[source]) * sell.sliceHeight;
+			sell.colInd[idx] = matr.colInd[j];
+			sell.values[idx] = matr.values[j];
+		}
+	}
+	return sell;
+}
+
+std::vector<cl_int> spmvCpu(const CsrMatr& matrA, const std::vector<cl_int>& x)
+{
+	if (!isValidCsr(matrA) || x.size() < static_cast<size_t>(matrA.cols))
+	{
+		std::cout << "Invalid sparse matrix or vector size\n";
+		return {};
+	}
+
+	std::vector<cl_int> y(matrA.rows);
+	const int parts = omp_get_max_threads();
+	const auto bounds = partitionByNnz(matrA, parts);
+#pragma omp parallel for schedule(static, 1) num_threads(parts)
+	for (int part = 0; part < parts; ++part)
+	{
+		for (cl_int row = bounds[part]; row < bounds[part + 1]; ++row)
+		{
+			cl_int sum = 0;
+			for (cl_int j = matrA.rowPtr[row]; j < matrA.rowPtr[row + 1]; ++j)
+			{
+				sum += matrA.values[j] * x[matrA.colInd[j]];
+			}
+			y[row] = sum;
+		}
+	}
+	return y;
+}
+
+std::vector<cl_int> spmmCpu(const CsrMatr& matrA, const std::vector<cl_int>& matrB, cl_int sizeX)
+{
+	if (!isValidCsr(matrA) || sizeX <= 0 || matrB.size() < static_cast<size_t>(matrA.cols) * sizeX)
+	{
+		std::cout << "Invalid sparse matrix or dense operand size\n";
+		return {};
+	}
+
+	std::vector<cl_int> resMatr(static_cast<size_t>(matrA.rows) * sizeX);
+	const int parts = omp_get_max_threads();
+	const auto bounds = partitionByNnz(matrA, parts);
+#pragma omp parallel for schedule(static, 1) num_threads(parts)
+	for (int part = 0; part < parts; ++part)
+	{
+		for (cl_int row = bounds[part]; row < bounds[part + 1]; ++row)
+		{
+			cl_int* resRow = resMatr.data() + static_cast<size_t>(row) * sizeX;
+			for (cl_int j = matrA.rowPtr[row]; j < matrA.rowPtr[row + 1]; ++j)
+			{
+				const cl_int value = matrA.values[j];
+				const cl_int* rowB = matrB.data() + static_cast<size_t>(matrA.colInd[j]) * sizeX;
+				for (cl_int x = 0; x < sizeX; ++x)
+				{
+					resRow[x] += value * rowB[x];
+				}
+			}
+		}
+	}
+	return resMatr;
+}
+
+std::vector<cl_int> spmvGpu(const CsrMatr& matrA, const std::vector<cl_int>& x, const char* device, SpmvKernel kernel)
+{
+	if (!isValidCsr(matrA) || x.size() < static_cast<size_t>(matrA.cols))
+	{
+		std::cout << "Invalid sparse matrix or vector size\n";
+		return {};
+	}
+	if (matrA.nnz() == 0)
+	{
+		return std::vector<cl_int>(matrA.rows, 0);
+	}
+
+	const cl_int avgRow = static_cast<cl_int>(matrA.nnz() / matrA.rows);
+	if (kernel == SpmvKernel::Auto)
+	{
+		kernel = avgRow < VECTOR_MIN_ROW ? SpmvKernel::ScalarPerRow : SpmvKernel::VectorPerRow;
+	}
+
+	const std::vector<const std::vector<cl_int>*> inputs{ &matrA.rowPtr, &matrA.colInd, &matrA.values, &x };
+	const cl_uint rows = matrA.rows;
+	if (kernel == SpmvKernel::ScalarPerRow)
+	{
+		size_t globalSize = (rows + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+		return runSparseKernel(device, my::kernels::spmvCsrScalar.source, "", inputs, rows, 1, NULL, &globalSize, rows);
+	}
+
+	// Smallest power of two covering an average row, capped at a typical SIMD width
+	size_t vectorSize = 2;
+	while (vectorSize < 32 && vectorSize < static_cast<size_t>(avgRow))
+	{
+		vectorSize *= 2;
+	}
+	const std::string options = "-D VECTOR_SIZE=" + std::to_string(vectorSize) +
+		" -D GROUP_SIZE=" + std::to_string(GROUP_SIZE);
+	size_t localSize = GROUP_SIZE;
+	size_t globalSize = (rows * vectorSize + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+	return runSparseKernel(device, my::kernels::spmvCsrVector.source, options, inputs, rows, 1, &localSize, &globalSize, rows);
+}
+
+std::vector<cl_int> spmvGpu(const EllMatr& matrA, const std::vector<cl_int>& x, const char* device)
+{
+	if (matrA.rows <= 0 || x.size() < static_cast<size_t>(matrA.cols))
+	{
+		std::cout << "Invalid sparse matrix or vector size\n";
+		return {};
+	}
+	if (matrA.width == 0)
+	{
+		return std::vector<cl_int>(matrA.rows, 0);
+	}
+
+	const std::vector<const std::vector<cl_int>*> inputs{ &matrA.colInd, &matrA.values, &x };
+	const cl_uint rows = matrA.rows;
+	const cl_uint width = matrA.width;
+	size_t globalSize = (rows + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+	return runSparseKernel(device, my::kernels::spmvEll.source, "", inputs, rows, 1, NULL, &globalSize, rows, width);
+}
+
+std::vector<cl_int> spmvGpu(const SellMatr& matrA, const std::vector<cl_int>& x, const char* device)
+{
+	if (matrA.rows <= 0 || x.size() < static_cast<size_t>(matrA.cols))
+	{
+		std::cout << "Invalid sparse matrix or vector size\n";
+		return {};
+	}
+	if (matrA.values.empty())
+	{
+		return std::vector<cl_int>(matrA.rows, 0);
+	}
+
+	const std::vector<const std::vector<cl_int>*> inputs{ &matrA.sliceOffsets, &matrA.sliceWidths, &matrA.rowPerm,
+		&matrA.colInd, &matrA.values, &x };
+	const cl_uint rows = matrA.rows;
+	const cl_uint sliceHeight = matrA.sliceHeight;
+	size_t globalSize = (rows + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+	return runSparseKernel(device, my::kernels::spmvSell.source, "", inputs, rows, 1, NULL, &globalSize, rows, sliceHeight);
+}
+
+std::vector<cl_int> spmmGpu(const CsrMatr& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, const char* device)
+{
+	if (!isValidCsr(matrA) || sizeX <= 0 || matrB.size() < static_cast<size_t>(matrA.cols) * sizeX)
+	{
+		std::cout << "Invalid sparse matrix or dense operand size\n";
+		return {};
+	}
+	if (matrA.nnz() == 0)
+	{
+		return std::vector<cl_int>(static_cast<size_t>(matrA.rows) * sizeX, 0);
+	}
+
+	const std::vector<const std::vector<cl_int>*> inputs{ &matrA.rowPtr, &matrA.colInd, &matrA.values, &matrB };
+	const cl_uint rows = matrA.rows;
+	const cl_uint X = sizeX;
+	size_t localSize[]{ 16, 16 };
+	size_t globalSize[]{ (X + 15) / 16 * 16, (rows + 15) / 16 * 16 };
+	return runSparseKernel(device, my::kernels::spmmCsr.source, "", inputs, static_cast<size_t>(rows) * X, 2, localSize, globalSize, rows, X);
+}
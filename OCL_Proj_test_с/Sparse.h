@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <CL/cl.h>
+
+// Compressed sparse rows: the nonzeros of row r are [rowPtr[r], rowPtr[r + 1])
+struct CsrMatr
+{
+	cl_int rows{};
+	cl_int cols{};
+	std::vector<cl_int> rowPtr;
+	std::vector<cl_int> colInd;
+	std::vector<cl_int> values;
+
+	size_t nnz() const { return values.size(); }
+};
+
+// ELLPACK: every row padded to the longest one, stored column by column so that
+// neighbouring work-items read neighbouring elements. Padding has colInd == -1
+struct EllMatr
+{
+	cl_int rows{};
+	cl_int cols{};
+	cl_int width{};
+	std::vector<cl_int> colInd;
+	std::vector<cl_int> values;
+};
+
+// SELL-C-sigma: rows sorted by length inside windows of sigma rows, then cut into
+// slices of sliceHeight rows, each padded only to its own longest row.
+// rowPerm maps a stored row back to its row in the original matrix
+struct SellMatr
+{
+	cl_int rows{};
+	cl_int cols{};
+	cl_int sliceHeight{};
+	cl_int sigma{};
+	std::vector<cl_int> sliceOffsets;
+	std::vector<cl_int> sliceWidths;
+	std::vector<cl_int> rowPerm;
+	std::vector<cl_int> colInd;
+	std::vector<cl_int> values;
+};
+
+enum class SpmvKernel { Auto, ScalarPerRow, VectorPerRow };
+
+CsrMatr csrFromDense(const std::vector<cl_int>& matr, cl_int rows, cl_int cols);
+EllMatr ellFromCsr(const CsrMatr& matr);
+SellMatr sellFromCsr(const CsrMatr& matr, cl_int sliceHeight = 32, cl_int sigma = 256);
+
+// OpenMP paths split rows so that every thread gets about the same number of nonzeros
+std::vector<cl_int> spmvCpu(const CsrMatr& matrA, const std::vector<cl_int>& x);
+std::vector<cl_int> spmmCpu(const CsrMatr& matrA, const std::vector<cl_int>& matrB, cl_int sizeX);
+
+std::vector<cl_int> spmvGpu(const CsrMatr& matrA, const std::vector<cl_int>& x, const char* device,
+	SpmvKernel kernel = SpmvKernel::Auto);
+std::vector<cl_int> spmvGpu(const EllMatr& matrA, const std::vector<cl_int>& x, const char* device);
+std::vector<cl_int> spmvGpu(const SellMatr& matrA, const std::vector<cl_int>& x, const char* device);
+std::vector<cl_int> spmmGpu(const CsrMatr& matrA, const std::vector<cl_int>& matrB, cl_int sizeX, const char* device);
@@ -0,0 +1,16 @@
+// Neighbouring work-items take neighbouring columns of B, so reads of B coalesce
+__kernel void operation(const __global int * rowPtr,
+	const __global int * colInd, const __global int * values,
+	const __global int * matrB, __global int * resMatr,
+	unsigned int rows, unsigned int X)
+{
+	int x = get_global_id(0);
+	int row = get_global_id(1);
+	if (x >= X || row >= rows) return;
+	int sum = 0;
+	for (int j = rowPtr[row]; j < rowPtr[row + 1]; ++j)
+	{
+		sum += values[j] * matrB[colInd[j] * X + x];
+	}
+	resMatr[row * X + x] = sum;
+}
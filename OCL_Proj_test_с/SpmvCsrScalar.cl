@@ -0,0 +1,13 @@
+__kernel void operation(const __global int * rowPtr,
+	const __global int * colInd, const __global int * values,
+	const __global int * x, __global int * y, unsigned int rows)
+{
+	int row = get_global_id(0);
+	if (row >= rows) return;
+	int sum = 0;
+	for (int j = rowPtr[row]; j < rowPtr[row + 1]; ++j)
+	{
+		sum += values[j] * x[colInd[j]];
+	}
+	y[row] = sum;
+}
@@ -0,0 +1,28 @@
+// VECTOR_SIZE work-items share a row and reduce their partial sums in local memory
+__kernel void operation(const __global int * rowPtr,
+	const __global int * colInd, const __global int * values,
+	const __global int * x, __global int * y, unsigned int rows)
+{
+	__local int partial[GROUP_SIZE];
+	int lid = get_local_id(0);
+	int lane = lid % VECTOR_SIZE;
+	int row = get_global_id(0) / VECTOR_SIZE;
+	int sum = 0;
+	if (row < rows)
+	{
+		for (int j = rowPtr[row] + lane; j < rowPtr[row + 1]; j += VECTOR_SIZE)
+		{
+			sum += values[j] * x[colInd[j]];
+		}
+	}
+	partial[lid] = sum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for (int offset = VECTOR_SIZE / 2; offset > 0; offset >>= 1)
+	{
+		if (lane < offset)
+			partial[lid] += partial[lid + offset];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (lane == 0 && row < rows)
+		y[row] = partial[lid];
+}
@@ -0,0 +1,16 @@
+__kernel void operation(const __global int * colInd,
+	const __global int * values, const __global int * x,
+	__global int * y, unsigned int rows, unsigned int width)
+{
+	int row = get_global_id(0);
+	if (row >= rows) return;
+	int sum = 0;
+	for (int j = 0; j < width; ++j)
+	{
+		size_t idx = (size_t)j * rows + row;
+		int col = colInd[idx];
+		if (col >= 0)
+			sum += values[idx] * x[col];
+	}
+	y[row] = sum;
+}
@@ -0,0 +1,20 @@
+__kernel void operation(const __global int * sliceOffsets,
+	const __global int * sliceWidths, const __global int * rowPerm,
+	const __global int * colInd, const __global int * values,
+	const __global int * x, __global int * y,
+	unsigned int rows, unsigned int sliceHeight)
+{
+	int row = get_global_id(0);
+	if (row >= rows) return;
+	int slice = row / sliceHeight;
+	int base = sliceOffsets[slice] + row % sliceHeight;
+	int sum = 0;
+	for (int j = 0; j < sliceWidths[slice]; ++j)
+	{
+		int idx = base + j * sliceHeight;
+		int col = colInd[idx];
+		if (col >= 0)
+			sum += values[idx] * x[col];
+	}
+	y[rowPerm[row]] = sum;
+}
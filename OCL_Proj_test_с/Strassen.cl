@@ -0,0 +1,50 @@
+// operation: resMatr (+)= matrA * matrB on sub-blocks given by offset and leading
+// dimension; addSub: dst = lhs +- rhs, element by element, so dst may alias either input
+#define TILE_SIZE 16
+__kernel void operation(const __global uint * matrA, ulong offA, uint ldA,
+	const __global uint * matrB, ulong offB, uint ldB,
+	__global uint * resMatr, ulong offC, uint ldC,
+	uint Z, uint Y, uint X, int accumulate)
+{
+	uint x = get_global_id(0);
+	uint z = get_global_id(1);
+	uint lx = get_local_id(0);
+	uint lz = get_local_id(1);
+
+	__local uint tileA[TILE_SIZE][TILE_SIZE];
+	__local uint tileB[TILE_SIZE][TILE_SIZE];
+
+	uint sum = 0;
+	for (uint tileY = 0; tileY < Y; tileY += TILE_SIZE)
+	{
+		uint ya = tileY + lx;
+		uint yb = tileY + lz;
+		tileA[lz][lx] = (z < Z && ya < Y) ? matrA[offA + (size_t)z * ldA + ya] : 0;
+		tileB[lz][lx] = (yb < Y && x < X) ? matrB[offB + (size_t)yb * ldB + x] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		for (uint y = 0; y < TILE_SIZE; ++y)
+		{
+			sum += tileA[lz][y] * tileB[y][lx];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (z < Z && x < X)
+	{
+		size_t index = offC + (size_t)z * ldC + x;
+		resMatr[index] = accumulate ? resMatr[index] + sum : sum;
+	}
+}
+
+__kernel void addSub(__global uint * dst, ulong offD, uint ldD,
+	const __global uint * lhs, ulong offL, uint ldL,
+	const __global uint * rhs, ulong offR, uint ldR,
+	uint rows, uint cols, int subtract)
+{
+	uint col = get_global_id(0);
+	uint row = get_global_id(1);
+	if (row >= rows || col >= cols)
+		return;
+	uint l = lhs[offL + (size_t)row * ldL + col];
+	uint r = rhs[offR + (size_t)row * ldR + col];
+	dst[offD + (size_t)row * ldD + col] = subtract ? l - r : l + r;
+}
@@ -0,0 +1,415 @@
+#include "Strassen.h"
+#include "DevWorker.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+	const size_t TILE{ 16 };
+
+	// Sub-block of a row-major matrix: element (row, col) sits at offset + row * ld + col of data
+	template <typename Storage>
+	struct Block
+	{
+		Storage data;
+		size_t offset;
+		cl_int ld;
+
+		Block at(cl_int row, cl_int col) const
+		{
+			return { data, offset + static_cast<size_t>(row) * ld + col, ld };
+		}
+	};
+
+	cl_int clampCrossover(const StrassenConfig& config)
+	{
+		return std::max(config.crossover, cl_int(1));
+	}
+
+	// Winograd's variant with the two-temporary schedule of Boyer, Dumas, Pernet and Zhou:
+	// the products land in the quadrants of the result, which double as scratch, so a level
+	// needs only tempA (z x max(y, x)) and tempB (y x x)
+	template <typename Backend>
+	void strassen(Backend& backend, const typename Backend::BlockType& matrA, const typename Backend::BlockType& matrB,
+		const typename Backend::BlockType& resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX, size_t level)
+	{
+		if (std::min({ sizeZ, sizeY, sizeX }) <= backend.crossover)
+		{
+			backend.gemm(matrA, matrB, resMatr, sizeZ, sizeY, sizeX, false);
+			return;
+		}
+		const cl_int z = sizeZ / 2;
+		const cl_int y = sizeY / 2;
+		const cl_int x = sizeX / 2;
+		const auto a11 = matrA, a12 = matrA.at(0, y), a21 = matrA.at(z, 0), a22 = matrA.at(z, y);
+		const auto b11 = matrB, b12 = matrB.at(0, x), b21 = matrB.at(y, 0), b22 = matrB.at(y, x);
+		const auto c11 = resMatr, c12 = resMatr.at(0, x), c21 = resMatr.at(z, 0), c22 = resMatr.at(z, x);
+		const auto tempA = backend.temp(level, 0, std::max(y, x));
+		const auto tempB = backend.temp(level, 1, x);
+
+		backend.add(tempA, a11, a21, z, y, true);			// S3 = A11 - A21
+		backend.add(tempB, b22, b12, y, x, true);			// T3 = B22 - B12
+		strassen(backend, tempA, tempB, c21, z, y, x, level + 1);	// P7 = S3 T3
+		backend.add(tempA, a21, a22, z, y, false);			// S1 = A21 + A22
+		backend.add(tempB, b12, b11, y, x, true);			// T1 = B12 - B11
+		strassen(backend, tempA, tempB, c22, z, y, x, level + 1);	// P5 = S1 T1
+		backend.add(tempA, tempA, a11, z, y, true);			// S2 = S1 - A11
+		backend.add(tempB, b22, tempB, y, x, true);			// T2 = B22 - T1
+		strassen(backend, tempA, tempB, c12, z, y, x, level + 1);	// P6 = S2 T2
+		backend.add(tempA, a12, tempA, z, y, true);			// S4 = A12 - S2
+		strassen(backend, tempA, b22, c11, z, y, x, level + 1);	// P3 = S4 B22
+		strassen(backend, a11, b11, tempA, z, y, x, level + 1);	// P1 = A11 B11
+		backend.add(c12, tempA, c12, z, x, false);			// U2 = P1 + P6
+		backend.add(c21, c12, c21, z, x, false);			// U3 = U2 + P7
+		backend.add(c12, c12, c22, z, x, false);			// U4 = U2 + P5
+		backend.add(c22, c21, c22, z, x, false);			// C22 = U3 + P5
+		backend.add(c12, c12, c11, z, x, false);			// C12 = U4 + P3
+		backend.add(tempB, tempB, b21, y, x, true);			// T4 = T2 - B21
+		strassen(backend, a22, tempB, c11, z, y, x, level + 1);	// P4 = A22 T4
+		backend.add(c21, c21, c11, z, x, true);				// C21 = U3 - P4
+		strassen(backend, a12, b21, c11, z, y, x, level + 1);	// P2 = A12 B21
+		backend.add(c11, tempA, c11, z, x, false);			// C11 = P1 + P2
+
+		// Peeling: the even part above misses the last column of A against the last row
+		// of B, and the odd last column and row of the result
+		if (sizeY % 2)
+		{
+			backend.gemm(matrA.at(0, sizeY - 1), matrB.at(sizeY - 1, 0), resMatr, 2 * z, 1, 2 * x, true);
+		}
+		if (sizeX % 2)
+		{
+			backend.gemm(matrA, matrB.at(0, sizeX - 1), resMatr.at(0, sizeX - 1), sizeZ, sizeY, 1, false);
+		}
+		if (sizeZ % 2)
+		{
+			backend.gemm(matrA.at(sizeZ - 1, 0), matrB, resMatr.at(sizeZ - 1, 0), 1, sizeY, 2 * x, false);
+		}
+	}
+
+	struct CpuBackend
+	{
+		using BlockType = Block<cl_int*>;
+
+		cl_int crossover;
+		StrassenWorkspace& workspace;
+		cl_int* temps;
+
+		BlockType temp(size_t level, size_t which, cl_int ld) const
+		{
+			return { temps, workspace.levelOffset(level, which), ld };
+		}
+
+		void gemm(const BlockType& matrA, const BlockType& matrB, const BlockType& resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX, bool accumulate)
+		{
+			if (!accumulate)
+			{
+				matMultCpu(MatrView<const cl_int>(matrA.data, sizeZ, sizeY, MatrLayout::RowMajor, matrA.ld, matrA.offset),
+					MatrView<const cl_int>(matrB.data, sizeY, sizeX, MatrLayout::RowMajor, matrB.ld, matrB.offset),
+					MatrView<cl_int>(resMatr.data, sizeZ, sizeX, MatrLayout::RowMajor, resMatr.ld, resMatr.offset),
+					workspace.leafWorkspace());
+				return;
+			}
+			// Only the rank-1 peeling update accumulates
+#pragma omp parallel for schedule(static)
+			for (int64_t z = 0; z < sizeZ; ++z)
+			{
+				uint32_t* res = reinterpret_cast<uint32_t*>(resMatr.data + resMatr.offset + z * resMatr.ld);
+				for (int64_t y = 0; y < sizeY; ++y)
+				{
+					const uint32_t el = static_cast<uint32_t>(matrA.data[matrA.offset + z * matrA.ld + y]);
+					const uint32_t* row = reinterpret_cast<const uint32_t*>(matrB.data + matrB.offset + y * matrB.ld);
+					for (int64_t x = 0; x < sizeX; ++x)
+					{
+						res[x] += el * row[x];
+					}
+				}
+			}
+		}
+
+		// Unsigned, so that wrapping is defined
+		void add(const BlockType& dst, const BlockType& lhs, const BlockType& rhs, cl_int rows, cl_int cols, bool subtract)
+		{
+#pragma omp parallel for schedule(static)
+			for (int64_t row = 0; row < rows; ++row)
+			{
+				uint32_t* out = reinterpret_cast<uint32_t*>(dst.data + dst.offset + row * dst.ld);
+				const uint32_t* left = reinterpret_cast<const uint32_t*>(lhs.data + lhs.offset + row * lhs.ld);
+				const uint32_t* right = reinterpret_cast<const uint32_t*>(rhs.data + rhs.offset + row * rhs.ld);
+				if (subtract)
+				{
+					for (int64_t col = 0; col < cols; ++col)
+					{
+						out[col] = left[col] - right[col];
+					}
+				}
+				else
+				{
+					for (int64_t col = 0; col < cols; ++col)
+					{
+						out[col] = left[col] + right[col];
+					}
+				}
+			}
+		}
+	};
+
+	// Every launch goes to the task's in-order queue, which keeps the schedule's order;
+	// the first error is kept and everything after it skipped
+	struct GpuBackend
+	{
+		using BlockType = Block<cl_mem>;
+
+		cl_int crossover;
+		StrassenWorkspace& workspace;
+		cl_mem temps;
+		int status{ CL_SUCCESS };
+
+		BlockType temp(size_t level, size_t which, cl_int ld) const
+		{
+			return { temps, workspace.levelOffset(level, which), ld };
+		}
+
+		void gemm(const BlockType& matrA, const BlockType& matrB, const BlockType& resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX, bool accumulate)
+		{
+			if (status != CL_SUCCESS)
+			{
+				return;
+			}
+			my::GpuTask& task = workspace.task();
+			status = task.passParams(matrA.data, static_cast<cl_ulong>(matrA.offset), static_cast<cl_uint>(matrA.ld),
+				matrB.data, static_cast<cl_ulong>(matrB.offset), static_cast<cl_uint>(matrB.ld),
+				resMatr.data, static_cast<cl_ulong>(resMatr.offset), static_cast<cl_uint>(resMatr.ld),
+				static_cast<cl_uint>(sizeZ), static_cast<cl_uint>(sizeY), static_cast<cl_uint>(sizeX), cl_int(accumulate));
+			if (status == CL_SUCCESS)
+			{
+				const size_t localSize[]{ TILE, TILE };
+				const size_t globalSize[]{ (sizeX + TILE - 1) / TILE * TILE, (sizeZ + TILE - 1) / TILE * TILE };
+				status = task.enqueueKernel(2, localSize, globalSize, {}, nullptr);
+			}
+		}
+
+		void add(const BlockType& dst, const BlockType& lhs, const BlockType& rhs, cl_int rows, cl_int cols, bool subtract)
+		{
+			if (status != CL_SUCCESS)
+			{
+				return;
+			}
+			cl_kernel kernel = workspace.addKernel();
+			status = my::GpuTask::passKernelParams(kernel, dst.data, static_cast<cl_ulong>(dst.offset), static_cast<cl_uint>(dst.ld),
+				lhs.data, static_cast<cl_ulong>(lhs.offset), static_cast<cl_uint>(lhs.ld),
+				rhs.data, static_cast<cl_ulong>(rhs.offset), static_cast<cl_uint>(rhs.ld),
+				static_cast<cl_uint>(rows), static_cast<cl_uint>(cols), cl_int(subtract));
+			if (status == CL_SUCCESS)
+			{
+				const size_t globalSize[]{ static_cast<size_t>(cols), static_cast<size_t>(rows) };
+				status = clEnqueueNDRangeKernel(workspace.task().getQueue(), kernel, 2, NULL, globalSize, NULL, 0, NULL, NULL);
+			}
+		}
+	};
+}
+
+StrassenWorkspace::~StrassenWorkspace()
+{
+	releaseDevice();
+}
+
+size_t StrassenWorkspace::plan(cl_int sizeZ, cl_int sizeY, cl_int sizeX, const StrassenConfig& config)
+{
+	const cl_int crossover = clampCrossover(config);
+	m_levelOffsets.clear();
+	size_t total = 0;
+	while (std::min({ sizeZ, sizeY, sizeX }) > crossover)
+	{
+		sizeZ /= 2;
+		sizeY /= 2;
+		sizeX /= 2;
+		m_levelOffsets.push_back(total);
+		total += static_cast<size_t>(sizeZ) * std::max(sizeY, sizeX);
+		m_levelOffsets.push_back(total);
+		total += static_cast<size_t>(sizeY) * sizeX;
+	}
+	return total;
+}
+
+cl_int* StrassenWorkspace::hostTemps(size_t count)
+{
+	if (m_hostTemps.size() < count)
+	{
+		m_hostTemps.resize(count);
+	}
+	return m_hostTemps.data();
+}
+
+bool StrassenWorkspace::prepareDevice(const char* device)
+{
+	if (!m_task.isTaskFailed() && m_addKernel && m_device == device)
+	{
+		return true;
+	}
+	releaseDevice();
+	my::DevWorker worker;
+	m_task = worker.createGpuTask(device, my::kernels::strassen.source);
+	if (m_task.isTaskFailed())
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return false;
+	}
+	int err = CL_SUCCESS;
+	m_addKernel = m_task.createKernel("addSub", err);
+	if (err != CL_SUCCESS)
+	{
+		std::cout << "Kernel creation failed!\n";
+		m_addKernel = nullptr;
+		return false;
+	}
+	m_device = device;
+	return true;
+}
+
+cl_mem StrassenWorkspace::deviceBuffer(size_t slot, size_t bytes, int& err)
+{
+	err = CL_SUCCESS;
+	if (m_bufferBytes[slot] < bytes)
+	{
+		if (m_buffers[slot])
+		{
+			clReleaseMemObject(m_buffers[slot]);
+			m_buffers[slot] = nullptr;
+			m_bufferBytes[slot] = 0;
+		}
+		m_buffers[slot] = m_task.addBuffer<cl_int>(bytes / sizeof(cl_int), CL_MEM_READ_WRITE, err);
+		if (err != CL_SUCCESS)
+		{
+			m_buffers[slot] = nullptr;
+			return nullptr;
+		}
+		m_bufferBytes[slot] = bytes;
+	}
+	return m_buffers[slot];
+}
+
+void StrassenWorkspace::releaseDevice()
+{
+	for (size_t slot = 0; slot < BUFFER_SLOTS; ++slot)
+	{
+		if (m_buffers[slot])
+		{
+			clReleaseMemObject(m_buffers[slot]);
+			m_buffers[slot] = nullptr;
+		}
+		m_bufferBytes[slot] = 0;
+	}
+	if (m_addKernel)
+	{
+		clReleaseKernel(m_addKernel);
+		m_addKernel = nullptr;
+	}
+	m_task = my::GpuTask();
+	m_device.clear();
+}
+
+void matMultCpuStrassen(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	StrassenWorkspace& workspace, const StrassenConfig& config)
+{
+	const size_t temps = workspace.plan(sizeZ, sizeY, sizeX, config);
+	CpuBackend backend{ clampCrossover(config), workspace, workspace.hostTemps(temps) };
+	// The operands are only ever read; Block is shared with the writable blocks
+	strassen(backend, { const_cast<cl_int*>(matrA), 0, sizeY }, { const_cast<cl_int*>(matrB), 0, sizeX },
+		{ resMatr, 0, sizeX }, sizeZ, sizeY, sizeX, 0);
+}
+
+std::vector<cl_int> matMultCpuStrassen(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const StrassenConfig& config)
+{
+	if (matrA.size() < static_cast<size_t>(sizeZ) * sizeY || matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return {};
+	}
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	StrassenWorkspace workspace;
+	matMultCpuStrassen(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX, workspace, config);
+	return resMatr;
+}
+
+int matMultGpuStrassen(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, StrassenWorkspace& workspace, const StrassenConfig& config)
+{
+	if (!workspace.prepareDevice(device))
+	{
+		return EXIT_FAILURE;
+	}
+	my::GpuTask& task = workspace.task();
+	const size_t temps = workspace.plan(sizeZ, sizeY, sizeX, config);
+	const size_t matrASize = static_cast<size_t>(sizeZ) * sizeY;
+	const size_t matrBSize = static_cast<size_t>(sizeY) * sizeX;
+	const size_t resMatrSize = static_cast<size_t>(sizeZ) * sizeX;
+
+	double totalTime = omp_get_wtime();
+	int res = CL_SUCCESS;
+	cl_mem matrABuff = workspace.deviceBuffer(0, sizeof(cl_int) * matrASize, res);
+	cl_mem matrBBuff = res == CL_SUCCESS ? workspace.deviceBuffer(1, sizeof(cl_int) * matrBSize, res) : nullptr;
+	cl_mem resMatrBuff = res == CL_SUCCESS ? workspace.deviceBuffer(2, sizeof(cl_int) * resMatrSize, res) : nullptr;
+	cl_mem tempsBuff = res == CL_SUCCESS ? workspace.deviceBuffer(3, sizeof(cl_int) * std::max<size_t>(temps, 1), res) : nullptr;
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in buffer creation process\n";
+		return EXIT_FAILURE;
+	}
+
+	const std::vector<cl_event> noEvents;
+	res = task.enqueueWriteBuffer<cl_int>(matrASize, matrA, matrABuff, noEvents, nullptr);
+	if (res == CL_SUCCESS)
+	{
+		res = task.enqueueWriteBuffer<cl_int>(matrBSize, matrB, matrBBuff, noEvents, nullptr);
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in write buffer enqueue\n";
+		clFinish(task.getQueue());
+		return EXIT_FAILURE;
+	}
+
+	double kernelTime = omp_get_wtime();
+	GpuBackend backend{ clampCrossover(config), workspace, tempsBuff };
+	strassen(backend, { matrABuff, 0, sizeY }, { matrBBuff, 0, sizeX }, { resMatrBuff, 0, sizeX }, sizeZ, sizeY, sizeX, 0);
+	if (backend.status != CL_SUCCESS)
+	{
+		std::cout << "With enqueue task proc problems\n";
+		std::cout << backend.status << std::endl;
+		clFinish(task.getQueue());
+		return EXIT_FAILURE;
+	}
+	clFinish(task.getQueue());
+	kernelTime = omp_get_wtime() - kernelTime;
+
+	res = task.enqueueReadBuffer<cl_int>(resMatrSize, resMatr, resMatrBuff);
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in read buffer enqueue\n";
+		return EXIT_FAILURE;
+	}
+	totalTime = omp_get_wtime() - totalTime;
+	std::cout << "Kernel time on GPU: " << kernelTime << '\n';
+	std::cout << "Total time on GPU: " << totalTime << '\n';
+	return EXIT_SUCCESS;
+}
+
+std::vector<cl_int> matMultGpuStrassen(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, const StrassenConfig& config)
+{
+	if (matrA.size() < static_cast<size_t>(sizeZ) * sizeY || matrB.size() < static_cast<size_t>(sizeY) * sizeX)
+	{
+		std::cout << "Incompatible matrix sizes\n";
+		return {};
+	}
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeZ) * sizeX);
+	StrassenWorkspace workspace;
+	if (matMultGpuStrassen(matrA.data(), matrB.data(), resMatr.data(), sizeZ, sizeY, sizeX, device, workspace, config) != EXIT_SUCCESS)
+	{
+		return {};
+	}
+	return resMatr;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <CL/cl.h>
+#include "MatMult.h"
+
+// Strassen-Winograd recursion over the integer GEMM: 7 half-size products and 15 additions
+// per level instead of 8 products. Arithmetic wraps modulo 2^32 exactly as the plain
+// kernels do, so results are bit-identical to matMultCpu and matMultGpu.
+struct StrassenConfig
+{
+	// Recursion stops once any dimension is at or below this; tune per device, since below
+	// it the extra additions cost more than the product they save
+	cl_int crossover{ 1024 };
+};
+
+// Temporaries of every recursion level, sized once per shape and reused across calls.
+// Odd dimensions are peeled off at each level and fixed up with thin products, so no
+// padding is ever allocated. A workspace is not thread-safe; give each thread its own.
+class StrassenWorkspace
+{
+public:
+	StrassenWorkspace() = default;
+	~StrassenWorkspace();
+	StrassenWorkspace(const StrassenWorkspace&) = delete;
+	StrassenWorkspace& operator=(const StrassenWorkspace&) = delete;
+
+	// Offsets of each level's two temporaries for this shape; returns the elements needed in total
+	size_t plan(cl_int sizeZ, cl_int sizeY, cl_int sizeX, const StrassenConfig& config);
+	size_t levelOffset(size_t level, size_t which) const
+	{
+		return m_levelOffsets[2 * level + which];
+	}
+
+	cl_int* hostTemps(size_t count);
+	MatMultWorkspace& leafWorkspace()
+	{
+		return m_leafWorkspace;
+	}
+
+	// Compiled kernels and device buffers for device, built on first use
+	bool prepareDevice(const char* device);
+	my::GpuTask& task()
+	{
+		return m_task;
+	}
+	cl_kernel addKernel() const
+	{
+		return m_addKernel;
+	}
+	// slot 0..2: A, B, result; 3: temporaries
+	cl_mem deviceBuffer(size_t slot, size_t bytes, int& err);
+	void releaseDevice();
+
+private:
+	std::vector<size_t> m_levelOffsets;
+	std::vector<cl_int> m_hostTemps;
+	MatMultWorkspace m_leafWorkspace;
+
+	my::GpuTask m_task;
+	cl_kernel m_addKernel{};
+	std::string m_device;
+	static const size_t BUFFER_SLOTS{ 4 };
+	cl_mem m_buffers[BUFFER_SLOTS]{};
+	size_t m_bufferBytes[BUFFER_SLOTS]{};
+};
+
+// resMatr is sizeZ x sizeX; leaves run matMultCpu on strided views
+void matMultCpuStrassen(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	StrassenWorkspace& workspace, const StrassenConfig& config = StrassenConfig());
+std::vector<cl_int> matMultCpuStrassen(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const StrassenConfig& config = StrassenConfig());
+
+// The whole recursion stays on the device: operands are uploaded once, additions and leaf
+// products run as kernels on sub-blocks addressed by offset. Returns EXIT_SUCCESS or EXIT_FAILURE.
+int matMultGpuStrassen(const cl_int* matrA, const cl_int* matrB, cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, StrassenWorkspace& workspace, const StrassenConfig& config = StrassenConfig());
+std::vector<cl_int> matMultGpuStrassen(const std::vector<cl_int>& matrA, const std::vector<cl_int>& matrB, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device, const StrassenConfig& config = StrassenConfig());
@@ -0,0 +1,6 @@
+__kernel void operation(__global int * data, int count)
+{
+	int index = get_global_id(0);
+	if (index < count)
+		data[index] = data[index] * 3 + 1;
+}
@@ -0,0 +1,17 @@
+#define TILE_SIZE 16
+__kernel void operation(const __global int * matrA,
+	__global int * resMatr, unsigned int X, unsigned int Y)
+{
+	__local int tile[TILE_SIZE][TILE_SIZE + 1];
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int x = get_group_id(0) * TILE_SIZE + lx;
+	int y = get_group_id(1) * TILE_SIZE + ly;
+	if (x < X && y < Y)
+		tile[ly][lx] = matrA[y * X + x];
+	barrier(CLK_LOCAL_MEM_FENCE);
+	x = get_group_id(1) * TILE_SIZE + lx;
+	y = get_group_id(0) * TILE_SIZE + ly;
+	if (x < Y && y < X)
+		resMatr[y * Y + x] = tile[lx][ly];
+}
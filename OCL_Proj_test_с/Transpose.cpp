@@ -0,0 +1,299 @@
+#include "Transpose.h"
+#include "DevWorker.h"
+#include "CpuFeatures.h"
+#include "KernelLibrary.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+	// Square tiles handed to a single thread, sized to keep source and destination in L1/L2
+	const int64_t TILE = 64;
+	// Above this many elements the result will not fit in cache, so it is written with streaming stores
+	const int64_t STREAM_THRESHOLD = int64_t(1) << 22;
+
+	// Rows of one micro block; both SIMD widths stack 16 of them, so that each output row
+	// of a block is a full 64-byte line
+	const int64_t MICRO_Y = 16;
+
+	inline void transpScalar(const cl_int* matrA, cl_int* resMatr, int64_t sizeX, int64_t sizeY,
+		int64_t yBegin, int64_t yEnd, int64_t xBegin, int64_t xEnd)
+	{
+		for (int64_t y = yBegin; y < yEnd; ++y)
+		{
+			for (int64_t x = xBegin; x < xEnd; ++x)
+			{
+				resMatr[x * sizeY + y] = matrA[y * sizeX + x];
+			}
+		}
+	}
+
+	using TileFunc = void (*)(const cl_int* matrA, cl_int* resMatr, int64_t sizeX, int64_t sizeY, int64_t yBegin, int64_t xBegin, bool stream);
+
+	void transpTileScalar(const cl_int* matrA, cl_int* resMatr, int64_t sizeX, int64_t sizeY, int64_t yBegin, int64_t xBegin,
+		bool /*stream*/)
+	{
+		transpScalar(matrA, resMatr, sizeX, sizeY, yBegin, std::min(yBegin + TILE, sizeY), xBegin, std::min(xBegin + TILE, sizeX));
+	}
+
+#ifdef MY_X86
+#if defined(__GNUC__) && !defined(__clang__)
+	// GCC 12's AVX-512 headers self-initialise their undefined registers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+	// 16x16 block in registers: every output row is one full 64-byte line
+	MY_TARGET("avx512f") inline void transpMicro512(const cl_int* src, int64_t srcStride, cl_int* dst, int64_t dstStride, bool stream)
+	{
+		__m512i r[16];
+		__m512i t[16];
+		for (int i = 0; i < 16; ++i)
+		{
+			r[i] = _mm512_loadu_si512(src + i * srcStride);
+		}
+		for (int i = 0; i < 16; i += 2)
+		{
+			t[i] = _mm512_unpacklo_epi32(r[i], r[i + 1]);
+			t[i + 1] = _mm512_unpackhi_epi32(r[i], r[i + 1]);
+		}
+		for (int i = 0; i < 16; i += 4)
+		{
+			r[i] = _mm512_unpacklo_epi64(t[i], t[i + 2]);
+			r[i + 1] = _mm512_unpackhi_epi64(t[i], t[i + 2]);
+			r[i + 2] = _mm512_unpacklo_epi64(t[i + 1], t[i + 3]);
+			r[i + 3] = _mm512_unpackhi_epi64(t[i + 1], t[i + 3]);
+		}
+		for (int i = 0; i < 4; ++i)
+		{
+			t[i] = _mm512_shuffle_i32x4(r[i], r[i + 4], 0x88);
+			t[i + 4] = _mm512_shuffle_i32x4(r[i], r[i + 4], 0xdd);
+			t[i + 8] = _mm512_shuffle_i32x4(r[i + 8], r[i + 12], 0x88);
+			t[i + 12] = _mm512_shuffle_i32x4(r[i + 8], r[i + 12], 0xdd);
+		}
+		for (int i = 0; i < 8; ++i)
+		{
+			r[i] = _mm512_shuffle_i32x4(t[i], t[i + 8], 0x88);
+			r[i + 8] = _mm512_shuffle_i32x4(t[i], t[i + 8], 0xdd);
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			if (stream)
+			{
+				_mm512_stream_si512(reinterpret_cast<__m512i*>(dst + i * dstStride), r[i]);
+			}
+			else
+			{
+				_mm512_storeu_si512(dst + i * dstStride, r[i]);
+			}
+		}
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+	MY_TARGET("avx2") inline void transp8x8(const cl_int* src, int64_t srcStride, __m256i out[8])
+	{
+		__m256i r[8];
+		__m256i t[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * srcStride));
+		}
+		for (int i = 0; i < 8; i += 2)
+		{
+			t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+			t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+		}
+		for (int i = 0; i < 8; i += 4)
+		{
+			r[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+			r[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+			r[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+			r[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+		}
+		for (int i = 0; i < 4; ++i)
+		{
+			out[i] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x20);
+			out[i + 4] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x31);
+		}
+	}
+
+	// Two stacked 8x8 blocks, so each output row gets a full 64-byte line
+	MY_TARGET("avx2") inline void transpMicro256(const cl_int* src, int64_t srcStride, cl_int* dst, int64_t dstStride, bool stream)
+	{
+		__m256i top[8];
+		__m256i bottom[8];
+		transp8x8(src, srcStride, top);
+		transp8x8(src + 8 * srcStride, srcStride, bottom);
+		for (int i = 0; i < 8; ++i)
+		{
+			__m256i* row = reinterpret_cast<__m256i*>(dst + i * dstStride);
+			if (stream)
+			{
+				_mm256_stream_si256(row, top[i]);
+				_mm256_stream_si256(row + 1, bottom[i]);
+			}
+			else
+			{
+				_mm256_storeu_si256(row, top[i]);
+				_mm256_storeu_si256(row + 1, bottom[i]);
+			}
+		}
+	}
+	template <int64_t MICRO_X, void (*MICRO)(const cl_int*, int64_t, cl_int*, int64_t, bool)>
+	void transpTileSimd(const cl_int* matrA, cl_int* resMatr, int64_t sizeX, int64_t sizeY, int64_t yBegin, int64_t xBegin, bool stream)
+	{
+		const int64_t yEnd = std::min(yBegin + TILE, sizeY);
+		const int64_t xEnd = std::min(xBegin + TILE, sizeX);
+		const int64_t yFull = yBegin + (yEnd - yBegin) / MICRO_Y * MICRO_Y;
+		const int64_t xFull = xBegin + (xEnd - xBegin) / MICRO_X * MICRO_X;
+		for (int64_t x = xBegin; x < xFull; x += MICRO_X)
+		{
+			for (int64_t y = yBegin; y < yFull; y += MICRO_Y)
+			{
+				MICRO(matrA + y * sizeX + x, sizeX, resMatr + x * sizeY + y, sizeY, stream);
+			}
+		}
+		// Ragged right and bottom edges of odd-sized matrices
+		transpScalar(matrA, resMatr, sizeX, sizeY, yBegin, yEnd, xFull, xEnd);
+		transpScalar(matrA, resMatr, sizeX, sizeY, yFull, yEnd, xBegin, xFull);
+	}
+#endif
+
+	TileFunc selectTile()
+	{
+#ifdef MY_X86
+		if (my::cpuFeatures().avx512f)
+		{
+			return transpTileSimd<16, transpMicro512>;
+		}
+		if (my::cpuFeatures().avx2)
+		{
+			return transpTileSimd<8, transpMicro256>;
+		}
+#endif
+		return transpTileScalar;
+	}
+}
+
+void transpMatrBlocked(const cl_int* matrA, cl_int* resMatr, cl_int sizeX, cl_int sizeY)
+{
+	const int64_t tilesX = (static_cast<int64_t>(sizeX) + TILE - 1) / TILE;
+	const int64_t tilesY = (static_cast<int64_t>(sizeY) + TILE - 1) / TILE;
+	const int64_t tilesCount = tilesX * tilesY;
+
+	const TileFunc transpTile = selectTile();
+	// Streaming stores need every micro block row to start on a cache line
+	const bool stream = transpTile != transpTileScalar &&
+		static_cast<int64_t>(sizeX) * sizeY >= STREAM_THRESHOLD &&
+		sizeY % MICRO_Y == 0 &&
+		reinterpret_cast<uintptr_t>(resMatr) % 64 == 0;
+
+#pragma omp parallel
+	{
+		// Consecutive tiles go down the source columns, so each thread fills
+		// contiguous stretches of the destination rows
+#pragma omp for schedule(static)
+		for (int64_t tile = 0; tile < tilesCount; ++tile)
+		{
+			const int64_t tileX = tile / tilesY;
+			const int64_t tileY = tile % tilesY;
+			transpTile(matrA, resMatr, sizeX, sizeY, tileY * TILE, tileX * TILE, stream);
+		}
+#ifdef MY_X86
+		if (stream)
+		{
+			_mm_sfence();
+		}
+#endif
+	}
+}
+
+std::vector<cl_int> transpMatrBlocked(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeY);
+	transpMatrBlocked(matrA.data(), resMatr.data(), sizeX, sizeY);
+	return resMatr;
+}
+
+std::vector<cl_int> transpMatrGpu(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY, const char* device)
+{
+	std::vector<cl_int> resMatr(static_cast<size_t>(sizeX) * sizeY);
+	my::DevWorker worker = my::DevWorker();
+
+	my::GpuTask task = worker.createGpuTask(device, my::kernels::transpShared.source);
+	if (!task.isTaskFailed())
+	{
+		int res = CL_SUCCESS;
+
+		const size_t tileSize = 16;
+		size_t localSize[]{ tileSize, tileSize };
+		size_t globalSize[]{ (sizeX + tileSize - 1) / tileSize * tileSize, (sizeY + tileSize - 1) / tileSize * tileSize };
+
+		double totalTime = omp_get_wtime();
+
+		cl_mem matrABuff = task.addBuffer<cl_int>(matrA.size(), CL_MEM_READ_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			return {};
+		}
+
+		cl_mem resMatrBuff = task.addBuffer<cl_int>(resMatr.size(), CL_MEM_WRITE_ONLY, res);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in buffer creation process\n";
+			clReleaseMemObject(matrABuff);
+			return {};
+		}
+
+		res = task.enqueueWriteBuffer<cl_int>(matrA.size(), matrA.data(), matrABuff);
+		if (res == CL_SUCCESS)
+		{
+			res = task.passParams(matrABuff, resMatrBuff, sizeX, sizeY);
+			if (res != CL_SUCCESS)
+			{
+				std::cout << "Problem in params passing process\n";
+			}
+		}
+		else
+		{
+			std::cout << "Problem in write buffer enqueue\n";
+		}
+
+		double kernelTime{};
+		if (res == CL_SUCCESS)
+		{
+			res = task.enqueueKernel(2, localSize, globalSize, &kernelTime);
+			if (res != CL_SUCCESS)
+			{
+				std::cout << "With enqueue task proc problems\n";
+			}
+		}
+		if (res == CL_SUCCESS)
+		{
+			res = task.enqueueReadBuffer<cl_int>(resMatr.size(), resMatr.data(), resMatrBuff);
+			if (res != CL_SUCCESS)
+			{
+				std::cout << "Problem in read buffer enqueue\n";
+			}
+		}
+		clReleaseMemObject(matrABuff);
+		clReleaseMemObject(resMatrBuff);
+		if (res != CL_SUCCESS)
+		{
+			return {};
+		}
+
+		totalTime = omp_get_wtime() - totalTime;
+		std::cout << "Transpose kernel time on GPU: " << kernelTime << '\n';
+		std::cout << "Transpose total time on GPU: " << totalTime << '\n';
+		return resMatr;
+	}
+	else
+	{
+		std::cout << "GpuTask creation failed!\n";
+		return {};
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <vector>
+#include <CL/cl.h>
+
+// matrA has sizeY rows of sizeX elements, the result has sizeX rows of sizeY elements
+std::vector<cl_int> transpMatrBlocked(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY);
+void transpMatrBlocked(const cl_int* matrA, cl_int* resMatr, cl_int sizeX, cl_int sizeY);
+
+std::vector<cl_int> transpMatrGpu(const std::vector<cl_int>& matrA, cl_int sizeX, cl_int sizeY, const char* device);
@@ -0,0 +1,231 @@
+#include "Verify.h"
+
+#include <iostream>
+
+#include "DevWorker.h"
+#include "KernelLibrary.h"
+
+namespace my
+{
+namespace
+{
+	enum BufferSlot { MATR_A, MATR_B, RES_MATR, VECS, MATR_B_VECS, PRODUCT_VECS, RES_VECS };
+
+	// Same product on the host, rows split over threads
+	void matrVecsCpu(const cl_int* matr, const uint32_t* vecs, uint32_t* res, int64_t rows, int64_t cols, int64_t count)
+	{
+#pragma omp parallel for schedule(static)
+		for (int64_t row = 0; row < rows; ++row)
+		{
+			const cl_int* line = matr + row * cols;
+			uint32_t* out = res + row * count;
+			std::fill(out, out + count, 0u);
+			for (int64_t col = 0; col < cols; ++col)
+			{
+				const uint32_t el = static_cast<uint32_t>(line[col]);
+				const uint32_t* vec = vecs + col * count;
+				for (int64_t j = 0; j < count; ++j)
+				{
+					out[j] += el * vec[j];
+				}
+			}
+		}
+	}
+}
+
+GemmVerifier::GemmVerifier(const VerifyConfig& config)
+	: m_config(config), m_random(config.seed ? config.seed : std::random_device()())
+{
+	m_config.rounds = std::max(m_config.rounds, 1u);
+}
+
+GemmVerifier::~GemmVerifier()
+{
+	releaseDevice();
+}
+
+bool GemmVerifier::sample()
+{
+	return m_config.sampleRate >= 1.0 ||
+		std::uniform_real_distribution<double>(0.0, 1.0)(m_random) < m_config.sampleRate;
+}
+
+void GemmVerifier::drawVectors(cl_int sizeX)
+{
+	// Uniform over all 32-bit values rather than {0, 1}: modulo 2^32 an error term
+	// then vanishes only when r absorbs all of its odd part
+	m_vecs.resize(static_cast<size_t>(sizeX) * m_config.rounds);
+	for (auto& el : m_vecs)
+	{
+		el = static_cast<uint32_t>(m_random());
+	}
+}
+
+VerifyResult GemmVerifier::compare(cl_int sizeZ) const
+{
+	const size_t count = static_cast<size_t>(sizeZ) * m_config.rounds;
+	return std::equal(m_productVecs.begin(), m_productVecs.begin() + count, m_resVecs.begin()) ?
+		VerifyResult::Passed : VerifyResult::Failed;
+}
+
+VerifyResult GemmVerifier::checkCpu(const cl_int* matrA, const cl_int* matrB, const cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX)
+{
+	if (!sample())
+	{
+		return VerifyResult::Skipped;
+	}
+	const int64_t rounds = m_config.rounds;
+	drawVectors(sizeX);
+	m_matrBVecs.resize(static_cast<size_t>(sizeY) * rounds);
+	m_productVecs.resize(static_cast<size_t>(sizeZ) * rounds);
+	m_resVecs.resize(static_cast<size_t>(sizeZ) * rounds);
+
+	matrVecsCpu(matrB, m_vecs.data(), m_matrBVecs.data(), sizeY, sizeX, rounds);
+	matrVecsCpu(matrA, m_matrBVecs.data(), m_productVecs.data(), sizeZ, sizeY, rounds);
+	matrVecsCpu(resMatr, m_vecs.data(), m_resVecs.data(), sizeZ, sizeX, rounds);
+	return compare(sizeZ);
+}
+
+cl_mem GemmVerifier::deviceBuffer(size_t slot, size_t bytes, int& err)
+{
+	err = CL_SUCCESS;
+	if (m_bufferBytes[slot] < bytes)
+	{
+		if (m_buffers[slot])
+		{
+			clReleaseMemObject(m_buffers[slot]);
+			m_buffers[slot] = nullptr;
+			m_bufferBytes[slot] = 0;
+		}
+		m_buffers[slot] = clCreateBuffer(m_task.getContext(), CL_MEM_READ_WRITE, bytes, NULL, &err);
+		if (err != CL_SUCCESS)
+		{
+			m_buffers[slot] = nullptr;
+			return nullptr;
+		}
+		m_bufferBytes[slot] = bytes;
+	}
+	return m_buffers[slot];
+}
+
+void GemmVerifier::releaseDevice()
+{
+	for (size_t slot = 0; slot < BUFFER_SLOTS; ++slot)
+	{
+		if (m_buffers[slot])
+		{
+			clReleaseMemObject(m_buffers[slot]);
+			m_buffers[slot] = nullptr;
+		}
+		m_bufferBytes[slot] = 0;
+	}
+}
+
+VerifyResult GemmVerifier::checkGpu(const cl_int* matrA, const cl_int* matrB, const cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+	const char* device)
+{
+	if (!sample())
+	{
+		return VerifyResult::Skipped;
+	}
+	if (m_task.isTaskFailed() || m_device != device)
+	{
+		releaseDevice();
+		DevWorker worker;
+		m_task = worker.createGpuTask(device, kernels::verifyMatrVecs.source);
+		m_device = device;
+		if (m_task.isTaskFailed())
+		{
+			m_device.clear();
+			std::cout << "GpuTask creation failed!\n";
+			return VerifyResult::Error;
+		}
+	}
+
+	const cl_uint rounds = m_config.rounds;
+	drawVectors(sizeX);
+	m_productVecs.resize(static_cast<size_t>(sizeZ) * rounds);
+	m_resVecs.resize(static_cast<size_t>(sizeZ) * rounds);
+
+	const size_t sizes[BUFFER_SLOTS]{ static_cast<size_t>(sizeZ) * sizeY, static_cast<size_t>(sizeY) * sizeX, static_cast<size_t>(sizeZ) * sizeX,
+		static_cast<size_t>(sizeX) * rounds, static_cast<size_t>(sizeY) * rounds, static_cast<size_t>(sizeZ) * rounds, static_cast<size_t>(sizeZ) * rounds };
+	cl_mem buffers[BUFFER_SLOTS]{};
+	int res = CL_SUCCESS;
+	for (size_t slot = 0; slot < BUFFER_SLOTS && res == CL_SUCCESS; ++slot)
+	{
+		buffers[slot] = deviceBuffer(slot, sizeof(cl_int) * sizes[slot], res);
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in buffer creation process\n";
+		return VerifyResult::Error;
+	}
+
+	// One in-order queue: the launches follow the uploads without events
+	const std::vector<cl_event> noEvents;
+	res = m_task.enqueueWriteBuffer<cl_int>(sizes[MATR_A], matrA, buffers[MATR_A], noEvents, nullptr);
+	if (res == CL_SUCCESS)
+	{
+		res = m_task.enqueueWriteBuffer<cl_int>(sizes[MATR_B], matrB, buffers[MATR_B], noEvents, nullptr);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = m_task.enqueueWriteBuffer<cl_int>(sizes[RES_MATR], resMatr, buffers[RES_MATR], noEvents, nullptr);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = m_task.enqueueWriteBuffer<uint32_t>(sizes[VECS], m_vecs.data(), buffers[VECS], noEvents, nullptr);
+	}
+	if (res != CL_SUCCESS)
+	{
+		std::cout << "Problem in write buffer enqueue\n";
+		clFinish(m_task.getQueue());
+		return VerifyResult::Error;
+	}
+
+	struct Launch
+	{
+		BufferSlot matr;
+		BufferSlot vecs;
+		BufferSlot res;
+		cl_uint rows;
+		cl_uint cols;
+	};
+	const Launch launches[]
+	{
+		{ MATR_B, VECS, MATR_B_VECS, static_cast<cl_uint>(sizeY), static_cast<cl_uint>(sizeX) },
+		{ MATR_A, MATR_B_VECS, PRODUCT_VECS, static_cast<cl_uint>(sizeZ), static_cast<cl_uint>(sizeY) },
+		{ RES_MATR, VECS, RES_VECS, static_cast<cl_uint>(sizeZ), static_cast<cl_uint>(sizeX) },
+	};
+	for (const Launch& launch : launches)
+	{
+		res = m_task.passParams(buffers[launch.matr], buffers[launch.vecs], buffers[launch.res], launch.rows, launch.cols, rounds);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "Problem in params passing process\n";
+			break;
+		}
+		const size_t globalSize[]{ rounds, launch.rows };
+		res = m_task.enqueueKernel(2, nullptr, globalSize, noEvents, nullptr);
+		if (res != CL_SUCCESS)
+		{
+			std::cout << "With enqueue task proc problems\n";
+			break;
+		}
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = m_task.enqueueReadBuffer<uint32_t>(m_productVecs.size(), m_productVecs.data(), buffers[PRODUCT_VECS], CL_FALSE);
+	}
+	if (res == CL_SUCCESS)
+	{
+		res = m_task.enqueueReadBuffer<uint32_t>(m_resVecs.size(), m_resVecs.data(), buffers[RES_VECS], CL_TRUE);
+	}
+	if (res != CL_SUCCESS)
+	{
+		clFinish(m_task.getQueue());
+		return VerifyResult::Error;
+	}
+	return compare(sizeZ);
+}
+}
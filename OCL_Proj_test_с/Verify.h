@@ -0,0 +1,159 @@
+#pragma once
+#include <CL/cl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GpuTask.h"
+
+namespace my
+{
+	struct VerifyConfig
+	{
+		// Random vectors per check. A wrong product passes one round with probability at
+		// most 1/2, and about 2^-32 unless the error is a multiple of a large power of two
+		unsigned rounds{ 4 };
+		// Fraction of checks actually run, for continuous sampling in production
+		double sampleRate{ 1.0 };
+		// 0 seeds from std::random_device
+		uint64_t seed{ 0 };
+	};
+
+	enum class VerifyResult { Passed, Failed, Skipped, Error };
+
+	// Freivalds' check of resMatr == matrA * matrB in O(n^2) per round: A (B r) is compared
+	// with C r for random vectors r. Arithmetic is modulo 2^32, as the kernels compute it.
+	// The device check keeps its compiled task and buffers between calls; a verifier is
+	// not thread-safe, give each thread its own.
+	class GemmVerifier
+	{
+	public:
+		explicit GemmVerifier(const VerifyConfig& config = VerifyConfig());
+		~GemmVerifier();
+		GemmVerifier(const GemmVerifier&) = delete;
+		GemmVerifier& operator=(const GemmVerifier&) = delete;
+
+		VerifyResult checkCpu(const cl_int* matrA, const cl_int* matrB, const cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX);
+		VerifyResult checkGpu(const cl_int* matrA, const cl_int* matrB, const cl_int* resMatr, cl_int sizeZ, cl_int sizeY, cl_int sizeX,
+			const char* device);
+
+	private:
+		bool sample();
+		void drawVectors(cl_int sizeX);
+		VerifyResult compare(cl_int sizeZ) const;
+		cl_mem deviceBuffer(size_t slot, size_t bytes, int& err);
+		void releaseDevice();
+
+		VerifyConfig m_config;
+		std::mt19937_64 m_random;
+		std::vector<uint32_t> m_vecs;
+		std::vector<uint32_t> m_matrBVecs;
+		std::vector<uint32_t> m_productVecs;
+		std::vector<uint32_t> m_resVecs;
+
+		GpuTask m_task;
+		std::string m_device;
+		static const size_t BUFFER_SLOTS{ 7 };
+		cl_mem m_buffers[BUFFER_SLOTS]{};
+		size_t m_bufferBytes[BUFFER_SLOTS]{};
+	};
+
+	// Sums of the elements an axpy will touch, taken before it runs. The weighted sums
+	// also catch elements written to the wrong place.
+	struct AxpyChecksum
+	{
+		int64_t count{};
+		double sumX{};
+		double sumY{};
+		double weightedX{};
+		double weightedY{};
+		// Magnitudes bound the rounding the check has to tolerate
+		double absX{};
+		double absY{};
+		double weightedAbsX{};
+		double weightedAbsY{};
+	};
+
+	// Elements up to the end of either vector, as the axpy kernels clamp them
+	inline int64_t axpyCount(int64_t n, size_t xSize, int64_t incx, size_t ySize, int64_t incy)
+	{
+		if (n <= 0 || incx <= 0 || incy <= 0 || !xSize || !ySize)
+		{
+			return 0;
+		}
+		return std::min<int64_t>(n, std::min<int64_t>((ySize - 1) / incy, (xSize - 1) / incx) + 1);
+	}
+
+	inline double axpyWeight(int64_t index)
+	{
+		return static_cast<double>(index % 64 + 1);
+	}
+
+	template <typename fp_type>
+	AxpyChecksum axpyChecksum(int64_t n, const std::vector<fp_type>& x, int64_t incx, const std::vector<fp_type>& y, int64_t incy)
+	{
+		AxpyChecksum checksum;
+		checksum.count = axpyCount(n, x.size(), incx, y.size(), incy);
+		const int64_t count = checksum.count;
+		double sumX{}, sumY{}, weightedX{}, weightedY{}, absX{}, absY{}, weightedAbsX{}, weightedAbsY{};
+#pragma omp parallel for schedule(static) reduction(+: sumX, sumY, weightedX, weightedY, absX, absY, weightedAbsX, weightedAbsY)
+		for (int64_t index = 0; index < count; ++index)
+		{
+			const double xEl = x[index * incx];
+			const double yEl = y[index * incy];
+			const double weight = axpyWeight(index);
+			sumX += xEl;
+			sumY += yEl;
+			weightedX += weight * xEl;
+			weightedY += weight * yEl;
+			absX += std::abs(xEl);
+			absY += std::abs(yEl);
+			weightedAbsX += weight * std::abs(xEl);
+			weightedAbsY += weight * std::abs(yEl);
+		}
+		checksum.sumX = sumX;
+		checksum.sumY = sumY;
+		checksum.weightedX = weightedX;
+		checksum.weightedY = weightedY;
+		checksum.absX = absX;
+		checksum.absY = absY;
+		checksum.weightedAbsX = weightedAbsX;
+		checksum.weightedAbsY = weightedAbsY;
+		return checksum;
+	}
+
+	// O(n) check of y after y += a * x against the checksum taken before, in place of an
+	// element-wise comparison with a CPU axpy. The tolerance covers the worst-case rounding
+	// of each element in fp_type and of the sums in double, so a correct result never
+	// fails; in exchange only errors above about epsilon * sum |y| are caught: lost or
+	// misplaced writes, stale buffers, NaNs and flips of exponent or high mantissa bits.
+	template <typename fp_type>
+	bool verifyAxpy(const AxpyChecksum& before, fp_type a, const std::vector<fp_type>& y, int64_t incy)
+	{
+		if (before.count && (incy <= 0 || static_cast<size_t>((before.count - 1) * incy) >= y.size()))
+		{
+			return false;
+		}
+		const int64_t count = before.count;
+		double sumY{}, weightedY{};
+#pragma omp parallel for schedule(static) reduction(+: sumY, weightedY)
+		for (int64_t index = 0; index < count; ++index)
+		{
+			const double yEl = y[index * incy];
+			sumY += yEl;
+			weightedY += axpyWeight(index) * yEl;
+		}
+
+		const double scale = std::abs(static_cast<double>(a));
+		const double error = 3 * std::numeric_limits<fp_type>::epsilon() + 3 * count * std::numeric_limits<double>::epsilon();
+		const double tolerance = error * (before.absY + scale * before.absX);
+		const double weightedTolerance = error * (before.weightedAbsY + scale * before.weightedAbsX);
+		// Written so that NaNs fail
+		return std::abs(sumY - (before.sumY + a * before.sumX)) <= tolerance &&
+			std::abs(weightedY - (before.weightedY + a * before.weightedX)) <= weightedTolerance;
+	}
+}
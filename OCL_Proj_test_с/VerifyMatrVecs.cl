@@ -0,0 +1,16 @@
+// res = matr * vecs for count vectors stored interleaved (element c of vector j at
+// c * count + j), wrapping modulo 2^32 like the int matMult kernels
+__kernel void operation(const __global uint * matr,
+	const __global uint * vecs, __global uint * res,
+	uint rows, uint cols, uint count)
+{
+	uint j = get_global_id(0);
+	uint row = get_global_id(1);
+	if (j >= count || row >= rows)
+		return;
+	const __global uint * line = matr + (size_t)row * cols;
+	uint sum = 0;
+	for (uint c = 0; c < cols; ++c)
+		sum += line[c] * vecs[c * count + j];
+	res[row * count + j] = sum;
+}
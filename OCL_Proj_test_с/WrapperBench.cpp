@@ -0,0 +1,282 @@
+#include "WrapperBench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+#include "DevWorker.h"
+#include "DeviceSelector.h"
+#include "KernelCache.h"
+#include "GpuTask.h"
+#include "KernelLibrary.h"
+#include "ReportHelpers.h"
+
+#ifdef COUNT_ALLOCATIONS
+namespace
+{
+	std::atomic<size_t> g_allocations{ 0 };
+}
+
+// Replaces the global allocator for the whole program; the array and nothrow
+// forms forward here, so every operator new is counted. Every allocation in every
+// thread then pays a shared atomic increment, hence opt-in
+void* operator new(std::size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	void* ptr = std::malloc(size ? size : 1);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+namespace my
+{
+namespace
+{
+	// Enqueues without waiting are drained this often, so queues stay short
+	const size_t ENQUEUE_BATCH{ 256 };
+}
+
+bool countsAllocations()
+{
+#ifdef COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+size_t allocationCount()
+{
+#ifdef COUNT_ALLOCATIONS
+	return g_allocations.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+MicroBenchResult summarize(const char* name, size_t iterations, std::vector<double>& sampleNs, size_t allocations)
+{
+	MicroBenchResult result;
+	result.name = name;
+	result.iterations = iterations;
+	result.samples = sampleNs.size();
+	if (sampleNs.empty())
+	{
+		return result;
+	}
+	std::sort(sampleNs.begin(), sampleNs.end());
+	const size_t count = sampleNs.size();
+	result.medianNs = count % 2 ? sampleNs[count / 2] : (sampleNs[count / 2 - 1] + sampleNs[count / 2]) / 2;
+	result.minNs = sampleNs.front();
+	result.maxNs = sampleNs.back();
+	for (double sample : sampleNs)
+	{
+		result.meanNs += sample;
+	}
+	result.meanNs /= count;
+	if (count > 1)
+	{
+		double variance{};
+		for (double sample : sampleNs)
+		{
+			variance += (sample - result.meanNs) * (sample - result.meanNs);
+		}
+		result.stddevNs = std::sqrt(variance / (count - 1));
+		result.ci95Ns = 1.96 * result.stddevNs / std::sqrt(static_cast<double>(count));
+	}
+	result.allocationsPerOp = countsAllocations() ? static_cast<double>(allocations) / (iterations * count) : -1;
+	return result;
+}
+
+void writeMicroBenchJson(std::ostream& out, const MicroBenchReport& report)
+{
+	out << "{\n\t\"devices\": [";
+	for (size_t i = 0; i < report.size(); ++i)
+	{
+		out << (i ? ",\n" : "\n") << "\t\t{\n";
+		out << "\t\t\t\"name\": " << jsonString(report[i].first) << ",\n";
+		out << "\t\t\t\"benchmarks\": [";
+		const auto& results = report[i].second;
+		for (size_t j = 0; j < results.size(); ++j)
+		{
+			const auto& result = results[j];
+			out << (j ? ",\n" : "\n") << std::setprecision(6);
+			out << "\t\t\t\t{ \"name\": " << jsonString(result.name)
+				<< ", \"iterations\": " << result.iterations
+				<< ", \"samples\": " << result.samples
+				<< ", \"nsPerOp\": " << result.medianNs
+				<< ", \"meanNs\": " << result.meanNs
+				<< ", \"stddevNs\": " << result.stddevNs
+				<< ", \"ci95Ns\": " << result.ci95Ns
+				<< ", \"minNs\": " << result.minNs
+				<< ", \"maxNs\": " << result.maxNs
+				<< ", \"allocationsPerOp\": ";
+			if (result.allocationsPerOp < 0)
+			{
+				out << "null }";
+			}
+			else
+			{
+				out << result.allocationsPerOp << " }";
+			}
+		}
+		out << "\n\t\t\t]\n\t\t}";
+	}
+	out << "\n\t]\n}\n";
+}
+
+std::vector<MicroBenchResult> benchWrapper(const char* _deviceName, const MicroBenchConfig& config)
+{
+	std::vector<MicroBenchResult> results;
+	const DeviceInfo* info = DeviceSelector::instance().findByName(_deviceName);
+	if (!info)
+	{
+		std::cerr << "Device " << _deviceName << " not found\n";
+		return results;
+	}
+	const cl_device_id device = info->device;
+
+	// The wrapper reports to std::cout as it goes; that output is part of its
+	// cost, but is discarded rather than mixed into the results
+	std::ostringstream discarded;
+	std::streambuf* coutBuffer = std::cout.rdbuf(discarded.rdbuf());
+	auto drain = [&discarded]()
+	{
+		discarded.str(std::string());
+	};
+
+	results.push_back(runMicroBench("DevWorker::DevWorker", [&]()
+	{
+		DevWorker worker;
+	}, config));
+
+	DevWorker worker;
+	results.push_back(runMicroBench("DevWorker::createGpuTask", [&]()
+	{
+		GpuTask task = worker.createGpuTask(_deviceName, kernels::benchScale.source);
+		drain();
+	}, config));
+
+	results.push_back(runMicroBench("GpuTask::GpuTask", [&]()
+	{
+		GpuTask task(device, kernels::benchScale.source);
+		drain();
+	}, config));
+
+	GpuTask task(device, kernels::benchScale.source);
+	int err = CL_SUCCESS;
+	cl_mem bufA = task.isTaskFailed() ? nullptr : task.addBuffer<cl_float>(1024, CL_MEM_READ_WRITE, err);
+	cl_mem bufB = err == CL_SUCCESS && bufA ? task.addBuffer<cl_float>(1024, CL_MEM_READ_WRITE, err) : nullptr;
+	if (bufA && bufB)
+	{
+		results.push_back(runMicroBench("GpuTask::passParam", [&]()
+		{
+			task.passParam(0, bufA);
+		}, config));
+
+		results.push_back(runMicroBench("GpuTask::passParams(4 args)", [&]()
+		{
+			task.passParams(bufA, bufB, cl_int(1024), cl_float(2.0f));
+		}, config));
+
+		results.push_back(runMicroBench("GpuTask::addBuffer(4 KB)+release", [&]()
+		{
+			int bufferErr = CL_SUCCESS;
+			cl_mem buffer = task.addBuffer<cl_float>(1024, CL_MEM_READ_WRITE, bufferErr);
+			if (bufferErr == CL_SUCCESS)
+			{
+				clReleaseMemObject(buffer);
+			}
+		}, config));
+
+		cl_float value = 1.0f;
+		results.push_back(runMicroBench("GpuTask::enqueueWriteBuffer(4 B, blocking)", [&]()
+		{
+			task.enqueueWriteBuffer<cl_float>(1, &value, bufA);
+		}, config));
+
+		size_t one = 1;
+		double kernelTime{};
+		results.push_back(runMicroBench("GpuTask::enqueueKernel(blocking)", [&]()
+		{
+			task.enqueueKernel(1, NULL, &one, &kernelTime);
+		}, config));
+
+		size_t enqueued{};
+		const std::vector<cl_event> noEvents;
+		results.push_back(runMicroBench("GpuTask::enqueueKernel(non-blocking)", [&]()
+		{
+			task.enqueueKernel(1, nullptr, &one, noEvents, nullptr);
+			if (++enqueued % ENQUEUE_BATCH == 0)
+			{
+				clFinish(task.getQueue());
+			}
+		}, config));
+		clFinish(task.getQueue());
+
+		KernelCache& cache = KernelCache::instance();
+		const SpecializationConfig cacheConfig = cache.config();
+		cache.configure({ true, cacheConfig.hitThreshold, cacheConfig.capacity });
+		results.push_back(runMicroBench("KernelCache::acquire(hit)", [&]()
+		{
+			KernelCache::Lease lease = cache.acquire(_deviceName, kernels::benchScale.source, {});
+			drain();
+		}, config));
+		cache.configure(cacheConfig);
+	}
+	if (bufA)
+	{
+		clReleaseMemObject(bufA);
+	}
+	if (bufB)
+	{
+		clReleaseMemObject(bufB);
+	}
+
+	std::cout.rdbuf(coutBuffer);
+	return results;
+}
+
+int runWrapperBenchmarks(const char* outputPath)
+{
+	MicroBenchReport report;
+	for (const auto& info : DeviceSelector::instance().devices())
+	{
+		std::cerr << "Benchmarking the wrapper on " << info.name << "...\n";
+		report.emplace_back(info.name, benchWrapper(info.name.c_str()));
+	}
+
+	if (!outputPath)
+	{
+		writeMicroBenchJson(std::cout, report);
+		return EXIT_SUCCESS;
+	}
+	std::ofstream out(outputPath);
+	if (!out)
+	{
+		std::cout << "Cannot open " << outputPath << '\n';
+		return EXIT_FAILURE;
+	}
+	writeMicroBenchJson(out, report);
+	return EXIT_SUCCESS;
+}
+}
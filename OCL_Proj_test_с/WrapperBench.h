@@ -0,0 +1,88 @@
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <string>
+#include <utility>
+#include <iostream>
+#include <omp.h>
+
+namespace my
+{
+	// Operator new calls made by this process so far. Counting replaces the global
+	// allocator, so it is only built in with -D COUNT_ALLOCATIONS; otherwise this is 0.
+	// Only C++ allocations are counted: malloc inside the OpenCL runtime stays invisible
+	bool countsAllocations();
+	size_t allocationCount();
+
+	struct MicroBenchResult
+	{
+		std::string name;
+		size_t iterations{};		// per sample
+		size_t samples{};
+		double medianNs{};
+		double meanNs{};
+		double stddevNs{};
+		double minNs{};
+		double maxNs{};
+		// Half-width of the 95% confidence interval of the mean
+		double ci95Ns{};
+		// -1 unless built with COUNT_ALLOCATIONS
+		double allocationsPerOp{};
+	};
+
+	struct MicroBenchConfig
+	{
+		size_t samples{ 15 };
+		// Iterations per sample are doubled until one sample takes this long
+		double minSampleTime{ 0.01 };
+		size_t maxIterations{ size_t(1) << 20 };
+	};
+
+	MicroBenchResult summarize(const char* name, size_t iterations, std::vector<double>& sampleNs, size_t allocations);
+
+	// Times op on its own: one warm-up sample sizes the iteration count, then every
+	// sample runs op that many times back to back and records ns per call
+	template <typename Op>
+	MicroBenchResult runMicroBench(const char* name, Op&& op, const MicroBenchConfig& config = MicroBenchConfig())
+	{
+		size_t iterations = 1;
+		for (;;)
+		{
+			double time = omp_get_wtime();
+			for (size_t i = 0; i < iterations; ++i)
+			{
+				op();
+			}
+			time = omp_get_wtime() - time;
+			if (time >= config.minSampleTime || iterations >= config.maxIterations)
+			{
+				break;
+			}
+			iterations *= 2;
+		}
+
+		std::vector<double> sampleNs(config.samples);
+		const size_t allocations = allocationCount();
+		for (auto& sample : sampleNs)
+		{
+			double time = omp_get_wtime();
+			for (size_t i = 0; i < iterations; ++i)
+			{
+				op();
+			}
+			sample = (omp_get_wtime() - time) * 1e9 / iterations;
+		}
+		return summarize(name, iterations, sampleNs, allocationCount() - allocations);
+	}
+
+	// Results of one device, keyed by its name
+	using MicroBenchReport = std::vector<std::pair<std::string, std::vector<MicroBenchResult>>>;
+	void writeMicroBenchJson(std::ostream& out, const MicroBenchReport& report);
+
+	// Build, argument binding, buffer allocation and enqueue costs of the wrapper
+	// on one device, each measured without kernel work attached
+	std::vector<MicroBenchResult> benchWrapper(const char* _deviceName, const MicroBenchConfig& config = MicroBenchConfig());
+
+	// Runs benchWrapper on every device and writes JSON to outputPath, or to stdout when it is null
+	int runWrapperBenchmarks(const char* outputPath);
+}
@@ -3,15 +3,36 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <cstring>
 #include <omp.h>
 #include <random>
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
 #include "AxpyCPU.h"
 #include "AxpyGPU.h"
 #include "MatMult.h"
+#include "Strassen.h"
+#include "Conv.h"
+#include "Sparse.h"
+#include "QuantMatMult.h"
+#include "BatchQueue.h"
+#include "GpuAsync.h"
+#include "Transpose.h"
 
 #include "DevWorker.h"
+#include "DeviceSelector.h"
+#include "Roofline.h"
+#include "WrapperBench.h"
+#include "HostMemory.h"
+#include "Verify.h"
+#include "KernelCache.h"
+#include "KernelPool.h"
+#include "PersistentKernel.h"
 #include "GpuTask.h"
+#include "KernelLibrary.h"
+#include "CommandGraph.h"
 
 #define NAME_LENGTH 128
 #define O_SIZE 1000
@@ -19,21 +40,13 @@
 namespace
 {
 	std::string NVidia_platform{ "NVIDIA CUDA" };
-	std::string NVidia_device{ "NVIDIA GeForce GTX 1650" };
+	// Filled by the device selector in main
+	std::string discreteDevice;
 
 	std::string AMD_platform{ "AMD Accelerated Parallel Processing" };
-	std::string AMD_device{ "gfx902" };
-
-	char const* kernelSrc = "__kernel void operation(__global long * inout,		\n"
-							"						 const unsigned long count) \n"
-							"{													\n"
-							"	int index = get_global_id(0);					\n"
-							"	int group = get_group_id(0);					\n"
-							"	int lcl = get_local_id(0);						\n"
-							"	printf(\"Hello from %i block, %i thread (global id: %i)\\n\", group, lcl, index); \n"
-							"	if (index < count)								\n"
-							"		inout[index] = inout[index] + index;		\n"
-							"}													\n";
+	std::string integratedDevice;
+
+	char const* kernelSrc = my::kernels::hello.source;
 }
 
 int testSaxpy(size_t size, size_t incx, size_t incy)
@@ -73,26 +86,22 @@ int testSaxpy(size_t size, size_t incx, size_t incy)
 		}
 	}
 
-	my::saxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, AMD_device.c_str());
+	auto checksum = my::axpyChecksum(size, x, incx, y, incy);
+	my::saxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, integratedDevice.c_str());
 
-	for (const auto& vecEl : y)
+	if (!my::verifyAxpy(checksum, 1.0f, y, incy))
 	{
-		if (std::abs(vecEl - 5.4) > 0.000001)
-		{
-			std::cout << "Incorrect output for the AMD GPU faxpy\n";
-			return EXIT_FAILURE;
-		}
+		std::cout << "Incorrect output for the AMD GPU faxpy\n";
+		return EXIT_FAILURE;
 	}
 
-	my::saxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, NVidia_device.c_str());
+	checksum = my::axpyChecksum(size, x, incx, y, incy);
+	my::saxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, discreteDevice.c_str());
 
-	for (const auto& vecEl : y)
+	if (!my::verifyAxpy(checksum, 1.0f, y, incy))
 	{
-		if (std::abs(vecEl - 6.4) > 0.000001)
-		{
-			std::cout << "Incorrect output for the NVidia GPU faxpy\n";
-			return EXIT_FAILURE;
-		}
+		std::cout << "Incorrect output for the NVidia GPU faxpy\n";
+		return EXIT_FAILURE;
 	}
 	std::cout << "\n-------------------------------------\n";
 	return EXIT_SUCCESS;
@@ -135,33 +144,690 @@ int testDaxpy(size_t size, size_t incx, size_t incy)
 		}
 	}
 
-	my::daxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, AMD_device.c_str());
+	auto checksum = my::axpyChecksum(size, x, incx, y, incy);
+	my::daxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, integratedDevice.c_str());
 
-	for (const auto& vecEl : y)
+	if (!my::verifyAxpy(checksum, 1.0, y, incy))
 	{
-		if (std::abs(vecEl - 5.4) > 0.000001)
+		std::cout << "Incorrect output for the AMD GPU faxpy\n";
+		return EXIT_FAILURE;
+	}
+
+	checksum = my::axpyChecksum(size, x, incx, y, incy);
+	my::daxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, discreteDevice.c_str());
+
+	if (!my::verifyAxpy(checksum, 1.0, y, incy))
+	{
+		std::cout << "Incorrect output for the NVidia GPU faxpy\n";
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\n-------------------------------------\n";
+	return EXIT_SUCCESS;
+}
+
+int testMatMultCoalescer(const char* deviceName, size_t threadsCount, size_t requestsPerThread)
+{
+	const cl_int size = 32;
+	std::vector<cl_int> matrA(size * size);
+	std::vector<cl_int> matrB(size * size);
+	for (auto& matrEl : matrA)
+	{
+		matrEl = std::rand() % 100;
+	}
+	for (auto& matrEl : matrB)
+	{
+		matrEl = std::rand() % 100;
+	}
+	const auto expected = matMultCpu(matrA, matrB, size, size, size);
+
+	my::RequestCoalescer coalescer(deviceName);
+	std::vector<int> failed(threadsCount, 0);
+	std::vector<std::thread> callers;
+
+	double start = omp_get_wtime();
+	for (size_t t = 0; t < threadsCount; ++t)
+	{
+		callers.emplace_back([&, t]()
+		{
+			for (size_t i = 0; i < requestsPerThread; ++i)
+			{
+				auto result = coalescer.submitMatMult(matrA, matrB, size, size, size).get();
+				if (result != expected)
+				{
+					failed[t] = 1;
+				}
+			}
+		});
+	}
+	for (auto& caller : callers)
+	{
+		caller.join();
+	}
+	start = omp_get_wtime() - start;
+	std::cout << "Coalesced requests: " << threadsCount * requestsPerThread << ", time: " << start << '\n';
+
+	for (const auto& threadFailed : failed)
+	{
+		if (threadFailed)
 		{
-			std::cout << "Incorrect output for the AMD GPU faxpy\n";
+			std::cout << "Incorrect output for the coalesced matMult\n";
 			return EXIT_FAILURE;
 		}
 	}
+	return EXIT_SUCCESS;
+}
 
-	my::daxpy_gpu(size, static_cast<cl_float>(1), x, incx, y, incy, NVidia_device.c_str());
+// Runs axpys from many threads that share one built program; each request borrows a
+// kernel instance from the pool instead of creating its own
+int testKernelPool(const char* deviceName, size_t threadsCount, size_t requestsPerThread)
+{
+	const cl_long size = 4096;
+	const cl_float a{ 0.5f };
+	my::KernelPool pool(deviceName, my::kernels::saxpy.source);
+	if (pool.isFailed())
+	{
+		return EXIT_FAILURE;
+	}
+	std::vector<int> failed(threadsCount, 0);
+	std::vector<std::thread> callers;
 
-	for (const auto& vecEl : y)
+	double start = omp_get_wtime();
+	for (size_t t = 0; t < threadsCount; ++t)
+	{
+		callers.emplace_back([&, t]()
+		{
+			std::vector<cl_float> x(size, 1.0f);
+			std::vector<cl_float> y(size, static_cast<cl_float>(t));
+			for (size_t i = 0; i < requestsPerThread && !failed[t]; ++i)
+			{
+				const auto checksum = my::axpyChecksum(size, x, 1, y, 1);
+				int res = CL_SUCCESS;
+				my::KernelPool::Instance instance = pool.acquire(res);
+				if (res != CL_SUCCESS)
+				{
+					failed[t] = 1;
+					break;
+				}
+				cl_mem xBuff = clCreateBuffer(pool.getContext(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_float) * size, x.data(), &res);
+				cl_mem yBuff = res == CL_SUCCESS ?
+					clCreateBuffer(pool.getContext(), CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_float) * size, y.data(), &res) : nullptr;
+				if (res == CL_SUCCESS)
+				{
+					res = instance.passParams(size, a, xBuff, cl_long(1), size, yBuff, cl_long(1), size);
+				}
+				if (res == CL_SUCCESS)
+				{
+					size_t localSize = 64;
+					size_t globalSize = (size + localSize - 1) / localSize * localSize;
+					res = instance.enqueueKernel(1, &localSize, &globalSize, {}, nullptr);
+				}
+				if (res == CL_SUCCESS)
+				{
+					res = clEnqueueReadBuffer(instance.getQueue(), yBuff, CL_TRUE, 0, sizeof(cl_float) * size, y.data(), 0, NULL, NULL);
+				}
+				for (cl_mem buffer : { xBuff, yBuff })
+				{
+					if (buffer)
+					{
+						clReleaseMemObject(buffer);
+					}
+				}
+				if (res != CL_SUCCESS || !my::verifyAxpy(checksum, a, y, 1))
+				{
+					failed[t] = 1;
+				}
+			}
+		});
+	}
+	for (auto& caller : callers)
+	{
+		caller.join();
+	}
+	start = omp_get_wtime() - start;
+	std::cout << "Pooled requests: " << threadsCount * requestsPerThread << ", kernel instances: " << pool.instancesCount() <<
+		", time: " << start << '\n';
+
+	for (const auto& threadFailed : failed)
 	{
-		if (std::abs(vecEl - 6.4) > 0.000001)
+		if (threadFailed)
 		{
-			std::cout << "Incorrect output for the NVidia GPU faxpy\n";
+			std::cout << "Incorrect output for the pooled saxpy\n";
 			return EXIT_FAILURE;
 		}
 	}
+	return EXIT_SUCCESS;
+}
 
-	std::cout << "\n-------------------------------------\n";
+int testPersistentKernel(const char* deviceName, size_t requestsCount)
+{
+	my::PersistentExecutor executor(deviceName);
+	const size_t size = 4096;
+	std::vector<cl_float> x(size, 1.0f);
+	std::vector<cl_float> y(size, 0.0f);
+
+	// Per-request latencies, where the launch overhead shows
+	std::vector<double> latencies;
+	for (size_t i = 0; i < requestsCount; ++i)
+	{
+		const auto checksum = my::axpyChecksum(size, x, 1, y, 1);
+		double start = omp_get_wtime();
+		const int res = executor.saxpy(size, 0.5f, x, 1, y, 1);
+		latencies.push_back(omp_get_wtime() - start);
+		if (res != EXIT_SUCCESS || !my::verifyAxpy(checksum, 0.5f, y, 1))
+		{
+			std::cout << "Incorrect output for the persistent saxpy\n";
+			return EXIT_FAILURE;
+		}
+	}
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << (executor.isPersistent() ? "Persistent" : "Launched") << " saxpy latency p50: " << latencies[latencies.size() / 2] <<
+		", p99: " << latencies[latencies.size() * 99 / 100] << '\n';
+
+	const cl_int matrSize = 32;
+	std::vector<cl_int> matrA(matrSize * matrSize);
+	std::vector<cl_int> matrB(matrSize * matrSize);
+	for (auto& matrEl : matrA)
+	{
+		matrEl = std::rand() % 100;
+	}
+	for (auto& matrEl : matrB)
+	{
+		matrEl = std::rand() % 100;
+	}
+	if (executor.matMult(matrA, matrB, matrSize, matrSize, matrSize) != matMultCpu(matrA, matrB, matrSize, matrSize, matrSize))
+	{
+		std::cout << "Incorrect output for the persistent matMult\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Puts many small multiplications and axpys in flight from this one thread; the pool's
+// two threads resume each request as the device completes it
+int testCoroutines(const char* deviceName, size_t requestsCount)
+{
+	const cl_int size = 32;
+	std::vector<cl_int> matrA(size * size);
+	std::vector<cl_int> matrB(size * size);
+	for (auto& matrEl : matrA)
+	{
+		matrEl = std::rand() % 100;
+	}
+	for (auto& matrEl : matrB)
+	{
+		matrEl = std::rand() % 100;
+	}
+	const auto expected = matMultCpu(matrA, matrB, size, size, size);
+	const std::vector<cl_float> x(1024, 1.0f);
+	std::vector<std::vector<cl_float>> ys(requestsCount, std::vector<cl_float>(x.size(), 2.0f));
+
+	// Declared first, so that it outlives the tasks it resumes
+	my::ResumePool pool(2);
+	std::vector<my::CoTask<std::vector<cl_int>>> products;
+	std::vector<my::CoTask<int>> axpys;
+
+	double start = omp_get_wtime();
+	for (size_t i = 0; i < requestsCount; ++i)
+	{
+		products.push_back(matMultGpuAsync(matrA, matrB, size, size, size, deviceName, false, &pool));
+		axpys.push_back(my::saxpy_gpu_async(x.size(), 3.0f, x, 1, ys[i], 1, deviceName, &pool));
+	}
+	bool failed = false;
+	for (auto& product : products)
+	{
+		if (product.get() != expected)
+		{
+			failed = true;
+		}
+	}
+	for (size_t i = 0; i < requestsCount; ++i)
+	{
+		if (axpys[i].get() != EXIT_SUCCESS || ys[i] != std::vector<cl_float>(x.size(), 5.0f))
+		{
+			failed = true;
+		}
+	}
+	start = omp_get_wtime() - start;
+	std::cout << "Requests in flight: " << 2 * requestsCount << ", time: " << start << '\n';
+
+	if (failed)
+	{
+		std::cout << "Incorrect output for the coroutine requests\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Splits the device into cache domains (or halves, where it has none) and runs one
+// tenant per sub-device concurrently, each on its own cores
+int testSubDevices(const char* deviceName)
+{
+	my::DevWorker worker;
+	std::vector<cl_device_id> subDevices = worker.partitionByAffinity(deviceName);
+	if (subDevices.size() < 2)
+	{
+		for (auto subDevice : subDevices)
+		{
+			clReleaseDevice(subDevice);
+		}
+		const my::DeviceInfo* info = my::DeviceSelector::instance().findByName(deviceName);
+		subDevices = info && info->computeUnits >= 2 ? worker.partitionEqually(deviceName, info->computeUnits / 2) : std::vector<cl_device_id>();
+	}
+	if (subDevices.empty())
+	{
+		std::cout << "Device cannot be partitioned\n";
+		return EXIT_SUCCESS;
+	}
+
+	const cl_int count = 1 << 20;
+	std::vector<int> failed(subDevices.size(), 0);
+	std::vector<std::thread> tenants;
+	double start = omp_get_wtime();
+	for (size_t t = 0; t < subDevices.size(); ++t)
+	{
+		tenants.emplace_back([&, t]()
+		{
+			my::DevWorker tenantWorker;
+			my::GpuTask task = tenantWorker.createGpuTask(subDevices[t], my::kernels::tenant.source);
+			std::vector<cl_int> data(count, static_cast<cl_int>(t));
+			int err = CL_SUCCESS;
+			cl_mem buffer = task.isTaskFailed() ? nullptr : task.addBuffer<cl_int>(data.size(), CL_MEM_READ_WRITE, err);
+			if (!buffer || err != CL_SUCCESS)
+			{
+				failed[t] = 1;
+				return;
+			}
+			size_t localSize{}, globalSize{};
+			size_t workSize = data.size();
+			task.getDecomposition(&localSize, &globalSize, &workSize);
+			double kernelTime{};
+			if (task.enqueueWriteBuffer<cl_int>(data.size(), data.data(), buffer) != CL_SUCCESS ||
+				task.passParams(buffer, count) != CL_SUCCESS ||
+				task.enqueueKernel(1, &localSize, &globalSize, &kernelTime) != CL_SUCCESS ||
+				task.enqueueReadBuffer<cl_int>(data.size(), data.data(), buffer) != CL_SUCCESS)
+			{
+				failed[t] = 1;
+			}
+			clReleaseMemObject(buffer);
+			for (auto value : data)
+			{
+				if (value != static_cast<cl_int>(t) * 3 + 1)
+				{
+					failed[t] = 1;
+					break;
+				}
+			}
+		});
+	}
+	for (auto& tenant : tenants)
+	{
+		tenant.join();
+	}
+	start = omp_get_wtime() - start;
+	std::cout << "Tenants on sub-devices: " << subDevices.size() << ", time: " << start << '\n';
+
+	for (auto subDevice : subDevices)
+	{
+		clReleaseDevice(subDevice);
+	}
+	for (const auto& tenantFailed : failed)
+	{
+		if (tenantFailed)
+		{
+			std::cout << "Incorrect output for a sub-device tenant\n";
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+int testMatMultShapes(const char* deviceName)
+{
+	// Vector-matrix, matrix-vector, small square, tall-skinny with long Y, general
+	const cl_int shapes[][3]{ { 1, 4096, 512 }, { 512, 4096, 1 }, { 12, 12, 12 }, { 32, 65536, 32 }, { 100, 70, 90 } };
+	for (const auto& shape : shapes)
+	{
+		const cl_int Z = shape[0], Y = shape[1], X = shape[2];
+		std::vector<cl_int> matrA(static_cast<size_t>(Z) * Y);
+		std::vector<cl_int> matrB(static_cast<size_t>(Y) * X);
+		for (auto& matrEl : matrA)
+		{
+			matrEl = std::rand() % 100;
+		}
+		for (auto& matrEl : matrB)
+		{
+			matrEl = std::rand() % 100;
+		}
+		std::cout << '\n' << Z << 'x' << Y << 'x' << X << ":\n";
+		const auto expected = matMultCpu(matrA, matrB, Z, Y, X);
+
+		double start = omp_get_wtime();
+		const auto resCpu = matMultCpuDispatch(matrA, matrB, Z, Y, X);
+		start = omp_get_wtime() - start;
+		std::cout << "Res MatMultDispatch time: " << start << std::endl;
+		if (resCpu != expected)
+		{
+			std::cout << "Incorrect output for the CPU matMult dispatch\n";
+			return EXIT_FAILURE;
+		}
+
+		const auto resGpu = matMultGpuDispatch(matrA, matrB, Z, Y, X, deviceName);
+		if (resGpu != expected)
+		{
+			std::cout << "Incorrect output for the GPU matMult dispatch\n";
+			return EXIT_FAILURE;
+		}
+	}
 	return EXIT_SUCCESS;
 }
 
-int main() {
+int testConvolution(const char* deviceName)
+{
+	Conv2dShape shape;
+	shape.channels = 16;
+	shape.height = 224;
+	shape.width = 224;
+	shape.filters = 32;
+	shape.filterHeight = 3;
+	shape.filterWidth = 3;
+	shape.padY = 1;
+	shape.padX = 1;
+	const cl_int depth = shape.channels * shape.filterHeight * shape.filterWidth;
+	const cl_int pixels = shape.outHeight() * shape.outWidth();
+
+	std::vector<cl_int> image(static_cast<size_t>(shape.channels) * shape.height * shape.width);
+	std::vector<cl_int> filters(static_cast<size_t>(shape.filters) * depth);
+	for (auto& el : image)
+	{
+		el = std::rand() % 256;
+	}
+	for (auto& el : filters)
+	{
+		el = std::rand() % 16 - 8;
+	}
+
+	// Reference through an explicit im2col, depth times the size of the image
+	std::vector<cl_int> unfolded(static_cast<size_t>(depth) * pixels);
+	for (cl_int k = 0; k < depth; ++k)
+	{
+		const cl_int c = k / (shape.filterHeight * shape.filterWidth);
+		const cl_int r = k / shape.filterWidth % shape.filterHeight;
+		const cl_int s = k % shape.filterWidth;
+		for (cl_int n = 0; n < pixels; ++n)
+		{
+			const cl_int iy = n / shape.outWidth() - shape.padY + r;
+			const cl_int ix = n % shape.outWidth() - shape.padX + s;
+			const bool inside = iy >= 0 && iy < shape.height && ix >= 0 && ix < shape.width;
+			unfolded[static_cast<size_t>(k) * pixels + n] = inside ? image[(static_cast<size_t>(c) * shape.height + iy) * shape.width + ix] : 0;
+		}
+	}
+	const auto expected = matMultCpu(filters, unfolded, shape.filters, depth, pixels);
+
+	double start = omp_get_wtime();
+	const auto resCpu = conv2dCpu(image, filters, shape);
+	start = omp_get_wtime() - start;
+	std::cout << "Res Conv2d time: " << start << std::endl;
+	if (resCpu != expected)
+	{
+		std::cout << "Incorrect output for the CPU convolution\n";
+		return EXIT_FAILURE;
+	}
+	const auto resGpu = conv2dGpu(image, filters, shape, deviceName);
+	if (resGpu != expected)
+	{
+		std::cout << "Incorrect output for the GPU convolution\n";
+		return EXIT_FAILURE;
+	}
+
+	std::vector<cl_float> imageFloat(image.begin(), image.end());
+	std::vector<cl_float> filtersFloat(filters.begin(), filters.end());
+	for (auto& el : imageFloat)
+	{
+		el /= 256;
+	}
+	const auto resCpuFloat = conv2dCpu(imageFloat, filtersFloat, shape);
+	const auto resGpuFloat = conv2dGpu(imageFloat, filtersFloat, shape, deviceName);
+	if (resCpuFloat.size() != resGpuFloat.size())
+	{
+		std::cout << "Incorrect output for the GPU float convolution\n";
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < resCpuFloat.size(); ++i)
+	{
+		if (std::abs(resCpuFloat[i] - resGpuFloat[i]) > 1e-3f * (1 + std::abs(resCpuFloat[i])))
+		{
+			std::cout << "Incorrect output for the GPU float convolution\n";
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// u8 x s8 products against zero-point-corrected sums taken in 64 bits; depths that
+// are not a multiple of four exercise the padding of the packed operands
+int testQuantMatMult(const char* deviceName)
+{
+	const cl_int shapes[][3]{ { 64, 256, 64 }, { 33, 1027, 17 }, { 1, 4096, 1 } };
+	for (const auto& shape : shapes)
+	{
+		const cl_int Z = shape[0], Y = shape[1], X = shape[2];
+		std::vector<cl_float> matrA(static_cast<size_t>(Z) * Y);
+		std::vector<cl_float> matrB(static_cast<size_t>(Y) * X);
+		for (auto& el : matrA)
+		{
+			el = (std::rand() % 2001 - 500) / 100.f;
+		}
+		for (auto& el : matrB)
+		{
+			el = (std::rand() % 2001 - 1000) / 100.f;
+		}
+		const auto quantA = quantizeRowsU8(matrA, Z, Y);
+		const auto quantB = quantizeColsS8(matrB, Y, X);
+
+		std::vector<int64_t> expected(static_cast<size_t>(Z) * X);
+		for (int64_t z = 0; z < Z; ++z)
+		{
+			for (int64_t x = 0; x < X; ++x)
+			{
+				int64_t sum = 0;
+				for (int64_t y = 0; y < Y; ++y)
+				{
+					sum += (static_cast<int64_t>(quantA.values[z * Y + y]) - quantA.zeroPoints[z]) *
+						(static_cast<int64_t>(quantB.values[y * X + x]) - quantB.zeroPoints[x]);
+				}
+				expected[z * X + x] = sum;
+			}
+		}
+		std::cout << '\n' << Z << 'x' << Y << 'x' << X << ":\n";
+
+		double start = omp_get_wtime();
+		const auto resCpu = matMultQuantCpu(quantA, quantB);
+		start = omp_get_wtime() - start;
+		std::cout << "Res MatMultQuant time: " << start << std::endl;
+		if (!std::equal(expected.begin(), expected.end(), resCpu.begin(), resCpu.end()))
+		{
+			std::cout << "Incorrect output for the CPU quantized matMult\n";
+			return EXIT_FAILURE;
+		}
+
+		const auto resGpu = matMultQuantGpu(quantA, quantB, deviceName);
+		if (!std::equal(expected.begin(), expected.end(), resGpu.begin(), resGpu.end()))
+		{
+			std::cout << "Incorrect output for the GPU quantized matMult\n";
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// Every sparse format and kernel against the dense product. Rows alternate between
+// a few nonzeros and hundreds, so that both CSR kernels run on their own kind of row,
+// with a few empty rows and an all-zero matrix for the early returns
+int testSparse(const char* deviceName)
+{
+	const cl_int rows = 1000, cols = 800, sizeX = 24;
+	std::vector<cl_int> mixed(static_cast<size_t>(rows) * cols, 0);
+	for (cl_int row = 0; row < rows; ++row)
+	{
+		const cl_int length = row % 50 == 0 ? 0 : row % 10 == 0 ? 300 + std::rand() % 200 : 1 + std::rand() % 4;
+		for (cl_int j = 0; j < length; ++j)
+		{
+			mixed[static_cast<size_t>(row) * cols + std::rand() % cols] = std::rand() % 19 - 9;
+		}
+	}
+	std::vector<cl_int> empty(static_cast<size_t>(rows) * cols, 0);
+	std::vector<cl_int> x(cols);
+	std::vector<cl_int> matrB(static_cast<size_t>(cols) * sizeX);
+	for (auto& el : x)
+	{
+		el = std::rand() % 100;
+	}
+	for (auto& el : matrB)
+	{
+		el = std::rand() % 100;
+	}
+
+	for (const auto* dense : { &mixed, &empty })
+	{
+		const auto expectedSpmv = matMultCpu(*dense, x, rows, cols, 1);
+		const auto expectedSpmm = matMultCpu(*dense, matrB, rows, cols, sizeX);
+		const CsrMatr csr = csrFromDense(*dense, rows, cols);
+		std::cout << "Nonzeros: " << csr.nnz() << '\n';
+
+		double start = omp_get_wtime();
+		const auto resCpu = spmvCpu(csr, x);
+		start = omp_get_wtime() - start;
+		std::cout << "Res SpMV time: " << start << std::endl;
+		if (resCpu != expectedSpmv || spmmCpu(csr, matrB, sizeX) != expectedSpmm)
+		{
+			std::cout << "Incorrect output for the CPU sparse product\n";
+			return EXIT_FAILURE;
+		}
+
+		for (SpmvKernel kernel : { SpmvKernel::Auto, SpmvKernel::ScalarPerRow, SpmvKernel::VectorPerRow })
+		{
+			if (spmvGpu(csr, x, deviceName, kernel) != expectedSpmv)
+			{
+				std::cout << "Incorrect output for the GPU CSR SpMV\n";
+				return EXIT_FAILURE;
+			}
+		}
+		if (spmvGpu(ellFromCsr(csr), x, deviceName) != expectedSpmv)
+		{
+			std::cout << "Incorrect output for the GPU ELL SpMV\n";
+			return EXIT_FAILURE;
+		}
+		if (spmvGpu(sellFromCsr(csr), x, deviceName) != expectedSpmv)
+		{
+			std::cout << "Incorrect output for the GPU SELL SpMV\n";
+			return EXIT_FAILURE;
+		}
+		if (spmmGpu(csr, matrB, sizeX, deviceName) != expectedSpmm)
+		{
+			std::cout << "Incorrect output for the GPU SpMM\n";
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// Records upload, kernel and download once, replays them, then rebinds the count and
+// the source vector and replays again without recording anything new
+int testCommandGraph(const char* deviceName)
+{
+	const cl_int count = 1 << 16;
+	my::DevWorker worker;
+	my::GpuTask task = worker.createGpuTask(deviceName, my::kernels::tenant.source);
+	int err = CL_SUCCESS;
+	cl_mem buffer = task.isTaskFailed() ? nullptr : task.addBuffer<cl_int>(count, CL_MEM_READ_WRITE, err);
+	if (!buffer || err != CL_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::vector<cl_int> first(count), second(count), result(count);
+	for (cl_int i = 0; i < count; ++i)
+	{
+		first[i] = i;
+		second[i] = -i;
+	}
+	size_t localSize{}, globalSize{};
+	size_t workSize = count;
+	task.getDecomposition(&localSize, &globalSize, &workSize);
+
+	// Element i after a replay from source with the kernel limited to transformed elements
+	auto check = [&](const std::vector<cl_int>& source, cl_int transformed)
+	{
+		for (cl_int i = 0; i < count; ++i)
+		{
+			if (result[i] != (i < transformed ? source[i] * 3 + 1 : source[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	bool failed = false;
+	{
+		my::CommandGraph graph(task);
+		const auto write = graph.addWrite(buffer, first.data(), sizeof(cl_int) * count);
+		const auto kernel = graph.addKernel(task.getKernel(), 1, &globalSize, &localSize, { write });
+		graph.addRead(buffer, result.data(), sizeof(cl_int) * count, { kernel });
+
+		// The second, unchanged replay is the one a command buffer is recorded for
+		double replayTime{};
+		failed = graph.setArgs(kernel, buffer, count) != CL_SUCCESS;
+		for (int i = 0; i < 2 && !failed; ++i)
+		{
+			std::fill(result.begin(), result.end(), 0);
+			failed = graph.replay(&replayTime) != CL_SUCCESS || !check(first, count);
+		}
+		std::cout << "Replay time: " << replayTime << (graph.usesCommandBuffer() ? " (command buffer)" : "") << '\n';
+
+		// Only the first half is transformed now, the rest comes back as uploaded
+		if (!failed)
+		{
+			failed = graph.setArg(kernel, 1, count / 2) != CL_SUCCESS || graph.setHostPtr(write, second.data()) != CL_SUCCESS;
+		}
+		for (int i = 0; i < 2 && !failed; ++i)
+		{
+			std::fill(result.begin(), result.end(), 0);
+			failed = graph.replay(&replayTime) != CL_SUCCESS || !check(second, count / 2);
+		}
+		std::cout << "Rebound replay time: " << replayTime << (graph.usesCommandBuffer() ? " (command buffer)" : "") << '\n';
+	}
+	clReleaseMemObject(buffer);
+
+	if (failed)
+	{
+		std::cout << "Incorrect output for the command graph\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+
+	// --roofline [file] characterises every device and exits;
+	// --bench-wrapper [file] times the wrapper's own host-side operations and exits;
+	// --profile file makes the selector use a stored characterisation
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--roofline") == 0)
+		{
+			return my::runRoofline(i + 1 < argc ? argv[i + 1] : nullptr);
+		}
+		if (std::strcmp(argv[i], "--bench-wrapper") == 0)
+		{
+			return my::runWrapperBenchmarks(i + 1 < argc ? argv[i + 1] : nullptr);
+		}
+		if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+		{
+			my::DeviceSelector::instance().loadProfiles(argv[++i]);
+		}
+	}
 
 	
 	/*int64_t size{0};
@@ -197,6 +863,22 @@ int main() {
 	size_t X, Y, Z;
 	X = 1024; Y = 1024; Z = 1024;
 
+	my::DeviceSelector& selector = my::DeviceSelector::instance();
+	const my::DeviceInfo* discrete = selector.select(my::Operation::MatMult, Z, Y, X,
+		[](const my::DeviceInfo& info) { return (info.type & CL_DEVICE_TYPE_GPU) && !info.unifiedMemory; });
+	const my::DeviceInfo* integrated = selector.select(my::Operation::MatMult, Z, Y, X,
+		[](const my::DeviceInfo& info) { return (info.type & CL_DEVICE_TYPE_GPU) && info.unifiedMemory; });
+	const my::DeviceInfo* best = selector.select(my::Operation::MatMult, Z, Y, X);
+	if (!best)
+	{
+		std::cout << "No OpenCL devices found\n";
+		return EXIT_FAILURE;
+	}
+	discreteDevice = discrete ? discrete->name : best->name;
+	integratedDevice = integrated ? integrated->name : best->name;
+	std::cout << "Fastest device for " << Z << 'x' << Y << 'x' << X << " matMult: " << best->name
+		<< " (estimated " << selector.estimateTime(*best, my::Operation::MatMult, Z, Y, X) << " s)\n";
+
 	std::vector<cl_int> matrA(Z * Y, 1);
 	std::vector<cl_int> matrB(Y * X, 2);
 
@@ -217,12 +899,169 @@ int main() {
 
 
 	std::cout << "\nWithout using shared memory:\n";
-	const auto resGpuMatr = matMultGpu(matrA, matrB, Z, Y, X, NVidia_device.c_str());
-	const auto resGpuMatrAMD = matMultGpu(matrA, matrB, Z, Y, X, AMD_device.c_str());
+	const auto resGpuMatr = matMultGpu(matrA, matrB, Z, Y, X, discreteDevice.c_str());
+	const auto resGpuMatrAMD = matMultGpu(matrA, matrB, Z, Y, X, integratedDevice.c_str());
 
 	std::cout << "\nUsing shared memory:\n";
-	const auto resGpuMatr1 = matMultGpu(matrA, matrB, Z, Y, X, NVidia_device.c_str(), true);
-	const auto resGpuMatrAMD1 = matMultGpu(matrA, matrB, Z, Y, X, AMD_device.c_str(), true);
+	const auto resGpuMatr1 = matMultGpu(matrA, matrB, Z, Y, X, discreteDevice.c_str(), true);
+	const auto resGpuMatrAMD1 = matMultGpu(matrA, matrB, Z, Y, X, integratedDevice.c_str(), true);
+
+	// Freivalds' checks in O(n^2) rather than a full CPU multiply, on each side
+	std::cout << "\nVerifying the GPU products:\n";
+	{
+		my::GemmVerifier verifier;
+		for (const auto* product : { &resGpuMatr, &resGpuMatrAMD, &resGpuMatr1, &resGpuMatrAMD1 })
+		{
+			if (product->empty())
+			{
+				continue;
+			}
+			auto start = omp_get_wtime();
+			const my::VerifyResult cpuCheck = verifier.checkCpu(matrA.data(), matrB.data(), product->data(), Z, Y, X);
+			start = omp_get_wtime() - start;
+			std::cout << "Check on CPU time: " << start << '\n';
+
+			start = omp_get_wtime();
+			const my::VerifyResult gpuCheck = verifier.checkGpu(matrA.data(), matrB.data(), product->data(), Z, Y, X, best->name.c_str());
+			start = omp_get_wtime() - start;
+			std::cout << "Check on GPU time: " << start << '\n';
+
+			if (cpuCheck == my::VerifyResult::Failed || gpuCheck == my::VerifyResult::Failed)
+			{
+				std::cout << "Incorrect output for the GPU matMult\n";
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	std::cout << "\nRepeated multiplications with specialised kernels:\n";
+	my::KernelCache::instance().configure({ true, 2, 16 });
+	for (int i = 0; i < 3; ++i)
+	{
+		const auto resSpecMatr = matMultGpu(matrA, matrB, Z, Y, X, discreteDevice.c_str());
+		if (resSpecMatr != resGpuMatr)
+		{
+			std::cout << "Incorrect output for the specialised matMult\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::cout << "\nRepeated multiplications into a reused workspace:\n";
+	{
+		MatMultWorkspace workspace;
+		std::vector<cl_int> resWorkspaceMatr(resGpuMatr.size());
+		for (int i = 0; i < 3; ++i)
+		{
+			const size_t allocations = my::allocationCount();
+			if (matMultGpu(matrA.data(), matrB.data(), resWorkspaceMatr.data(), Z, Y, X, discreteDevice.c_str(), workspace) != EXIT_SUCCESS ||
+				resWorkspaceMatr != resGpuMatr)
+			{
+				std::cout << "Incorrect output for the workspace matMult\n";
+				return EXIT_FAILURE;
+			}
+			if (my::countsAllocations())
+			{
+				std::cout << "Heap allocations: " << my::allocationCount() - allocations << '\n';
+			}
+		}
+	}
+
+	std::cout << "\nStrassen-Winograd multiplications:\n";
+	{
+		StrassenConfig config;
+		config.crossover = 256;
+		StrassenWorkspace workspace;
+		std::vector<cl_int> resStrassenMatr(resGpuMatr.size());
+		for (int i = 0; i < 3; ++i)
+		{
+			const size_t allocations = my::allocationCount();
+			if (matMultGpuStrassen(matrA.data(), matrB.data(), resStrassenMatr.data(), Z, Y, X, discreteDevice.c_str(), workspace, config) != EXIT_SUCCESS ||
+				resStrassenMatr != resGpuMatr)
+			{
+				std::cout << "Incorrect output for the Strassen matMult on GPU\n";
+				return EXIT_FAILURE;
+			}
+			if (my::countsAllocations())
+			{
+				std::cout << "Heap allocations: " << my::allocationCount() - allocations << '\n';
+			}
+		}
+
+		auto start = omp_get_wtime();
+		matMultCpuStrassen(matrA.data(), matrB.data(), resStrassenMatr.data(), Z, Y, X, workspace, config);
+		start = omp_get_wtime() - start;
+		std::cout << "Strassen time on CPU: " << start << '\n';
+		if (resStrassenMatr != resGpuMatr)
+		{
+			std::cout << "Incorrect output for the Strassen matMult on CPU\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::cout << "\nCoalesced small multiplications:\n";
+	if (testMatMultCoalescer(discreteDevice.c_str(), 32, 16) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nRequests sharing one program through a kernel pool:\n";
+	if (testKernelPool(discreteDevice.c_str(), 8, 64) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nTiny requests on a persistent kernel:\n";
+	if (testPersistentKernel(best->name.c_str(), 1000) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nCoroutine requests:\n";
+	if (testCoroutines(discreteDevice.c_str(), 128) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	const my::DeviceInfo* cpuDevice = selector.select(my::Operation::MatMult, Z, Y, X,
+		[](const my::DeviceInfo& info) { return (info.type & CL_DEVICE_TYPE_CPU) != 0; });
+	if (cpuDevice)
+	{
+		std::cout << "\nTenants isolated on sub-devices:\n";
+		if (testSubDevices(cpuDevice->name.c_str()) != EXIT_SUCCESS)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::cout << "\nShape-specialised multiplications:\n";
+	if (testMatMultShapes(best->name.c_str()) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nConvolution with implicit im2col:\n";
+	if (testConvolution(best->name.c_str()) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nQuantized multiplications:\n";
+	if (testQuantMatMult(best->name.c_str()) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nSparse products:\n";
+	if (testSparse(best->name.c_str()) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "\nReplayed command graph:\n";
+	if (testCommandGraph(best->name.c_str()) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
 
 	/*for (int i = 0; i < resMatr.size(); ++i)
 	{
@@ -282,7 +1121,7 @@ int main() {
 	for (int i = 0; i < 5; ++i)
 	{
 		auto start = omp_get_wtime();
-		const auto bTransp1 = transpMatrOMP(matrB, X, Y);
+		const auto bTransp1 = transpMatrBlocked(matrB, X, Y);
 		const auto resMatr1 = matMultCpuTranspOMP(matrA, bTransp1, X, Y, Z);
 		start = omp_get_wtime() - start;
 		std::cout << "\nRes MatMultOMPTransp time: " << start << std::endl;
@@ -297,5 +1136,57 @@ int main() {
 		}
 	}
 
+	// The device transpose has to give exactly the blocked one used above
+	{
+		auto start = omp_get_wtime();
+		const auto bTranspGpu = transpMatrGpu(matrB, X, Y, discreteDevice.c_str());
+		start = omp_get_wtime() - start;
+		std::cout << "\nRes TranspGpu time: " << start << std::endl;
+
+		if (bTranspGpu != transpMatrBlocked(matrB, X, Y))
+		{
+			std::cout << "Error\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Same product on huge-page memory placed by parallel first touch, so each
+	// socket streams its own rows of A and of the result
+	{
+		my::HostVector<cl_int> numaA(matrA.size()), numaBTransp(matrB.size()), numaRes(static_cast<size_t>(Z) * X);
+		my::firstTouchRows(numaA.data(), Z, Y);
+		my::firstTouchRows(numaRes.data(), Z, X);
+		std::copy(matrA.begin(), matrA.end(), numaA.begin());
+		transpMatrBlocked(matrB.data(), numaBTransp.data(), X, Y);
+
+		auto start = omp_get_wtime();
+		matMultCpuTranspOMP(numaA.data(), numaBTransp.data(), numaRes.data(), Z, Y, X);
+		start = omp_get_wtime() - start;
+		std::cout << "\nRes MatMultOMPTransp time (NUMA-placed): " << start << std::endl;
+
+		if (!std::equal(numaRes.begin(), numaRes.end(), resGpuMatr.begin()))
+		{
+			std::cout << "Error\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Views consume B in place, without the transposed copy made above
+	auto start = omp_get_wtime();
+	std::vector<cl_int> resView(Z * X);
+	matMultCpu(MatrView<const cl_int>(matrA.data(), Z, Y), MatrView<const cl_int>(matrB.data(), Y, X),
+		MatrView<cl_int>(resView.data(), Z, X));
+	start = omp_get_wtime() - start;
+	std::cout << "\nRes MatMultView time: " << start << std::endl;
+
+	for (size_t i = 0; i < resView.size(); ++i)
+	{
+		if (resGpuMatr[i] != resView[i])
+		{
+			std::cout << "Error\n";
+			return EXIT_FAILURE;
+		}
+	}
+
 	return EXIT_SUCCESS;
 }
\ No newline at end of file